@@ -8,8 +8,6 @@
 #include "Hypergraph.h"
 #include <fstream>
 #include <iostream>
-#include <Vocab.h>
-#include <Ngram.h>
 #include <NGramCache.h>
 #include <LMNonLocal.h>
 #include <File.h>
@@ -31,7 +29,7 @@ int main(int argc, char ** argv) {
 
   // Read weight vector and language model from command-line.
   wvector * weight = cmd_weights();
-  Ngram * lm = cmd_lm();
+  LanguageModel * lm = cmd_language_model();
   int n_best = 10;
 
   GOOGLE_PROTOBUF_VERIFY_VERSION;
@@ -57,7 +55,8 @@ int main(int argc, char ** argv) {
     clock_t begin=clock();    
     int cube = FLAGS_cube_size;
     CubePruning p(f, *w, LMNonLocal(f, *lm, lm_weight(), *words, true), cube, 3);
-    double v = p.parse();
+    bool success;
+    double v = p.parse(&success);
     clock_t end = clock();
 
     //cout << "*TRANS* " << i << " ";
@@ -79,11 +78,11 @@ int main(int argc, char ** argv) {
           cout << word << " ";
         }
         if (j > 1) {
-          VocabIndex context [] = { words->store[sent[j - 1]], 
-                                    words->store[sent[j - 2]], 
-                                    Vocab_None };
-          lm_score += lm->wordProb(words->store[sent[j]],  context);
-          cout << lm_weight() * lm->wordProb(words->store[sent[j]],  context) << " " ;
+          LMWord context [] = { words->store[sent[j - 1]], 
+                                words->store[sent[j - 2]], 
+                                kLMNone };
+          lm_score += lm->word_prob(words->store[sent[j]],  context);
+          cout << lm_weight() * lm->word_prob(words->store[sent[j]],  context) << " " ;
         }
       }
       cout << " ||| " ;
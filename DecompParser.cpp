@@ -11,7 +11,10 @@
 #include "parse/ParseConstraints.h"
 #include "parse/ParseSolvers.h"
 #include "parse/SOEisnerToHypergraph.h"
+#include "parse/Eisner.h"
 #include "DualDecomposition.h"
+#include "DualOptimizers.h"
+#include "Telemetry.h"
 #include "Subgradient.h"
 #include "MRF.h"
 #include "MRFSolvers.h"
@@ -22,6 +25,9 @@ DEFINE_string(parse_file, "",
               "The file with precomputed parse features.");
 DEFINE_string(feature_weights_file, "", 
               "The file with weights for 'value' feature.");
+DEFINE_string(first_order_file, "", 
+              "First-order arc probabilities; if given, parse these with "
+              "Eisner's algorithm instead of parse_file.");
 
 DEFINE_string(alignment_file, "", 
               "The file aligning the mrf/parse models.");
@@ -31,6 +37,19 @@ DEFINE_int32(mrf_end, 0,
              "End index of mrf.");
 DEFINE_string(mrf_file_prefix, "", 
               "Prefix of the mrf file.");
+DEFINE_int32(threads, 1, 
+             "Number of threads for solving sentences and mrfs. "
+             "Above 1 the parser and mrf are also solved concurrently.");
+DEFINE_string(dual_optimizer, "subgradient", 
+              "Dual update: subgradient, bundle or nesterov.");
+DEFINE_double(smooth_temperature, 1.0, 
+              "Starting smoothing temperature for nesterov.");
+DEFINE_double(smooth_step, 1.0, 
+              "Step size multiplier for nesterov.");
+DEFINE_double(time_limit_ms, 0.0, 
+              "Wall clock budget for the decomposition in ms (0 for none).");
+DEFINE_string(telemetry_file, "", 
+              "Write per round records here (.csv for CSV, else JSON lines).");
 
 
 using namespace std;
@@ -46,6 +65,7 @@ int main(int argc, char ** argv) {
   wvector * weight = load_weights_from_file(FLAGS_feature_weights_file.c_str()); 
   
   vector <DepParser * > parsers;
+  vector <ArcScores * > arc_scores;
   vector <MRF *> mrfs; 
   ParseMrfAligner parse_align;
 
@@ -53,9 +73,16 @@ int main(int argc, char ** argv) {
   parse_align.build_from_constraints(FLAGS_alignment_file.c_str());
 
   // 3 4
-  cout << "parse file " << FLAGS_parse_file;
   clock_t start=clock();
-  parsers = SecondOrderConverter().convert_file(FLAGS_parse_file.c_str());
+  if (FLAGS_first_order_file != "") {
+    cout << "first order file " << FLAGS_first_order_file;
+    wvector * value = svector_from_str<int, double>("value=1");
+    arc_scores = read_first_order_file(FLAGS_first_order_file.c_str(),
+                                       value->dot(*weight));
+  } else {
+    cout << "parse file " << FLAGS_parse_file;
+    parsers = SecondOrderConverter().convert_file(FLAGS_parse_file.c_str());
+  }
   clock_t end=clock();
   cout << "make hyper time"<< double(Clock::diffclock(end,start)) << endl;
 
@@ -72,17 +99,37 @@ int main(int argc, char ** argv) {
   end = clock();
   cout << "make mrf time "<< double(Clock::diffclock(end,start)) << endl;
   
-  ParserDual p_dual(parsers, *weight, parse_align);
+  ParserDual * p_dual_ptr;
+  if (FLAGS_first_order_file != "") {
+    p_dual_ptr = new ParserDual(arc_scores, parse_align);
+  } else {
+    p_dual_ptr = new ParserDual(parsers, *weight, parse_align);
+  }
+  ParserDual & p_dual = *p_dual_ptr;
   
   wvector * simple = svector_from_str<int, double>("value=-1");
   ConstrainerDual<ParseIndex> mrf_dual(mrfs, *simple, parse_align);
+  p_dual.set_num_threads(FLAGS_threads);
+  mrf_dual.set_num_threads(FLAGS_threads);
   
   start = clock();
   ParseRate rate;
-  DualDecomposition d(p_dual, mrf_dual, rate);
+  DualOptimizer * optimizer = 
+    dual_optimizer_from_name(FLAGS_dual_optimizer, 
+                             FLAGS_smooth_temperature, FLAGS_smooth_step);
+  DualDecomposition * d;
+  if (optimizer != NULL) {
+    d = new DualDecomposition(p_dual, mrf_dual, *optimizer);
+  } else {
+    d = new DualDecomposition(p_dual, mrf_dual, rate);
+  }
+  d->set_concurrent(FLAGS_threads > 1);
+  TelemetrySink * telemetry = telemetry_from_file(FLAGS_telemetry_file);
+  d->subgradsolver.set_telemetry(telemetry);
+  d->subgradsolver.set_time_limit(FLAGS_time_limit_ms);
   //d._subgradsolver.rate = new ParseRate();
-  d.solve(0);
-  d.subgradsolver.set_max_rounds(150);
+  d->solve(0);
+  d->subgradsolver.set_max_rounds(150);
   end = clock();
   cout << "inference time "<< double(Clock::diffclock(end,start)) << endl;
   
@@ -91,6 +138,10 @@ int main(int argc, char ** argv) {
     cout << "SENTENCE: ";    
     parsers[i]->show_derivation(p_dual.best_derivations[i]);
   }
+  for (int i =0; i < p_dual.best_dependencies.size(); i++) {
+    cout << "SENTENCE: ";    
+    show_dependencies(p_dual.best_dependencies[i]);
+  }
 
   for (int i =0; i < mrf_dual.best_derivations.size(); i++) {
     //foreach (HEdges derivations, p_dual.best_derivations) {
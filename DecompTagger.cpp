@@ -44,7 +44,7 @@ int main(int argc, char ** argv) {
     stringstream fname;
     fname << argv[2] << i;
   
-    Tagger * f = new Tagger(200);
+    Tagger * f = new Tagger();
     f->build_from_file(fname.str().c_str());  
     cout << fname.str() << endl ;
     taggers.push_back(f);
@@ -54,8 +54,20 @@ int main(int argc, char ** argv) {
   
   wvector * simple = svector_from_str<int, double>("value=-1");
   ConstrainerDual<TagIndex> mrf_dual(mrfs, *simple, tag_align);
+  if (argc > 9) {
+    int threads = atoi(argv[9]);
+    p_dual.set_num_threads(threads);
+    mrf_dual.set_num_threads(threads);
+  }
+  if (argc > 10) {
+    p_dual.set_use_trellis(atoi(argv[10]) != 0);
+  }
+  if (argc > 11) {
+    mrf_dual.set_use_graph_cut(atoi(argv[11]) != 0);
+  }
   ParseRate pr; 
   DualDecomposition d(p_dual, mrf_dual,pr);
+  d.set_concurrent(argc > 9 && atoi(argv[9]) > 1);
   d.solve(0);
   
   for (int i =0; i < p_dual.best_derivations.size(); i++) {
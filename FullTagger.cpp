@@ -44,7 +44,7 @@ int main(int argc, char ** argv) {
     stringstream fname;
     fname << argv[2] << i;
   
-    Tagger * f = new Tagger(100);
+    Tagger * f = new Tagger();
     cout << fname.str() << endl;
     f->build_from_file(fname.str().c_str());
   
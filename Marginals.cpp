@@ -1,45 +1,126 @@
 #include "Weights.h"
 #include "HypergraphImpl.h"
 #include "Tagger.h"
-#include <HypergraphAlgorithms.h>
+#include "TagMarginals.h"
 #include <iostream>
+#include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstdlib>
 #include "common.h"
+#include "optimization/ThreadPool.h"
+#include <gflags/gflags.h>
+using namespace std;
 using namespace Scarab::HG;
+
+DEFINE_string(weights_file, "",
+              "The file with weights for the lattice features.");
+DEFINE_string(lattice_prefix, "",
+              "Tag lattices are read from this prefix plus the sentence number.");
+DEFINE_int32(start, 0, "First sentence.");
+DEFINE_int32(end, 0, "Last sentence (inclusive).");
+DEFINE_int32(threads, 1, "Threads to compute marginals with.");
+DEFINE_int32(batch, 1000,
+             "Sentences to load and write at a time.");
+DEFINE_double(temperature, 1.0,
+              "Temperature of the marginals; 1.0 gives the posteriors of "
+              "the lattice as a distribution.");
+DEFINE_string(output_file, "",
+              "Binary file of (sentence, position, tag, marginal) records.");
+DEFINE_bool(text, false,
+            "Also print the records as text to stdout.");
+
+// Computes the marginals of a batch of loaded taggers, one sentence per item.
+class MarginalTask : public ParallelTask {
+ public:
+  MarginalTask(const vector <Tagger *> & taggers, int first_sentence,
+               const wvector & weights)
+      : _taggers(taggers), _first_sentence(first_sentence),
+        _weights(weights), results(taggers.size()) {}
+
+  void run_item(int item, int thread_id) {
+    results[item].clear();
+    tag_marginals(*_taggers[item], _weights, FLAGS_temperature,
+                  _first_sentence + item, &results[item]);
+  }
+
+ private:
+  const vector <Tagger *> & _taggers;
+  int _first_sentence;
+  const wvector & _weights;
+
+ public:
+  vector <vector <TagMarginal> > results;
+};
+
 int main(int argc, char ** argv) {
-  
   GOOGLE_PROTOBUF_VERIFY_VERSION;
-  wvector * weight = load_weights_from_file( argv[1]); 
-
-  for (int i =atoi(argv[3]); i <= atoi(argv[4]); i++) {   
-    stringstream fname;
-    fname << argv[2] << i;
-
-    cerr << "Margs " << i << endl; 
-    cout << "SENT " << i << endl; 
-
-    Tagger f(200);
-    f.build_from_file(fname.str().c_str());
-
-    HypergraphAlgorithms ha(f);
-    EdgeCache * edge_weights = ha.cache_edge_weights(*weight);
-  
-    NodeCache  inside_memo_table(f.num_nodes()), outside_memo_table(f.num_nodes()), marginals(f.num_nodes()); ; 
-    
-    ha.inside_scores( *edge_weights, inside_memo_table);
-    ha.outside_scores( *edge_weights, inside_memo_table, outside_memo_table);
-
-    ha.collect_marginals(inside_memo_table, outside_memo_table, marginals);
-    
-    foreach (HNode node, f.nodes()) {
-      if (marginals.has_key(*node)) {
-        if (f.node_has_tag(*node)) {
-          cout << "Node " <<  node->id() << " "<< marginals.get(*node) << " " <<inside_memo_table.get(*node)<<" "<< outside_memo_table.get(*node) << " " << f.node_to_tag(*node)<< endl;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  // The old positional form, kept for existing scripts.
+  if (argc == 5) {
+    FLAGS_weights_file = argv[1];
+    FLAGS_lattice_prefix = argv[2];
+    FLAGS_start = atoi(argv[3]);
+    FLAGS_end = atoi(argv[4]);
+    if (FLAGS_output_file == "") {
+      FLAGS_text = true;
+    }
+  } else if (argc != 1) {
+    cerr << "Usage: " << argv[0] << " weights lattice_prefix start end"
+         << " (or the same as flags, see --help)" << endl;
+    return 1;
+  }
+
+  wvector * weight = load_weights_from_file(FLAGS_weights_file.c_str());
+
+  fstream output;
+  if (FLAGS_output_file != "") {
+    output.open(FLAGS_output_file.c_str(),
+                ios::out | ios::binary | ios::trunc);
+    if (!output) {
+      cerr << "Failed to open " << FLAGS_output_file << endl;
+      return 1;
+    }
+  }
+
+  ThreadPool pool(FLAGS_threads);
+  long total = 0;
+  for (int first = FLAGS_start; first <= FLAGS_end; first += FLAGS_batch) {
+    int last = min(FLAGS_end, first + FLAGS_batch - 1);
+
+    // Loading interns feature names, so it stays on this thread.
+    vector <Tagger *> taggers;
+    for (int i = first; i <= last; i++) {
+      stringstream fname;
+      fname << FLAGS_lattice_prefix << i;
+      cerr << "Margs " << i << endl;
+      Tagger * tagger = new Tagger();
+      tagger->build_from_file(fname.str().c_str());
+      taggers.push_back(tagger);
+    }
+
+    MarginalTask task(taggers, first, *weight);
+    pool.run(task, taggers.size());
+
+    foreach (const vector <TagMarginal> & records, task.results) {
+      if (output.is_open()) {
+        write_tag_marginals(output, records);
+      }
+      if (FLAGS_text) {
+        foreach (const TagMarginal & record, records) {
+          cout << record.sentence << " " << record.position << " "
+               << record.tag << " " << record.marginal << endl;
         }
       }
+      total += records.size();
+    }
+    foreach (Tagger * tagger, taggers) {
+      delete tagger;
     }
   }
+  cerr << "Wrote " << total << " marginals" << endl;
+
   google::protobuf::ShutdownProtobufLibrary();
   return 0;
 }
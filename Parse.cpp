@@ -7,6 +7,8 @@
 
 #include "common.h"
 #include "parse/SOEisnerToHypergraph.h"
+#include "parse/Eisner.h"
+#include "parse/SOEisner.h"
 #include "lexical.pb.h"
 #include <gflags/gflags.h>
 using namespace std;
@@ -17,6 +19,12 @@ DEFINE_string(parse_file, "",
               "The file with precomputed parse features.");
 DEFINE_string(feature_weights_file, "", 
               "The file with weights for 'value' feature.");
+DEFINE_string(first_order_file, "", 
+              "First-order arc probabilities; if given, parse these with "
+              "Eisner's algorithm instead of parse_file.");
+DEFINE_bool(chart_parser, false, 
+            "Parse parse_file with the second-order chart parser "
+            "instead of building a hypergraph.");
 
 
 int main(int argc, char ** argv) {
@@ -25,6 +33,42 @@ int main(int argc, char ** argv) {
 
   wvector * weight = load_weights_from_file(FLAGS_feature_weights_file.c_str()); //vm["weights"].as< string >().c_str());
   double total_score = 0.0;
+
+  if (FLAGS_first_order_file != "") {
+    wvector * value = svector_from_str<int, double>("value=1");
+    vector<ArcScores *> arc_scores = 
+      read_first_order_file(FLAGS_first_order_file.c_str(), 
+                            value->dot(*weight));
+    EisnerParser eisner;
+    for (uint i = 0; i < arc_scores.size(); i++) {  
+      vector<Dependency> deps;
+      double score = eisner.parse(*arc_scores[i], &deps);
+      cout << endl << "SENTENCE: ";
+      show_dependencies(deps);
+      cout << "Score is : " << -score << endl;
+      total_score += score;
+    }
+    cout << "Total Score " << -total_score << endl;
+    return 0;
+  }
+
+  if (FLAGS_chart_parser) {
+    wvector * value = svector_from_str<int, double>("value=1");
+    vector<SiblingScores *> sibling_scores = 
+      read_second_order_file(FLAGS_parse_file.c_str(), value->dot(*weight));
+    SOEisnerParser eisner;
+    for (uint i = 0; i < sibling_scores.size(); i++) {  
+      vector<Dependency> deps;
+      double score = eisner.parse(*sibling_scores[i], &deps);
+      cout << endl << "SENTENCE: ";
+      show_dependencies(deps);
+      cout << "Score is : " << -score << endl;
+      total_score += score;
+    }
+    cout << "Total Score " << -total_score << endl;
+    return 0;
+  }
+
   vector<DepParser * > parsers;
   cout << "Converting!!!!" << endl;
   parsers = SecondOrderConverter().convert_file(FLAGS_parse_file.c_str());
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "common.h"
+#include "MRF.h"
+#include "MRFLoopySolver.h"
+#include "MRFExpansionSolver.h"
+#include <gflags/gflags.h>
+using namespace std;
+
+DEFINE_string(mrf_prefix, "",
+              "Constraint MRF files, as for run_decomp_tagger (random groups if empty).");
+DEFINE_int32(start, 0,
+             "First MRF file.");
+DEFINE_int32(end, 0,
+             "Last MRF file.");
+DEFINE_int32(min_nodes, 10,
+             "Smallest random group.");
+DEFINE_int32(max_nodes, 160,
+             "Largest random group.");
+DEFINE_int32(nodes_step, 30,
+             "Step between random group sizes.");
+DEFINE_int32(tags, 45,
+             "Tags (state ids) in random groups.");
+DEFINE_int32(beam, 5,
+             "States per node in random groups.");
+DEFINE_double(penalty, 1.0,
+              "Bonus for equal tags in random groups (stored negated).");
+DEFINE_bool(hard, true,
+            "Write only equal pairs in random groups, as pos_constraints_mrf.py does.");
+DEFINE_double(value_weight, -1.0,
+              "Weight of the value feature, which scales the potentials.");
+DEFINE_int32(rounds, 20,
+             "Solves per group, each with new state costs.");
+DEFINE_int32(seed, 0,
+             "Random seed for random groups and state costs.");
+
+static double random_double() {
+  return rand() / (double)RAND_MAX;
+}
+
+// A group shaped like add_potts_edges: an edge between every pair of
+// nodes, with the bonus on pairs of equal tags. Every node has the
+// group's first tag, so hard groups have a consistent assignment.
+static graph::Graph * random_group(int num_nodes) {
+  graph::Graph * g = new graph::Graph();
+  g->set_label("random");
+  int common = rand() % FLAGS_tags;
+  vector <vector <int> > tags(num_nodes);
+  for (int i = 0; i < num_nodes; i++) {
+    graph::Graph_Node * node = g->add_node();
+    node->set_id(i);
+    node->set_label("node");
+    graph::MRFNode * mrf_node = node->MutableExtension(graph::mrf_node);
+    while ((int)tags[i].size() < min(FLAGS_beam, FLAGS_tags)) {
+      int tag = tags[i].empty() ? common : rand() % FLAGS_tags;
+      if (find(tags[i].begin(), tags[i].end(), tag) != tags[i].end()) continue;
+      tags[i].push_back(tag);
+      graph::NodeStatePotential * pot = mrf_node->add_node_potentials();
+      pot->mutable_state()->set_id(tag);
+      pot->mutable_state()->set_label("");
+      pot->set_node_potential(0.0);
+    }
+  }
+  for (int i = 0; i < num_nodes; i++) {
+    for (int j = i + 1; j < num_nodes; j++) {
+      graph::Graph_Edge * edge = g->mutable_node(i)->add_edge();
+      edge->set_to_node(j);
+      graph::MRFEdge * mrf_edge = edge->MutableExtension(graph::mrf_edge);
+      foreach (int s1, tags[i]) {
+        foreach (int s2, tags[j]) {
+          if (FLAGS_hard && s1 != s2) continue;
+          graph::EdgeStatePotential * pot = mrf_edge->add_edge_potentials();
+          pot->set_from_state_id(s1);
+          pot->set_to_state_id(s2);
+          pot->set_edge_potential((s1 == s2) ? -FLAGS_penalty : 0.0);
+        }
+      }
+    }
+  }
+  return g;
+}
+
+// Times alpha-expansion against MPLP, the route ConstrainerDual takes
+// for groups that are not trees, on the same sequence of state costs.
+int main(int argc, char ** argv) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  srand(FLAGS_seed);
+
+  vector <MRF *> mrfs;
+  if (FLAGS_mrf_prefix.empty()) {
+    for (int n = FLAGS_min_nodes; n <= FLAGS_max_nodes; n += FLAGS_nodes_step) {
+      MRF * mrf = new MRF();
+      mrf->build_from_proto(random_group(n));
+      mrfs.push_back(mrf);
+    }
+  } else {
+    for (int i = FLAGS_start; i <= FLAGS_end; i++) {
+      stringstream fname;
+      fname << FLAGS_mrf_prefix << i;
+      MRF * mrf = new MRF();
+      mrf->build_from_file(fname.str().c_str());
+      mrfs.push_back(mrf);
+    }
+  }
+
+  cout << "GROUP NODES EDGES MPLP_MS MPLP_BOUND MPLP_ENERGY CUT_MS CUT_BOUND CUT_ENERGY" << endl;
+  double total_mplp_ms = 0.0, total_cut_ms = 0.0;
+  for (int group = 0; group < mrfs.size(); group++) {
+    const MRF & mrf = *mrfs[group];
+    cout << group << " " << mrf.graph().num_nodes() << " "
+         << mrf.graph().num_edges();
+    if (!MRFExpansionSolver::is_potts(mrf, FLAGS_value_weight)) {
+      cout << " - - - - - -" << endl;
+      continue;
+    }
+
+    // Each round's costs stand in for the lagrange multipliers.
+    vector <vector <double> > state_costs(FLAGS_rounds);
+    for (int round = 0; round < FLAGS_rounds; round++) {
+      state_costs[round].resize(mrf.total_states());
+      for (int state = 0; state < mrf.total_states(); state++) {
+        state_costs[round][state] = random_double() - 0.5;
+      }
+    }
+
+    vector <int> assignment;
+    double primal;
+    MRFLoopySolver mplp(mrf);
+    double bound = 0.0, mplp_energy = 0.0;
+    double start = Clock::wall_ms();
+    for (int round = 0; round < FLAGS_rounds; round++) {
+      bound += mplp.solve(FLAGS_value_weight, state_costs[round],
+                          &assignment, &primal);
+      mplp_energy += mplp.energy();
+    }
+    double mplp_ms = Clock::wall_ms() - start;
+
+    MRFExpansionSolver cut(mrf);
+    double cut_bound = 0.0, cut_energy = 0.0;
+    start = Clock::wall_ms();
+    for (int round = 0; round < FLAGS_rounds; round++) {
+      cut_bound += cut.solve(FLAGS_value_weight, state_costs[round],
+                             &assignment, &primal);
+      cut_energy += cut.energy();
+    }
+    double cut_ms = Clock::wall_ms() - start;
+
+    total_mplp_ms += mplp_ms;
+    total_cut_ms += cut_ms;
+    cout << " " << mplp_ms << " " << bound << " " << mplp_energy
+         << " " << cut_ms << " " << cut_bound << " " << cut_energy << endl;
+  }
+  cout << "TOTAL MPLP_MS: " << total_mplp_ms
+       << " CUT_MS: " << total_cut_ms << endl;
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
@@ -9,6 +9,9 @@
 #include "trans_decode/Decode.h"
 #include "trans_decode/NGramCache.h"
 #include "optimization/Subgradient.h"
+#include "optimization/DualOptimizers.h"
+#include "optimization/Telemetry.h"
+#include "LMNonLocal.h"
 #include "dual_nonlocal.h"
 #include "./CommandLine.h"
 #include "./Rates.h"
@@ -21,6 +24,18 @@ DEFINE_string(lattice_prefix, "", "prefix of the lattice files");
 DEFINE_string(forest_range, "", "range of forests to use (i.e. '0 10')");
 DEFINE_bool(approx_mode, false, "Use approximate LM updates.");
 DEFINE_string(ilp_mode, "proj", "Method to use for tightening.");
+DEFINE_string(dual_optimizer, "subgradient",
+              "Dual update: subgradient, bundle or nesterov.");
+DEFINE_double(dual_step, 1.0, "Step size multiplier for nesterov.");
+DEFINE_double(example_time_ms, 0.0,
+              "Wall clock budget per sentence in ms (0 for none).");
+DEFINE_double(total_time_ms, 0.0,
+              "Wall clock budget for all sentences in ms (0 for none).");
+DEFINE_bool(cube_fallback, false,
+            "Use the cube pruning result when it beats the best primal.");
+DEFINE_int32(threads, 1, "Number of threads for the trigram subproblem.");
+DEFINE_string(telemetry_file, "",
+              "Write per round records here (.csv for CSV, else JSON lines).");
 
 static const bool forest_dummy =
     RegisterFlagValidator(&FLAGS_forest_prefix, &ValidateReq);
@@ -29,36 +44,18 @@ static const bool lattice_dummy =
 static const bool range_dummy =
     RegisterFlagValidator(&FLAGS_forest_range, &ValidateRange);
 
-// Build a cache mapping each node to its LM index.
-Cache<Hypernode, int > *cache_word_nodes(Ngram lm, const Forest & forest) {
-  int max = lm.vocab.numWords();
-  int unk = lm.vocab.getIndex(Vocab_Unknown);
-
-  Cache<Hypernode, int > *words =
-      new Cache <Hypernode, int >(forest.num_nodes());
-  foreach (HNode hnode, forest.nodes()) {
-    const ForestNode & node = *(static_cast<const ForestNode*>(hnode));
-    if (node.is_word()) {
-      string str = node.word();
-      int ind = lm.vocab.getIndex(str.c_str());
-      // Unknown cases.
-      if (ind == -1 || ind > max) {
-        words->set_value(node, unk);
-      } else {
-        words->set_value(node, ind);
-      }
-    }
-  }
-  return words;
-}
-
 int main(int argc, char ** argv) {
   srand(0);
   GOOGLE_PROTOBUF_VERIFY_VERSION;
   google::ParseCommandLineFlags(&argc, &argv, true);
 
   wvector * weight = cmd_weights();
-  NgramCache * lm = cmd_lm();
+  LanguageModel * lm = cmd_language_model();
+  TelemetrySink * telemetry = telemetry_from_file(FLAGS_telemetry_file);
+  double deadline = 0.0;
+  if (FLAGS_total_time_ms > 0.0) {
+    deadline = Clock::wall_ms() + FLAGS_total_time_ms;
+  }
 
   istringstream range(FLAGS_forest_range);
   int start_range, end_range;
@@ -94,13 +91,26 @@ int main(int argc, char ** argv) {
     Decode * d = new Decode(f, graph, *weight, *lm);
     d->set_approx_mode(FLAGS_approx_mode);
     d->set_cached_words(words);
+    d->set_num_threads(FLAGS_threads);
     // Solve
     cout << i << " ";
     PolyakTranslationRate tr(cube_v);
     // TranslationRate tr;
-    Subgradient * s = new Subgradient(*d, tr);
+    // The decoder has no smoothed subproblem, so nesterov runs
+    // as accelerated subgradient with a fixed step.
+    DualOptimizer * optimizer =
+        dual_optimizer_from_name(FLAGS_dual_optimizer, 0.0, FLAGS_dual_step);
+    Subgradient * s;
+    if (optimizer != NULL) {
+      s = new Subgradient(*d, *optimizer);
+    } else {
+      s = new Subgradient(*d, tr);
+    }
 
     s->set_max_rounds(500);
+    s->set_telemetry(telemetry);
+    s->set_time_limit(FLAGS_example_time_ms);
+    s->set_deadline(deadline);
     int mode;
     if (FLAGS_ilp_mode == "proj") {
       mode = Decode::kProjecting;
@@ -117,8 +127,27 @@ int main(int argc, char ** argv) {
     s->solve(i);
     double v = s->best_primal();
     clock_t end = clock();
+
+    // Anytime answer. The dual is a lower bound for the cube
+    // result as well, so the gap still certifies it.
+    string source = "dual";
+    if (!s->found_certificate() && FLAGS_cube_fallback && success &&
+        cube_v < v) {
+      v = cube_v;
+      source = "cube";
+    }
     cout << "*END*" << i << " "<< v << "  "
          << Clock::diffclock(end, begin) << endl;
+    cout << "*CERT*" << i << " " << source
+         << " timed_out " << s->timed_out()
+         << " bound " << s->best_dual()
+         << " gap " << fabs(v - s->best_dual()) << endl;
+    const LatticeLMTable & table = d->lm_table();
+    cout << "*LMTABLE*" << i << " build_calls " << table.model_calls()
+         << " lookups " << table.lookups()
+         << " saved " << table.lookups() - table.misses() << endl;
+    delete s;
+    delete optimizer;
     delete d;
   }
   google::protobuf::ShutdownProtobufLibrary();
@@ -0,0 +1,94 @@
+#include "Weights.h"
+#include "DepParser.h"
+#include <HypergraphAlgorithms.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include "common.h"
+#include "parse/SOEisnerToHypergraph.h"
+#include "parse/SOEisner.h"
+#include <gflags/gflags.h>
+using namespace std;
+using namespace Scarab::HG;
+
+DEFINE_int32(min_length, 10,
+             "Shortest sentence to time.");
+DEFINE_int32(max_length, 150,
+             "Longest sentence to time.");
+DEFINE_int32(length_step, 20,
+             "Step between sentence lengths.");
+DEFINE_int32(hypergraph_max_length, 150,
+             "Skip the hypergraph route for longer sentences.");
+DEFINE_int32(seed, 0,
+             "Random seed for the sibling scores.");
+
+// Times second-order parsing of random sentences with SOEisnerParser
+// against building and searching the EisnerToHypergraph hypergraph.
+int main(int argc, char ** argv) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  srand(FLAGS_seed);
+
+  wvector * value = svector_from_str<int, double>("value=1");
+  cout << "LENGTH CHART_MS HYPERGRAPH_BUILD_MS HYPERGRAPH_SEARCH_MS MATCH" << endl;
+  for (int n = FLAGS_min_length; n <= FLAGS_max_length; n += FLAGS_length_step) {
+    SiblingScores scores(n);
+    vector<vector <vector<double > > > weights(n);
+    for (int h = 0; h < n; h++) {
+      weights[h].resize(n);
+      for (int s = 0; s < n; s++) {
+        weights[h][s].resize(n);
+        for (int m = 0; m < n; m++) {
+          double w = -rand() / (double)RAND_MAX;
+          weights[h][s][m] = w;
+          scores.set_score(h, s, m, w);
+        }
+      }
+    }
+
+    SOEisnerParser eisner;
+    vector<Dependency> deps;
+    double start = Clock::wall_ms();
+    double chart_score = eisner.parse(scores, &deps);
+    double chart_ms = Clock::wall_ms() - start;
+
+    cout << n << " " << chart_ms;
+    if (n > FLAGS_hypergraph_max_length) {
+      cout << " - - -" << endl;
+      continue;
+    }
+
+    start = Clock::wall_ms();
+    vector <int> sent;
+    for (int i = 0; i < n; i++) {
+      sent.push_back(i);
+    }
+    Hypergraph tmp;
+    EisnerToHypergraph runner(sent, weights);
+    runner.convert(tmp);
+    runner.hgraph.SetExtension(len, n - 1);
+    DepParser parser;
+    parser.build_from_proto(&runner.hgraph);
+    double build_ms = Clock::wall_ms() - start;
+
+    start = Clock::wall_ms();
+    HypergraphAlgorithms ha(parser);
+    EdgeCache * edge_weights = ha.cache_edge_weights(*value);
+    NodeCache score_memo_table(parser.num_nodes());
+    NodeBackCache back_memo_table(parser.num_nodes());
+    double hyp_score = ha.best_path(*edge_weights, score_memo_table,
+                                    back_memo_table);
+    double search_ms = Clock::wall_ms() - start;
+    delete edge_weights;
+
+    bool match = fabs(hyp_score - chart_score) < 1e-6;
+    cout << " " << build_ms << " " << search_ms << " "
+         << (match ? "yes" : "NO") << endl;
+  }
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
@@ -0,0 +1,436 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "hypergraph/Weights.h"
+#include "transforest/Forest.h"
+
+#include "lattice/ForestLattice.h"
+#include "trans_decode/Decode.h"
+#include "trans_decode/NGramCache.h"
+#include "optimization/Subgradient.h"
+#include "optimization/ThreadPool.h"
+#include "LMNonLocal.h"
+#include "./CommandLine.h"
+#include "./Rates.h"
+
+using namespace std;
+
+// Decoding server. Loads the weights and language model once, then
+// reads requests, one per line:
+//
+//   <id> <forest_file> <lattice_file>
+//
+// from stdin or from clients of a Unix domain socket, and answers
+//
+//   <id> ok primal <p> dual <d> gap <g> status <s> rounds <r>
+//        queue_ms <q> load_ms <l> decode_ms <t>
+//
+// (one line), or "<id> error <message>". Answers come back in the
+// order requests finish. A "quit" line stops the server once the
+// queued requests are done. Decoder logging goes to stderr.
+
+DEFINE_string(socket, "", "Unix domain socket to serve on (stdin if empty).");
+DEFINE_int32(workers, 1,
+             "Requests decoded at once. Use a binary LM for more than one, "
+             "SRILM models are only read but are not built for it.");
+DEFINE_int32(max_rounds, 500, "Subgradient rounds per request.");
+DEFINE_double(example_time_ms, 0.0,
+              "Wall clock budget per request in ms (0 for none).");
+DEFINE_bool(approx_mode, false, "Use approximate LM updates.");
+
+// Where the answers to requests go. Shared by all the requests read
+// from one client and freed when the client is done and answered.
+struct Client {
+  Client(int in, int out, bool owns_fd)
+      : in_fd(in), out_fd(out), owns_fd(owns_fd),
+        pending(0), done_reading(false), gone(false) {
+    pthread_mutex_init(&lock, NULL);
+  }
+
+  ~Client() {
+    if (owns_fd) close(out_fd);
+    pthread_mutex_destroy(&lock);
+  }
+
+  int in_fd;
+  int out_fd;
+  bool owns_fd;
+
+  // Protects the fields below and writes to out_fd.
+  pthread_mutex_t lock;
+  int pending;
+  bool done_reading;
+
+  // Set when a write fails, usually because the client hung up. Its
+  // queued requests are then dropped without decoding.
+  bool gone;
+};
+
+struct Request {
+  int number;
+  string id;
+  string forest_file;
+  string lattice_file;
+  Client * client;
+  double received_ms;
+};
+
+static bool file_exists(const string & file_name) {
+  struct stat st;
+  return stat(file_name.c_str(), &st) == 0;
+}
+
+// False if the write failed (EPIPE when the reader has gone).
+static bool write_all(int fd, const string & text) {
+  const char * data = text.c_str();
+  size_t left = text.size();
+  while (left > 0) {
+    ssize_t written = write(fd, data, left);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    left -= written;
+  }
+  return true;
+}
+
+// Read a line from fd, buffer keeps what was read past it.
+static bool read_line(int fd, string & buffer, string & line) {
+  while (true) {
+    size_t end = buffer.find('\n');
+    if (end != string::npos) {
+      line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      return true;
+    }
+    char chunk[4096];
+    ssize_t got = read(fd, chunk, sizeof(chunk));
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) {
+      line = buffer;
+      buffer.clear();
+      return !line.empty();
+    }
+    buffer.append(chunk, got);
+  }
+}
+
+/**
+ * Queue of decode requests worked off by a pool of threads. Each
+ * item handed to the pool is one worker, which decodes requests
+ * until the queue is closed and empty.
+ */
+class DecodeServer : public ParallelTask {
+ public:
+  DecodeServer(const wvector & weight, const LanguageModel & lm)
+      : _weight(weight), _lm(lm), _closed(false), _next_number(0),
+        _listen_fd(-1) {
+    pthread_mutex_init(&_lock, NULL);
+    pthread_mutex_init(&_load_lock, NULL);
+    pthread_cond_init(&_ready, NULL);
+  }
+
+  ~DecodeServer() {
+    pthread_cond_destroy(&_ready);
+    pthread_mutex_destroy(&_load_lock);
+    pthread_mutex_destroy(&_lock);
+  }
+
+  void run_item(int worker, int thread_id) {
+    Request request;
+    while (pop(request)) {
+      handle(request);
+    }
+  }
+
+  // Read requests from client until it closes or asks to quit.
+  void serve_client(Client * client);
+
+  // Stop taking requests, the workers finish the queue and return.
+  void close_queue();
+
+  void set_listen_fd(int fd) { _listen_fd = fd; }
+
+ private:
+  bool push(Request & request);
+  bool pop(Request & request);
+  void handle(const Request & request);
+  void reply(Client * client, const string & text);
+  void finish(Client * client);
+
+  const wvector & _weight;
+  const LanguageModel & _lm;
+
+  pthread_mutex_t _lock;
+  pthread_cond_t _ready;
+  deque<Request> _queue;
+  bool _closed;
+  int _next_number;
+  int _listen_fd;
+
+  // Forest loading fills the shared feature numberizer, so only one
+  // request loads at a time.
+  pthread_mutex_t _load_lock;
+};
+
+bool DecodeServer::push(Request & request) {
+  pthread_mutex_lock(&_lock);
+  if (_closed) {
+    pthread_mutex_unlock(&_lock);
+    return false;
+  }
+  request.number = _next_number++;
+  _queue.push_back(request);
+  pthread_cond_signal(&_ready);
+  pthread_mutex_unlock(&_lock);
+  return true;
+}
+
+bool DecodeServer::pop(Request & request) {
+  pthread_mutex_lock(&_lock);
+  while (_queue.empty() && !_closed) {
+    pthread_cond_wait(&_ready, &_lock);
+  }
+  if (_queue.empty()) {
+    pthread_mutex_unlock(&_lock);
+    return false;
+  }
+  request = _queue.front();
+  _queue.pop_front();
+  pthread_mutex_unlock(&_lock);
+  return true;
+}
+
+void DecodeServer::close_queue() {
+  pthread_mutex_lock(&_lock);
+  _closed = true;
+  pthread_cond_broadcast(&_ready);
+  if (_listen_fd != -1) {
+    // Wakes up the accept loop.
+    shutdown(_listen_fd, SHUT_RDWR);
+  }
+  pthread_mutex_unlock(&_lock);
+}
+
+void DecodeServer::reply(Client * client, const string & text) {
+  pthread_mutex_lock(&client->lock);
+  if (!client->gone && !write_all(client->out_fd, text + "\n")) {
+    cerr << "Client gone (" << strerror(errno) << "), dropping its answers"
+         << endl;
+    client->gone = true;
+  }
+  pthread_mutex_unlock(&client->lock);
+}
+
+void DecodeServer::finish(Client * client) {
+  pthread_mutex_lock(&client->lock);
+  client->pending--;
+  bool done = client->done_reading && client->pending == 0;
+  pthread_mutex_unlock(&client->lock);
+  if (done) delete client;
+}
+
+void DecodeServer::serve_client(Client * client) {
+  string buffer, line;
+  while (read_line(client->in_fd, buffer, line)) {
+    istringstream tokens(line);
+    Request request;
+    if (!(tokens >> request.id)) continue;
+    if (request.id == "quit") {
+      close_queue();
+      break;
+    }
+    if (!(tokens >> request.forest_file >> request.lattice_file)) {
+      reply(client, request.id + " error expected <id> <forest> <lattice>");
+      continue;
+    }
+    request.client = client;
+    request.received_ms = Clock::wall_ms();
+
+    pthread_mutex_lock(&client->lock);
+    client->pending++;
+    pthread_mutex_unlock(&client->lock);
+    if (!push(request)) {
+      reply(client, request.id + " error server is shutting down");
+      finish(client);
+    }
+  }
+
+  pthread_mutex_lock(&client->lock);
+  client->done_reading = true;
+  bool done = client->pending == 0;
+  pthread_mutex_unlock(&client->lock);
+  if (done) delete client;
+}
+
+void DecodeServer::handle(const Request & request) {
+  double start = Clock::wall_ms();
+  pthread_mutex_lock(&request.client->lock);
+  bool gone = request.client->gone;
+  pthread_mutex_unlock(&request.client->lock);
+  if (gone) {
+    finish(request.client);
+    return;
+  }
+  if (!file_exists(request.forest_file) ||
+      !file_exists(request.lattice_file)) {
+    reply(request.client, request.id + " error missing forest or lattice");
+    finish(request.client);
+    return;
+  }
+
+  pthread_mutex_lock(&_load_lock);
+  Forest f = Forest::from_file(request.forest_file.c_str());
+  ForestLattice graph = ForestLattice::from_file(request.lattice_file);
+  Cache<Hypernode, int> * words = cache_word_nodes(_lm, f);
+  HypergraphAlgorithms ha(f);
+  Cache<Hyperedge, double> * w = ha.cache_edge_weights(_weight);
+  pthread_mutex_unlock(&_load_lock);
+  double loaded = Clock::wall_ms();
+
+  LMNonLocal non_local(f, _lm, lm_weight(), *words, true);
+  CubePruning p(f, *w, non_local, 10, 3);
+  bool success;
+  double cube_v = p.parse(&success);
+
+  Decode d(f, graph, _weight, _lm);
+  d.set_approx_mode(FLAGS_approx_mode);
+  d.set_cached_words(words);
+  d.set_ilp_mode(Decode::kProjecting);
+  PolyakTranslationRate tr(cube_v);
+  Subgradient s(d, tr);
+  s.set_max_rounds(FLAGS_max_rounds);
+  s.set_time_limit(FLAGS_example_time_ms);
+  s.set_exit_on_failure(false);
+  s.solve(request.number);
+  double end = Clock::wall_ms();
+
+  ostringstream out;
+  out << request.id << " ok"
+      << " primal " << s.best_primal()
+      << " dual " << s.best_dual()
+      << " gap " << s.gap()
+      << " status " << s.status()
+      << " rounds " << s.rounds()
+      << fixed << setprecision(1)
+      << " queue_ms " << start - request.received_ms
+      << " load_ms " << loaded - start
+      << " decode_ms " << end - loaded;
+  reply(request.client, out.str());
+  finish(request.client);
+
+  delete w;
+  delete words;
+}
+
+static void * read_stdin(void * arg) {
+  DecodeServer * server = (DecodeServer *)arg;
+  server->serve_client(new Client(0, 1, false));
+  server->close_queue();
+  return NULL;
+}
+
+struct ClientArg {
+  DecodeServer * server;
+  Client * client;
+};
+
+static void * read_client(void * varg) {
+  ClientArg * arg = (ClientArg *)varg;
+  arg->server->serve_client(arg->client);
+  delete arg;
+  return NULL;
+}
+
+static int listen_on(const string & path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, 16) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void * accept_clients(void * arg) {
+  DecodeServer * server = (DecodeServer *)arg;
+  int listen_fd = listen_on(FLAGS_socket);
+  if (listen_fd < 0) {
+    cerr << "Could not listen on " << FLAGS_socket << ": "
+         << strerror(errno) << endl;
+    server->close_queue();
+    return NULL;
+  }
+  server->set_listen_fd(listen_fd);
+  cerr << "LISTENING " << FLAGS_socket << endl;
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    ClientArg * client_arg = new ClientArg();
+    client_arg->server = server;
+    client_arg->client = new Client(fd, fd, true);
+    pthread_t reader;
+    pthread_create(&reader, NULL, &read_client, client_arg);
+    pthread_detach(reader);
+  }
+  close(listen_fd);
+  unlink(FLAGS_socket.c_str());
+  return NULL;
+}
+
+int main(int argc, char ** argv) {
+  srand(0);
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  double load_begin = Clock::wall_ms();
+  wvector * weight = cmd_weights();
+  LanguageModel * lm = cmd_language_model();
+  cerr << "MODELS LOADED " << Clock::wall_ms() - load_begin << " ms" << endl;
+
+  // stdout only carries answers.
+  cout.rdbuf(cerr.rdbuf());
+
+  // A client that hangs up before its answer should not take the
+  // server down; the write fails with EPIPE instead.
+  signal(SIGPIPE, SIG_IGN);
+
+  DecodeServer server(*weight, *lm);
+  pthread_t reader;
+  if (FLAGS_socket.empty()) {
+    pthread_create(&reader, NULL, &read_stdin, &server);
+  } else {
+    pthread_create(&reader, NULL, &accept_clients, &server);
+  }
+
+  ThreadPool pool(FLAGS_workers);
+  pool.run(server, FLAGS_workers);
+  pthread_join(reader, NULL);
+
+  google::protobuf::ShutdownProtobufLibrary();
+  return 0;
+}
@@ -25,7 +25,7 @@ int main(int argc, char ** argv) {
 
     stringstream fname;
     fname << argv[2] << i;
-    Tagger f(200);// = new DepParser();
+    Tagger f;// = new DepParser();
     f.build_from_file(fname.str().c_str());
     
     //bool lp = (int)atoi(argv[3]);
@@ -11,6 +11,8 @@
 #define COMMON_H
 
 #include <boost/foreach.hpp> 
+#include <sys/time.h>
+#include <time.h>
 //#define LMWEIGHT -0.141221
 #define foreach BOOST_FOREACH
 #define INF 1e8
@@ -24,6 +26,21 @@ class Clock {
     double diffms=(diffticks*1000)/CLOCKS_PER_SEC;
     return diffms;
   }
+
+  // Wall clock time in ms (clock() is process cpu time, which
+  // overcounts when several threads are running).
+  static double wall_ms() {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+  }
+
+  // Cpu time in ms used by the calling thread only.
+  static double thread_cpu_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+  }
 };
 
 #endif
@@ -26,7 +26,7 @@ def doubles(handle):
 double_map = doubles(open(argv[1]))
 print double_map
 wc = pickle.load(open(argv[2]))
-marginals = Marginals.from_handle(open(argv[3]))
+marginals = Marginals.from_file(argv[3])
 unmapper = Unmapper()
 
 files = map(open,argv[4:])
@@ -1,16 +1,40 @@
+import array
 
 class Marginals:
+  # The text dump of marginals --text, 'sent pos tag marg' per line.
   @staticmethod
   def from_handle(handle):
     data = []
     sent_num = -1
     for l in handle:
-      if l.strip().split()[0] == "SENT": 
-        sent_num = int(l.strip().split()[1])
-      else:
-        a, b, prob, c, d , tag= l.strip().split()
+      t = l.strip().split()
+      if not t: continue
+      if t[0] == "SENT": 
+        # The old inside/outside dump.
+        sent_num = int(t[1])
+      elif t[0] == "Node":
+        a, b, prob, c, d , tag= t
         ind,tag = tag.split('/')
         data.append(((sent_num, int(ind), int(tag)), float(prob)))
+      else:
+        sent, ind, tag, prob = t
+        data.append(((int(sent), int(ind), int(tag)), float(prob)))
+    return Marginals(data)
+
+  # The binary records of marginals --output_file, (int32 sentence,
+  # int32 position, int32 tag, float32 marginal) in native byte order.
+  @staticmethod
+  def from_file(file_name):
+    ints = array.array('i')
+    floats = array.array('f')
+    assert ints.itemsize == 4 and floats.itemsize == 4
+    raw = open(file_name, 'rb').read()
+    assert len(raw) % 16 == 0, "%s is cut short" % file_name
+    ints.fromstring(raw)
+    floats.fromstring(raw)
+    data = []
+    for r in range(0, len(ints), 4):
+      data.append(((ints[r], ints[r + 1], ints[r + 2]), floats[r + 3]))
     return Marginals(data)
 
   def __init__(self, data):
@@ -49,7 +49,7 @@ public:
   
   // This code should solve a single sentence with the lagrangian vector _cur_weights. 
   // dual should get the dual value and subgrad the result. Ignore primal for now. 
-  void solve_one(int sent_num, double & dual, double & primal, wvector & subgrad) {
+  void solve_one(int sent_num, int thread_id, double & dual, double & primal, wvector & subgrad) {
     cout << endl << "Sent: " << sent_num << endl;
     
     // For each word in the sentence. 
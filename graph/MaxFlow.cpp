@@ -0,0 +1,261 @@
+#include "MaxFlow.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace Scarab {
+namespace Graph {
+
+void MaxFlow::reset(int num_nodes) {
+  _tr_cap.assign(num_nodes, 0.0);
+  _first.assign(num_nodes, -1);
+  _parent.assign(num_nodes, NONE);
+  _is_sink.assign(num_nodes, false);
+  _active.assign(num_nodes, false);
+  _ts.assign(num_nodes, 0);
+  _dist.assign(num_nodes, 0);
+  _head.clear();
+  _next.clear();
+  _r_cap.clear();
+  _active_queue.clear();
+  _orphans.clear();
+  _flow = 0.0;
+}
+
+void MaxFlow::add_terminal(int node, double source_cap, double sink_cap) {
+  double delta = _tr_cap[node];
+  if (delta > 0) {
+    source_cap += delta;
+  } else {
+    sink_cap -= delta;
+  }
+  _flow += min(source_cap, sink_cap);
+  _tr_cap[node] = source_cap - sink_cap;
+}
+
+void MaxFlow::add_edge(int from, int to, double cap, double rev_cap) {
+  int arc = _head.size();
+  _head.push_back(to);
+  _next.push_back(_first[from]);
+  _r_cap.push_back(cap);
+  _first[from] = arc;
+
+  _head.push_back(from);
+  _next.push_back(_first[to]);
+  _r_cap.push_back(rev_cap);
+  _first[to] = arc + 1;
+}
+
+void MaxFlow::set_active(int node) {
+  if (!_active[node]) {
+    _active[node] = true;
+    _active_queue.push_back(node);
+  }
+}
+
+int MaxFlow::next_active() {
+  while (!_active_queue.empty()) {
+    int node = _active_queue.front();
+    _active_queue.pop_front();
+    _active[node] = false;
+    if (_parent[node] != NONE) return node;
+  }
+  return -1;
+}
+
+void MaxFlow::set_orphan_front(int node) {
+  _parent[node] = ORPHAN;
+  _orphans.push_front(node);
+}
+
+void MaxFlow::set_orphan_rear(int node) {
+  _parent[node] = ORPHAN;
+  _orphans.push_back(node);
+}
+
+void MaxFlow::augment(int middle) {
+  // The middle arc goes from a source tree node to a sink tree node.
+  // Parent arcs point from a node to its parent, so flow runs along
+  // their reverse in the source tree and along them in the sink tree.
+  double bottleneck = _r_cap[middle];
+  int node;
+  for (node = _head[middle ^ 1]; _parent[node] != TERMINAL;
+       node = _head[_parent[node]]) {
+    bottleneck = min(bottleneck, _r_cap[_parent[node] ^ 1]);
+  }
+  bottleneck = min(bottleneck, _tr_cap[node]);
+  for (node = _head[middle]; _parent[node] != TERMINAL;
+       node = _head[_parent[node]]) {
+    bottleneck = min(bottleneck, _r_cap[_parent[node]]);
+  }
+  bottleneck = min(bottleneck, -_tr_cap[node]);
+
+  _r_cap[middle ^ 1] += bottleneck;
+  _r_cap[middle] -= bottleneck;
+
+  node = _head[middle ^ 1];
+  while (_parent[node] != TERMINAL) {
+    int arc = _parent[node];
+    _r_cap[arc] += bottleneck;
+    _r_cap[arc ^ 1] -= bottleneck;
+    if (_r_cap[arc ^ 1] <= 0) set_orphan_front(node);
+    node = _head[arc];
+  }
+  _tr_cap[node] -= bottleneck;
+  if (_tr_cap[node] <= 0) set_orphan_front(node);
+
+  node = _head[middle];
+  while (_parent[node] != TERMINAL) {
+    int arc = _parent[node];
+    _r_cap[arc ^ 1] += bottleneck;
+    _r_cap[arc] -= bottleneck;
+    if (_r_cap[arc] <= 0) set_orphan_front(node);
+    node = _head[arc];
+  }
+  _tr_cap[node] += bottleneck;
+  if (_tr_cap[node] >= 0) set_orphan_front(node);
+
+  _flow += bottleneck;
+}
+
+// Distance from node to its terminal, or INT_MAX if the path ends in an
+// orphan. Marks the path so later searches this round stop early.
+int MaxFlow::origin_distance(int start) {
+  int d = 0;
+  int node = start;
+  while (true) {
+    if (_ts[node] == _time) {
+      d += _dist[node];
+      break;
+    }
+    int arc = _parent[node];
+    d++;
+    if (arc == TERMINAL) {
+      _ts[node] = _time;
+      _dist[node] = 1;
+      break;
+    }
+    if (arc == ORPHAN) return INT_MAX;
+    node = _head[arc];
+  }
+  int mark = d;
+  for (node = start; _ts[node] != _time; node = _head[_parent[node]]) {
+    _ts[node] = _time;
+    _dist[node] = mark--;
+  }
+  return d;
+}
+
+void MaxFlow::process_orphan(int node) {
+  bool sink = _is_sink[node];
+  int best_arc = NONE;
+  int best_dist = INT_MAX;
+
+  // A new parent must be in the same tree, joined by a residual arc
+  // toward the terminal, and not lead back to an orphan.
+  for (int arc = _first[node]; arc != -1; arc = _next[arc]) {
+    double cap = sink ? _r_cap[arc] : _r_cap[arc ^ 1];
+    if (cap <= 0) continue;
+    int other = _head[arc];
+    if (_is_sink[other] != sink || _parent[other] == NONE) continue;
+    int d = origin_distance(other);
+    if (d < best_dist) {
+      best_dist = d;
+      best_arc = arc;
+    }
+  }
+
+  if (best_arc != NONE) {
+    _parent[node] = best_arc;
+    _ts[node] = _time;
+    _dist[node] = best_dist + 1;
+    return;
+  }
+
+  // No parent; the node goes free and its children become orphans.
+  _parent[node] = NONE;
+  for (int arc = _first[node]; arc != -1; arc = _next[arc]) {
+    int other = _head[arc];
+    int parent = _parent[other];
+    if (_is_sink[other] != sink || parent == NONE) continue;
+    double cap = sink ? _r_cap[arc] : _r_cap[arc ^ 1];
+    if (cap > 0) set_active(other);
+    if (parent != TERMINAL && parent != ORPHAN && _head[parent] == node) {
+      set_orphan_rear(other);
+    }
+  }
+}
+
+double MaxFlow::solve() {
+  _active_queue.clear();
+  _orphans.clear();
+  _time = 0;
+  for (int node = 0; node < num_nodes(); node++) {
+    _active[node] = false;
+    _ts[node] = 0;
+    if (_tr_cap[node] > 0) {
+      _is_sink[node] = false;
+      _parent[node] = TERMINAL;
+      _dist[node] = 1;
+      set_active(node);
+    } else if (_tr_cap[node] < 0) {
+      _is_sink[node] = true;
+      _parent[node] = TERMINAL;
+      _dist[node] = 1;
+      set_active(node);
+    } else {
+      _parent[node] = NONE;
+    }
+  }
+
+  int current = -1;
+  while (true) {
+    int node = current;
+    if (node != -1 && _parent[node] == NONE) node = -1;
+    if (node == -1) {
+      node = next_active();
+      if (node == -1) break;
+    }
+
+    // Grow the node's tree by one layer, stopping at an arc into the
+    // other tree.
+    int middle = -1;
+    for (int arc = _first[node]; arc != -1; arc = _next[arc]) {
+      double cap = _is_sink[node] ? _r_cap[arc ^ 1] : _r_cap[arc];
+      if (cap <= 0) continue;
+      int other = _head[arc];
+      if (_parent[other] == NONE) {
+        _is_sink[other] = _is_sink[node];
+        _parent[other] = arc ^ 1;
+        _ts[other] = _ts[node];
+        _dist[other] = _dist[node] + 1;
+        set_active(other);
+      } else if (_is_sink[other] != _is_sink[node]) {
+        middle = _is_sink[node] ? (arc ^ 1) : arc;
+        break;
+      } else if (_ts[other] <= _ts[node] && _dist[other] > _dist[node]) {
+        // Shorten the other node's path to its terminal.
+        _parent[other] = arc ^ 1;
+        _ts[other] = _ts[node];
+        _dist[other] = _dist[node] + 1;
+      }
+    }
+
+    _time++;
+    if (middle == -1) {
+      current = -1;
+      continue;
+    }
+    current = node;
+    augment(middle);
+    while (!_orphans.empty()) {
+      int orphan = _orphans.front();
+      _orphans.pop_front();
+      process_orphan(orphan);
+    }
+  }
+  return _flow;
+}
+
+}
+}
@@ -0,0 +1,88 @@
+#ifndef MAXFLOW_H_
+#define MAXFLOW_H_
+#include <deque>
+#include <vector>
+using namespace std;
+
+namespace Scarab {
+namespace Graph {
+
+/**
+ * Minimum s-t cut by the Boykov-Kolmogorov max-flow algorithm (search
+ * trees grown from both terminals and reused between augmentations),
+ * the usual choice for the grid-like and dense small graphs that come
+ * out of energy minimization. Nodes are 0 .. num_nodes - 1 and link to
+ * the terminals through add_terminal. Buffers are kept across reset,
+ * so one object can solve many cuts.
+ */
+class MaxFlow {
+ public:
+  MaxFlow() : _flow(0.0) {}
+
+  /**
+   * Clear the graph and make room for num_nodes nodes.
+   */
+  void reset(int num_nodes);
+
+  int num_nodes() const { return _tr_cap.size(); }
+
+  /**
+   * Add capacity from the source to node and from node to the sink.
+   * Only the difference is kept; the smaller part is flow already.
+   */
+  void add_terminal(int node, double source_cap, double sink_cap);
+
+  /**
+   * Add an edge from -> to with capacity cap, and to -> from with rev_cap.
+   */
+  void add_edge(int from, int to, double cap, double rev_cap);
+
+  /**
+   * @return The value of the maximum flow (and the minimum cut)
+   */
+  double solve();
+
+  /**
+   * After solve, whether the node is cut off from the source. Nodes
+   * tied between the sides are put with the source.
+   */
+  bool in_sink_set(int node) const {
+    return _parent[node] != NONE && _is_sink[node];
+  }
+
+ private:
+  // Parent markers besides an arc index.
+  enum { NONE = -1, TERMINAL = -2, ORPHAN = -3 };
+
+  // Residual capacity to the sink if negative, from the source if
+  // positive.
+  vector <double> _tr_cap;
+  vector <int> _first;
+  vector <int> _parent;
+  vector <bool> _is_sink;
+  vector <bool> _active;
+  vector <int> _ts;
+  vector <int> _dist;
+
+  // Arcs come in pairs, arc ^ 1 is the reverse of arc.
+  vector <int> _head;
+  vector <int> _next;
+  vector <double> _r_cap;
+
+  deque <int> _active_queue;
+  deque <int> _orphans;
+  int _time;
+  double _flow;
+
+  void set_active(int node);
+  int next_active();
+  void set_orphan_front(int node);
+  void set_orphan_rear(int node);
+  void augment(int middle);
+  void process_orphan(int node);
+  int origin_distance(int node);
+};
+
+}
+}
+#endif
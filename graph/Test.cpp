@@ -0,0 +1,117 @@
+#include <cpptest.h>
+#include <cpptest-suite.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "MaxFlow.h"
+using namespace Test;
+using namespace std;
+using namespace Scarab::Graph;
+
+static double random_double() {
+  return rand() / (double)RAND_MAX;
+}
+
+class MaxFlowTestSuite : public Test::Suite
+{
+public:
+
+  MaxFlowTestSuite() {
+    TEST_ADD(MaxFlowTestSuite::min_cut_test);
+    TEST_ADD(MaxFlowTestSuite::reuse_test);
+  }
+
+private:
+  // Terminal and edge capacities of a random graph, as added.
+  struct Cut {
+    vector <double> source_cap, sink_cap;
+    vector <vector <double> > cap;
+
+    // A node in the sink set pays its source link, one with the source
+    // its sink link, and an edge pays if it goes from source to sink.
+    double cost(const vector <bool> & in_sink) const {
+      double total = 0.0;
+      for (int i = 0; i < in_sink.size(); i++) {
+        total += in_sink[i] ? source_cap[i] : sink_cap[i];
+        for (int j = 0; j < in_sink.size(); j++) {
+          if (!in_sink[i] && in_sink[j]) total += cap[i][j];
+        }
+      }
+      return total;
+    }
+  };
+
+  void random_cut(int n, MaxFlow * flow, Cut * cut) {
+    flow->reset(n);
+    cut->source_cap.assign(n, 0.0);
+    cut->sink_cap.assign(n, 0.0);
+    cut->cap.assign(n, vector <double>(n, 0.0));
+    for (int i = 0; i < n; i++) {
+      // Some nodes get two terminal links, some none on one side.
+      int links = (rand() % 4 == 0) ? 2 : 1;
+      for (int l = 0; l < links; l++) {
+        double s = (rand() % 3 == 0) ? 0.0 : random_double() * 3;
+        double t = (rand() % 3 == 0) ? 0.0 : random_double() * 3;
+        flow->add_terminal(i, s, t);
+        cut->source_cap[i] += s;
+        cut->sink_cap[i] += t;
+      }
+    }
+    int num_edges = rand() % (n * n + 1);
+    for (int e = 0; e < num_edges; e++) {
+      int i = rand() % n, j = rand() % n;
+      if (i == j) continue;
+      double cap = (rand() % 2) ? random_double() * 2 : 0.0;
+      double rev_cap = (rand() % 2) ? random_double() * 2 : 0.0;
+      flow->add_edge(i, j, cap, rev_cap);
+      cut->cap[i][j] += cap;
+      cut->cap[j][i] += rev_cap;
+    }
+  }
+
+  // The flow and the cut it returns should both match the best of all
+  // 2^n cuts.
+  void check_cut(const MaxFlow & flow, const Cut & cut, int n, double value) {
+    double best = 1e300;
+    vector <bool> in_sink(n);
+    for (int mask = 0; mask < (1 << n); mask++) {
+      for (int i = 0; i < n; i++) in_sink[i] = (mask >> i) & 1;
+      best = min(best, cut.cost(in_sink));
+    }
+    for (int i = 0; i < n; i++) in_sink[i] = flow.in_sink_set(i);
+    TEST_ASSERT_DELTA(value, best, 1e-6);
+    TEST_ASSERT_DELTA(cut.cost(in_sink), best, 1e-6);
+  }
+
+  void min_cut_test() {
+    srand(5);
+    for (int round = 0; round < 1000; round++) {
+      int n = 1 + rand() % 8;
+      MaxFlow flow;
+      Cut cut;
+      random_cut(n, &flow, &cut);
+      double value = flow.solve();
+      check_cut(flow, cut, n, value);
+    }
+  }
+
+  // One object solving many cuts, as MRFExpansionSolver uses it.
+  void reuse_test() {
+    srand(6);
+    MaxFlow flow;
+    for (int round = 0; round < 300; round++) {
+      int n = 1 + rand() % 8;
+      Cut cut;
+      random_cut(n, &flow, &cut);
+      double value = flow.solve();
+      check_cut(flow, cut, n, value);
+    }
+  }
+};
+
+
+int main(int argc, const char * argv[]) {
+  Test::TextOutput output(Test::TextOutput::Verbose);
+  MaxFlowTestSuite mts;
+  return mts.run(output) ? 0 : 1;
+}
@@ -21,6 +21,12 @@ class Cache {
     return has_value.size();
   }
 
+  // Empty the cache and make room for size keys, keeping the storage.
+  void reset(int size) {
+    store.resize(size);
+    has_value.assign(size, false);
+  }
+
   const V & get(const C & edge ) const { 
     int id = edge.id();
     assert (has_value[id]);
@@ -511,6 +511,66 @@ double best_path_helper(const Hypernode &node,
   return best_score;
 }
 
+// Soft-min of a and b at temperature t.
+static double soft_min(double a, double b, double t) {
+  double m = min(a, b);
+  return m - t * log(1.0 + exp(-fabs(a - b) / t));
+}
+
+double HypergraphAlgorithms::soft_marginals(const EdgeCache & edge_weights,
+                                            double temperature,
+                                            NodeCache & node_marginals,
+                                            EdgeCache & edge_marginals) const {
+  // Root first.
+  HNodes order = topological_sort();
+  NodeCache inside(_forest.num_nodes());
+  NodeCache outside(_forest.num_nodes());
+
+  for (int i = order.size() - 1; i >= 0; i--) {
+    HNode node = order[i];
+    if (node->num_edges() == 0) {
+      inside.set_value(*node, 0.0);
+      continue;
+    }
+    bool first = true;
+    double score = 0.0;
+    foreach (HEdge edge, node->edges()) {
+      double edge_value = edge_weights.get_value(*edge);
+      foreach (HNode tail_node, edge->tail_nodes()) {
+        edge_value += inside.get_value(*tail_node);
+      }
+      score = first ? edge_value : soft_min(score, edge_value, temperature);
+      first = false;
+    }
+    inside.set_value(*node, score);
+  }
+
+  double total = inside.get_value(_forest.root());
+  outside.set_value(_forest.root(), 0.0);
+  foreach (HNode node, order) {
+    double above = outside.get_value(*node);
+    node_marginals.set_value(*node,
+                             exp(-(inside.get_value(*node) + above - total) / temperature));
+    foreach (HEdge edge, node->edges()) {
+      double edge_value = edge_weights.get_value(*edge);
+      double tails = 0.0;
+      foreach (HNode tail_node, edge->tail_nodes()) {
+        tails += inside.get_value(*tail_node);
+      }
+      edge_marginals.set_value(*edge,
+                               exp(-(above + edge_value + tails - total) / temperature));
+      foreach (HNode tail_node, edge->tail_nodes()) {
+        double score = above + edge_value + tails - inside.get_value(*tail_node);
+        if (outside.has_key(*tail_node)) {
+          score = soft_min(outside.get_value(*tail_node), score, temperature);
+        }
+        outside.set_value(*tail_node, score);
+      }
+    }
+  }
+  return total;
+}
+
 void HypergraphAlgorithms::collect_marginals(const NodeCache & inside_memo_table,
                                              const NodeCache & outside_memo_table,
                                              NodeCache & marginals ) const {
@@ -100,6 +100,20 @@ HypergraphPrune pretty_good_pruning(const EdgeCache & edge_weights,
                         const NodeCache & outside_memo_table,
                         NodeCache & marginals) const;
 
+/** Smoothed version of best_path. Replaces min with the soft-min
+ *  -T log sum exp(-x/T) and computes posteriors of nodes and edges
+ *  under the distribution p(path) ~ exp(-weight(path)/T).
+ *  @param edge_weights The cached edge weights associated with the graph
+ *  @param temperature T > 0, as T goes to 0 this becomes best_path 
+ *  @param node_marginals Posterior of each reachable node
+ *  @param edge_marginals Posterior of each reachable edge
+ *  @return Soft-min weight (a lower bound on the best path weight)
+ */
+ double soft_marginals(const EdgeCache & edge_weights, 
+                       double temperature,
+                       NodeCache & node_marginals, 
+                       EdgeCache & edge_marginals) const;
+
  double filter_pruning_threshold(const EdgeCache & edge_weights,
                                  const NodeCache & score_memo_table, 
                                  const NodeCache & outside_memo_table,
@@ -0,0 +1,225 @@
+#include "ImplicitHypergraph.h"
+
+#include <algorithm>
+#include <assert.h>
+#include "../common.h"
+using namespace std;
+
+namespace Scarab {
+namespace HG {
+
+double log_sum(double a, double b);
+
+double ImplicitAlgorithms::best_path(const ImplicitWeights & weights,
+                                     vector <double> * score_memo_table,
+                                     vector <int> * back_memo_table) const {
+  score_memo_table->assign(_graph.num_nodes(), INF);
+  back_memo_table->assign(_graph.num_nodes(), -1);
+  vector <bool> done(_graph.num_nodes(), false);
+  return best_path_helper(_graph.root(), weights, done,
+                          *score_memo_table, *back_memo_table);
+}
+
+double ImplicitAlgorithms::best_path_helper(unsigned int node,
+                                            const ImplicitWeights & weights,
+                                            vector <bool> & done,
+                                            vector <double> & score_memo_table,
+                                            vector <int> & back_memo_table) const {
+  if (done[node]) {
+    return score_memo_table[node];
+  }
+
+  double best_score = INF;
+  int best_edge = -1;
+  unsigned int num_edges = _graph.num_edges(node);
+  if (num_edges == 0) {
+    best_score = 0.0;
+  } else {
+    vector <unsigned int> tails;
+    for (unsigned int i = 0; i < num_edges; i++) {
+      unsigned int edge = _graph.edge(node, i, &tails);
+      double edge_value = weights.weight(edge);
+      foreach (unsigned int tail, tails) {
+        edge_value += best_path_helper(tail, weights, done,
+                                       score_memo_table, back_memo_table);
+      }
+      if (edge_value < best_score) {
+        best_score = edge_value;
+        best_edge = i;
+      }
+    }
+  }
+
+  done[node] = true;
+  score_memo_table[node] = best_score;
+  back_memo_table[node] = best_edge;
+  return best_score;
+}
+
+vector <unsigned int> ImplicitAlgorithms::construct_best_edges(
+    const vector <int> & back_memo_table) const {
+  vector <unsigned int> edges;
+  construct_best_edges_helper(_graph.root(), back_memo_table, &edges);
+  return edges;
+}
+
+void ImplicitAlgorithms::construct_best_edges_helper(
+    unsigned int node,
+    const vector <int> & back_memo_table,
+    vector <unsigned int> * edges) const {
+  if (back_memo_table[node] == -1) return;
+  vector <unsigned int> tails;
+  edges->push_back(_graph.edge(node, back_memo_table[node], &tails));
+  foreach (unsigned int tail, tails) {
+    construct_best_edges_helper(tail, back_memo_table, edges);
+  }
+}
+
+double ImplicitAlgorithms::inside_scores(bool max,
+                                         const ImplicitWeights & weights,
+                                         vector <double> * inside_memo_table) const {
+  inside_memo_table->assign(_graph.num_nodes(), INF);
+  vector <bool> done(_graph.num_nodes(), false);
+  return inside_score_helper(max, _graph.root(), weights, done,
+                             *inside_memo_table);
+}
+
+double ImplicitAlgorithms::inside_score_helper(bool use_max, unsigned int node,
+                                               const ImplicitWeights & weights,
+                                               vector <bool> & done,
+                                               vector <double> & inside_memo_table) const {
+  if (done[node]) {
+    return inside_memo_table[node];
+  }
+
+  double inside_score;
+  unsigned int num_edges = _graph.num_edges(node);
+  if (num_edges == 0) {
+    inside_score = 0.0;
+  } else {
+    inside_score = INF;
+    vector <unsigned int> tails;
+    for (unsigned int i = 0; i < num_edges; i++) {
+      unsigned int edge = _graph.edge(node, i, &tails);
+      double edge_value = weights.weight(edge);
+      foreach (unsigned int tail, tails) {
+        edge_value += inside_score_helper(use_max, tail, weights, done,
+                                          inside_memo_table);
+      }
+      if (use_max) {
+        inside_score = min(inside_score, edge_value);
+      } else {
+        inside_score = log_sum(inside_score, edge_value);
+      }
+    }
+  }
+  done[node] = true;
+  inside_memo_table[node] = inside_score;
+  return inside_score;
+}
+
+LazyHypergraph::LazyHypergraph(const ImplicitHypergraph & implicit)
+    : _implicit(implicit),
+      _node_by_id(implicit.num_nodes(), (LazyHypernode *)NULL) {}
+
+LazyHypergraph::~LazyHypergraph() {
+  foreach (LazyHypernode * node, _node_by_id) {
+    delete node;
+  }
+  for (map <unsigned int, Hyperedge *>::iterator it = _edge_by_id.begin();
+       it != _edge_by_id.end(); it++) {
+    delete it->second;
+  }
+}
+
+LazyHypernode * LazyHypergraph::node(unsigned int id) const {
+  if (_node_by_id[id] == NULL) {
+    _node_by_id[id] = new LazyHypernode(*this, id);
+  }
+  return _node_by_id[id];
+}
+
+void LazyHypergraph::expand(LazyHypernode * head) const {
+  vector <unsigned int> tails;
+  unsigned int num_edges = _implicit.num_edges(head->id());
+  for (unsigned int i = 0; i < num_edges; i++) {
+    unsigned int id = _implicit.edge(head->id(), i, &tails);
+    vector <Hypernode *> tail_nodes;
+    foreach (unsigned int tail, tails) {
+      tail_nodes.push_back(node(tail));
+    }
+    Hyperedge * edge = new LazyHyperedge(id, head, tail_nodes);
+    bool added = _edge_by_id.insert(make_pair(id, edge)).second;
+    assert(added);
+    head->_edges.push_back(edge);
+  }
+  head->_expanded = true;
+}
+
+void LazyHypergraph::expand_all() const {
+  if (!_all_nodes.empty()) return;
+  for (unsigned int id = 0; id < _implicit.num_nodes(); id++) {
+    node(id)->edges();
+    _all_nodes.push_back(node(id));
+  }
+  for (map <unsigned int, Hyperedge *>::const_iterator it =
+           _edge_by_id.begin(); it != _edge_by_id.end(); it++) {
+    _all_edges.push_back(it->second);
+  }
+}
+
+void LazyHypergraph::expand_from_root() const {
+  vector <bool> seen(_implicit.num_nodes(), false);
+  vector <unsigned int> stack(1, _implicit.root());
+  seen[_implicit.root()] = true;
+  while (!stack.empty()) {
+    const LazyHypernode * head = node(stack.back());
+    stack.pop_back();
+    foreach (const Hyperedge * edge, head->edges()) {
+      foreach (const Hypernode * tail, edge->tail_nodes()) {
+        if (!seen[tail->id()]) {
+          seen[tail->id()] = true;
+          stack.push_back(tail->id());
+        }
+      }
+    }
+  }
+}
+
+const Hypernode & LazyHypergraph::root() const {
+  return *node(_implicit.root());
+}
+
+const Hypernode & LazyHypergraph::get_node(unsigned int i) const {
+  return *node(i);
+}
+
+const Hyperedge & LazyHypergraph::get_edge(unsigned int i) const {
+  map <unsigned int, Hyperedge *>::const_iterator it = _edge_by_id.find(i);
+  assert(it != _edge_by_id.end());
+  return *it->second;
+}
+
+const vector <Hypernode *> & LazyHypergraph::nodes() const {
+  expand_all();
+  return _all_nodes;
+}
+
+const vector <Hyperedge *> & LazyHypergraph::edges() const {
+  expand_all();
+  return _all_edges;
+}
+
+EdgeCache * LazyHypergraph::cache_edge_weights(
+    const ImplicitWeights & weights) const {
+  expand_from_root();
+  EdgeCache * cache = new EdgeCache(_implicit.num_edges());
+  for (map <unsigned int, Hyperedge *>::const_iterator it =
+           _edge_by_id.begin(); it != _edge_by_id.end(); it++) {
+    cache->set_value(*it->second, weights.weight(it->first));
+  }
+  return cache;
+}
+
+}
+}
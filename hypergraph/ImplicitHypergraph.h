@@ -0,0 +1,231 @@
+#ifndef IMPLICITHYPERGRAPH_H_
+#define IMPLICITHYPERGRAPH_H_
+
+#include <assert.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Hypergraph.h"
+#include "HypergraphAlgorithms.h"
+using namespace std;
+
+namespace Scarab {
+namespace HG {
+
+/**
+ * A hypergraph whose structure is computed rather than stored, for
+ * forests that are regular in a few integers (parse charts, tag
+ * lattices). Nodes are 0 .. num_nodes() - 1 and the edges into a node
+ * are generated when asked for. Edge ids must be unique and below
+ * num_edges(), but need not be dense.
+ */
+class ImplicitHypergraph {
+ public:
+  virtual ~ImplicitHypergraph() {}
+
+  virtual unsigned int num_nodes() const = 0;
+  virtual unsigned int num_edges() const = 0;
+  virtual unsigned int root() const = 0;
+
+  /**
+   * The number of edges with node as head, 0 for terminals.
+   */
+  virtual unsigned int num_edges(unsigned int node) const = 0;
+
+  /**
+   * Generate the i'th edge with node as head.
+   * @param tails Set to the edge's tail nodes
+   * @return The edge id
+   */
+  virtual unsigned int edge(unsigned int node, unsigned int i,
+                            vector <unsigned int> * tails) const = 0;
+
+  virtual string node_label(unsigned int node) const { return ""; }
+};
+
+/**
+ * Edge weights of an ImplicitHypergraph, by edge id. Should accept any
+ * id below num_edges(), used or not.
+ */
+class ImplicitWeights {
+ public:
+  virtual ~ImplicitWeights() {}
+  virtual double weight(unsigned int edge) const = 0;
+};
+
+/**
+ * best_path and inside_scores of HypergraphAlgorithms, run directly
+ * on an ImplicitHypergraph. Tables are plain vectors by node id and
+ * nothing per edge is allocated; back pointers are edge positions,
+ * from which construct_best_edges regenerates the edges.
+ */
+class ImplicitAlgorithms {
+ public:
+  ImplicitAlgorithms(const ImplicitHypergraph & graph) : _graph(graph) {}
+
+  /**
+   * Find the best path, lowest weight.
+   * @param score_memo_table Set to the best score of each node
+   * @param back_memo_table Set to the position of each node's best
+   *                        edge (-1 for terminals and unvisited nodes)
+   * @return Weight of shortest path
+   */
+  double best_path(const ImplicitWeights & weights,
+                   vector <double> * score_memo_table,
+                   vector <int> * back_memo_table) const;
+
+  /**
+   * The edge ids of the best path, in the order of
+   * HypergraphAlgorithms::construct_best_edges.
+   */
+  vector <unsigned int> construct_best_edges(
+      const vector <int> & back_memo_table) const;
+
+  /**
+   * @param max Use min instead of log sum (costs are negative log probs)
+   * @return The inside score of the root
+   */
+  double inside_scores(bool max, const ImplicitWeights & weights,
+                       vector <double> * inside_memo_table) const;
+
+ private:
+  const ImplicitHypergraph & _graph;
+
+  double best_path_helper(unsigned int node,
+                          const ImplicitWeights & weights,
+                          vector <bool> & done,
+                          vector <double> & score_memo_table,
+                          vector <int> & back_memo_table) const;
+
+  double inside_score_helper(bool use_max, unsigned int node,
+                             const ImplicitWeights & weights,
+                             vector <bool> & done,
+                             vector <double> & inside_memo_table) const;
+
+  void construct_best_edges_helper(unsigned int node,
+                                   const vector <int> & back_memo_table,
+                                   vector <unsigned int> * edges) const;
+};
+
+class LazyHypernode;
+class LazyHyperedge;
+
+/**
+ * An HGraph view of an ImplicitHypergraph, so code written against
+ * HGraph (HypergraphAlgorithms, CubePruning) runs on it unchanged. A
+ * node object is made when it is first reached, and its edges when they
+ * are first asked for, so only the part of the forest a search visits
+ * is ever built. nodes() and edges() expand everything. Edges have no
+ * features and no in-edges are kept; weights come from
+ * cache_edge_weights.
+ *
+ * Generated edges are kept in a map by id, since num_edges() can be far
+ * above the number of edges (4n^3 for EisnerForest).
+ */
+class LazyHypergraph : public HGraph {
+ public:
+  LazyHypergraph(const ImplicitHypergraph & implicit);
+  ~LazyHypergraph();
+
+  void print() const {}
+
+  const Hypernode & root() const;
+  unsigned int num_edges() const { return _implicit.num_edges(); }
+  unsigned int num_nodes() const { return _implicit.num_nodes(); }
+
+  const Hypernode & get_node(unsigned int i) const;
+
+  // Only edges that have already been generated.
+  const Hyperedge & get_edge(unsigned int i) const;
+
+  const vector <Hypernode *> & nodes() const;
+  const vector <Hyperedge *> & edges() const;
+
+  /**
+   * Weights by edge id, in the form HypergraphAlgorithms and
+   * CubePruning take them. Expands the nodes reachable from the root
+   * and only weighs their edges.
+   */
+  EdgeCache * cache_edge_weights(const ImplicitWeights & weights) const;
+
+ private:
+  friend class LazyHypernode;
+
+  LazyHypernode * node(unsigned int id) const;
+  void expand(LazyHypernode * node) const;
+  void expand_all() const;
+  void expand_from_root() const;
+
+  const ImplicitHypergraph & _implicit;
+  mutable vector <LazyHypernode *> _node_by_id;
+  mutable map <unsigned int, Hyperedge *> _edge_by_id;
+
+  // Filled by expand_all.
+  mutable vector <Hypernode *> _all_nodes;
+  mutable vector <Hyperedge *> _all_edges;
+};
+
+class LazyHyperedge : public Hyperedge {
+ public:
+  LazyHyperedge(unsigned int id, Hypernode * head,
+                const vector <Hypernode *> & tails)
+      : _id(id), _head(head), _tails(tails) {}
+
+  unsigned int id() const { return _id; }
+  string label() const { return ""; }
+  const Hypernode & tail_node(unsigned int i) const { return *_tails[i]; }
+  unsigned int num_nodes() const { return _tails.size(); }
+  const svector<int, double> & fvector() const { return _features; }
+  const Hypernode & head_node() const { return *_head; }
+  const vector <Hypernode *> & tail_nodes() const { return _tails; }
+
+ private:
+  unsigned int _id;
+  Hypernode * _head;
+  vector <Hypernode *> _tails;
+  svector<int, double> _features;
+};
+
+class LazyHypernode : public Hypernode {
+ public:
+  LazyHypernode(const LazyHypergraph & graph, unsigned int id)
+      : _graph(graph), _id(id), _expanded(false) {}
+
+  unsigned int id() const { return _id; }
+
+  unsigned int num_edges() const {
+    return _graph._implicit.num_edges(_id);
+  }
+
+  unsigned int num_in_edges() const { return 0; }
+
+  const Hyperedge & edge(unsigned int i) const { return *edges()[i]; }
+
+  const Hyperedge & in_edge(unsigned int i) const {
+    assert(false);
+    return *_in_edges[i];
+  }
+
+  bool is_terminal() const { return num_edges() == 0; }
+
+  const vector <Hyperedge *> & edges() const {
+    if (!_expanded) _graph.expand(const_cast<LazyHypernode *>(this));
+    return _edges;
+  }
+
+  const vector <Hyperedge *> & in_edges() const { return _in_edges; }
+
+  string label() const { return _graph._implicit.node_label(_id); }
+
+ private:
+  friend class LazyHypergraph;
+  const LazyHypergraph & _graph;
+  unsigned int _id;
+  bool _expanded;
+  vector <Hyperedge *> _edges;
+  vector <Hyperedge *> _in_edges;
+};
+
+}
+}
+#endif
@@ -119,9 +119,120 @@ public:
 };
 */
 
+#include <cpptest.h>
+#include <cpptest-suite.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "HypergraphAlgorithms.h"
+#include "ImplicitHypergraph.h"
+#include "Eisner.h"
+#include "../common.h"
+using namespace std;
+using namespace Scarab::HG;
+
+class ImplicitTestSuite : public Test::Suite
+{
+public:
+
+  ImplicitTestSuite() {
+    TEST_ADD(ImplicitTestSuite::eisner_forest_test);
+    TEST_ADD(ImplicitTestSuite::lazy_hypergraph_test);
+  }
+
+private:
+  static ArcScores random_scores(int length) {
+    ArcScores scores(length);
+    for (int head = 0; head < length; head++) {
+      for (int mod = 1; mod < length; mod++) {
+        if (head == mod) continue;
+        scores.set_score(head, mod, rand() / (double)RAND_MAX - 0.5);
+      }
+    }
+    return scores;
+  }
+
+  // ImplicitAlgorithms on EisnerForest finds EisnerParser's tree.
+  void eisner_forest_test() {
+    srand(0);
+    EisnerParser parser;
+    for (int length = 2; length <= 12; length++) {
+      for (int trial = 0; trial < 20; trial++) {
+        ArcScores scores = random_scores(length);
+        vector <Dependency> deps;
+        double best = parser.parse(scores, &deps);
+
+        EisnerForest forest(scores);
+        ImplicitAlgorithms algorithms(forest);
+        vector <double> score_memo;
+        vector <int> back_memo;
+        double implicit_best = algorithms.best_path(forest, &score_memo,
+                                                    &back_memo);
+        TEST_ASSERT_DELTA(implicit_best, best, 1e-9);
+
+        vector <Dependency> implicit_deps;
+        foreach (unsigned int edge, algorithms.construct_best_edges(back_memo)) {
+          Dependency dep;
+          if (forest.edge_dependency(edge, &dep)) {
+            implicit_deps.push_back(dep);
+          }
+        }
+        sort(implicit_deps.begin(), implicit_deps.end());
+        TEST_ASSERT(implicit_deps.size() == deps.size());
+        TEST_ASSERT((int)deps.size() == length - 1);
+        for (unsigned int i = 0; i < deps.size() && i < implicit_deps.size(); i++) {
+          TEST_ASSERT(implicit_deps[i].head == deps[i].head);
+          TEST_ASSERT(implicit_deps[i].mod == deps[i].mod);
+        }
+      }
+    }
+  }
+
+  // HypergraphAlgorithms on a LazyHypergraph of the same forest.
+  void lazy_hypergraph_test() {
+    srand(1);
+    EisnerParser parser;
+    for (int length = 2; length <= 12; length++) {
+      for (int trial = 0; trial < 5; trial++) {
+        ArcScores scores = random_scores(length);
+        vector <Dependency> deps;
+        double best = parser.parse(scores, &deps);
+
+        EisnerForest forest(scores);
+        LazyHypergraph lazy(forest);
+        EdgeCache * weights = lazy.cache_edge_weights(forest);
+        NodeCache score_memo(lazy.num_nodes());
+        NodeBackCache back_memo(lazy.num_nodes());
+        HypergraphAlgorithms algorithms(lazy);
+        double lazy_best = algorithms.best_path(*weights, score_memo,
+                                                back_memo);
+        TEST_ASSERT_DELTA(lazy_best, best, 1e-9);
+
+        vector <Dependency> lazy_deps;
+        foreach (const Hyperedge * edge,
+                 algorithms.construct_best_edges(back_memo)) {
+          Dependency dep;
+          if (forest.edge_dependency(edge->id(), &dep)) {
+            lazy_deps.push_back(dep);
+          }
+        }
+        sort(lazy_deps.begin(), lazy_deps.end());
+        TEST_ASSERT(lazy_deps.size() == deps.size());
+        for (unsigned int i = 0; i < deps.size() && i < lazy_deps.size(); i++) {
+          TEST_ASSERT(lazy_deps[i].head == deps[i].head);
+          TEST_ASSERT(lazy_deps[i].mod == deps[i].mod);
+        }
+        delete weights;
+      }
+    }
+  }
+};
+
 int main(int argc, const char * argv[]) {
   //Test::TextOutput output(Test::TextOutput::Verbose);
   //LocalTestSuite ets;
   //ets.load_test();
-   return 0;
+  Test::TextOutput output(Test::TextOutput::Verbose);
+  ImplicitTestSuite implicit;
+  return implicit.run(output) ? 0 : 1;
 }
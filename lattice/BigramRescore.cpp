@@ -3,46 +3,98 @@
 #include "../util.h"
 #include <time.h>
 #include <iostream>
+#include <queue>
+#include <functional>
+#include <algorithm>
 #include <assert.h>
-using namespace std;
 
 #define TIMING 0
-#define OPTIMIZE 1
+using namespace std;
 
+// Orders nodes by decreasing topological position.
+struct LaterFirst {
+  LaterFirst(const vector<int> & topo) : _topo(topo) {}
+  bool operator()(int a, int b) const { return _topo[a] > _topo[b]; }
+  const vector<int> & _topo;
+};
 
 BigramRescore::BigramRescore(const ForestLattice * graph_in, const GraphDecompose * gd_in):
   gd(gd_in), graph(graph_in)  {
   // huge hack
   int num_nodes = max((int)graph_in->get_graph().num_nodes(), graph_in->num_word_nodes);
-  current_weights.resize(num_nodes);
+  current_weights.resize(num_nodes, 0.0);
   update_position.resize(num_nodes);
-  update_filter.resize(num_nodes);
+  update_len = 0;
+  recomputed = 0;
+  score_changed = 0;
 
-  int num_actual_nodes = graph_in->get_graph().num_nodes();
+  setup_problems();
+}
 
-  forward_paths.resize(num_actual_nodes);
-  backward_paths.resize(num_actual_nodes);
-  need_to_recompute.resize(num_nodes);
+void BigramRescore::setup_problems() {
+  int num_nodes = graph->get_graph().num_nodes();
 
-  bigram_weights.resize(num_nodes);
+  _succ.resize(num_nodes);
+  _preds.resize(num_nodes);
+  foreach (Node n, graph->get_graph().nodes()) {
+    foreach (Edge e, n->edges()) {
+      _succ[n->id()].push_back(e->to_node()->id());
+      _preds[e->to_node()->id()].push_back(n->id());
+    }
+  }
 
-  best_split.resize(num_nodes);
-  bigram_path.resize(num_nodes);
+  // One shortest path problem per node that ends a bigram.
+  _target_index.resize(num_nodes, -1);
+  foreach (const WordBigram & b, gd->valid_bigrams()) {
+    int n2 = graph->lookup_word(b.w2)->id();
+    if (_target_index[n2] == -1) {
+      _target_index[n2] = _targets.size();
+      _targets.push_back(n2);
+    }
+  }
 
+  int num_targets = _targets.size();
+  _target_start.resize(num_targets + 1);
+  _target_start[0] = 0;
+  _node_slots.resize(num_nodes);
+  _dirty.resize(num_targets);
+
+  vector <bool> seen(num_nodes);
+  for (int t = 0; t < num_targets; t++) {
+    // Backwards from the target, only continuing through nodes a
+    // path may pass.
+    vector <int> nodes(1, _targets[t]);
+    fill(seen.begin(), seen.end(), false);
+    seen[_targets[t]] = true;
+    vector <int> stack(1, _targets[t]);
+    while (!stack.empty()) {
+      int n = stack.back();
+      stack.pop_back();
+      if (!passes(t, n)) continue;
+      foreach (int p, _preds[n]) {
+        if (seen[p]) continue;
+        seen[p] = true;
+        nodes.push_back(p);
+        stack.push_back(p);
+      }
+    }
+    sort(nodes.begin(), nodes.end(),
+         LaterFirst(gd->topological_position()));
 
-  for (int i=0; i < num_nodes; i++) {
-    current_weights[i] = 0.0;
-    need_to_recompute[i].resize(num_nodes);
-    best_split[i].resize(num_nodes);
-    bigram_path[i].resize(num_nodes);
-    bigram_weights[i].resize(num_nodes);
-    for (int j=0; j < num_nodes; j++) {
-      bigram_path[i][j] = NULL;
+    foreach (int n, nodes) {
+      _node_slots[n].push_back(pair<int, int>(t, _slot_node.size()));
+      _slot_node.push_back(n);
     }
-    bigram_weights[i][i] = 0.0;
+    _target_start[t + 1] = _slot_node.size();
   }
 
-  cache_forward();
+  int num_slots = _slot_node.size();
+  _dist.resize(num_slots, INF);
+  _best_next.resize(num_slots, -1);
+  _is_dirty.resize(num_slots, false);
+  for (int t = 0; t < num_targets; t++) {
+    _dist[slot(t, _targets[t])] = 0.0;
+  }
 }
 
 void BigramRescore::update_weights(vector<int> u_pos,
@@ -50,207 +102,101 @@ void BigramRescore::update_weights(vector<int> u_pos,
                                    int len) {
   clock_t begin=clock();
 
-
-  for (int i=0; i< graph->get_graph().num_nodes(); i++) {
-    update_filter[i] =  0;
-  }
-
   update_len = len;
   for (int i=0; i < len; i++) {
     int pos = u_pos[i];
-    //update_values[i] = u_values[i];
     update_position[i] = pos;
     current_weights[pos] += u_values[i];
-    update_filter[pos] = 1;
-    //update_filter[pos] = true;
   }
 
   recompute_bigram_weights(false);
+
   if (TIMING) {
     clock_t end=clock();
-    cout << "RECOMPUTE: " << double(Clock::diffclock(end,begin)) << " ms"<< endl;
+    cout << "RECOMPUTE: " << recomputed << " nodes " << score_changed
+         << " changed " << double(Clock::diffclock(end,begin)) << " ms" << endl;
   }
 }
 
-
-void BigramRescore::cache_forward() {
-
-  foreach (Node n1, graph->get_graph().nodes()) {
-    foreach (Node i, graph->get_graph().nodes()) {
-
-      if (!graph->is_phrase_node(*n1)) {
-        if (gd->path_exists(*n1, *i) || i->id() == n1->id()) {
-          forward_paths[n1->id()].push_back(i->id());
-        }
-      }
-      if (gd->path_exists(*i, *n1)) {
-        backward_paths[n1->id()].push_back(i->id());
-      }
-    }
-
-    if (graph->is_phrase_node(*n1)) {
-      forward_paths[n1->id()].push_back(n1->id());
+bool BigramRescore::relax(int t, int s) {
+  int n = _slot_node[s];
+  if (n == _targets[t]) return false;
+  recomputed++;
+  float best = INF;
+  int best_next = -1;
+  foreach (int to, _succ[n]) {
+    if (!passes(t, to)) continue;
+    int to_slot = slot(t, to);
+    if (to_slot == -1 || _dist[to_slot] == INF) continue;
+    float val = edge_weight(n, to) + _dist[to_slot];
+    if (val < best) {
+      best = val;
+      best_next = to;
     }
   }
-}
-
-void BigramRescore::reconstruct_path(int n1, int n2, const vector<vector <int> > & best_split, vector <int > & array ) {
-  if (n1 == n2) {
-    return;
-  }
-  // reconstruct edges
-  int k = best_split[n1][n2];
-  if (k != n2) {
-    reconstruct_path(n1, k, best_split, array);
-    reconstruct_path(k, n2, best_split, array);
-  } else {
-    int edge_label =graph->get_edge_label(n1, n2);
-    if (edge_label != -1) {
-      assert(!graph->is_word(edge_label));
-      array.push_back(edge_label);
-    }
-    //array.push_back(k);
+  if (best_next != _best_next[s]) {
+    score_changed++;
+    _best_next[s] = best_next;
   }
+  if (best == _dist[s]) return false;
+  _dist[s] = best;
+  return true;
 }
 
-void BigramRescore::find_shortest(const Graphnode & no1,
-                                  const Graphnode & no2) {
-  int n1 = no1.id();
-  int n2 = no2.id();
-
-  assert (need_to_recompute[n1][n2]);
-  recomputed++;
-
-  need_to_recompute[n1][n2] =0;
-
-  int old_split = best_split[n1][n2];
-
-  if (n1 != n2)
-    bigram_weights[n1][n2] = INF;
-
-  assert(gd->path_exists(no1, no2));
-
-  const vector <Node> * path = gd->get_path(no1,no2);
-  int s = path->size();
-  for (int split = 0; split < s; split++) {
-    Node k = (*path)[split];
-
-    if (k->id() == n2) {
-      //base case
-      int edge_id = graph->get_edge_label(no1, no2);
-
-      float val;
-      if (edge_id != -1)
-        val = current_weights[edge_id];
-      else
-        val = 0.0;
-      // should only get to base case on update
-      //cout << "Update" << k << endl;
-      //assert (update_filter[k]);
-      if (val < bigram_weights[n1][n2]) {
-        best_split[n1][n2] = k->id();
-        bigram_weights[n1][n2] = val;
-      }
-    } else {
-      float a, b;
-      if (need_to_recompute[n1][k->id()]) {
-        find_shortest(no1, *k);
-      }
-      a = bigram_weights[n1][k->id()];
-
-      if (need_to_recompute[k->id()][n2]) {
-        find_shortest(k->id(), no2);
-      }
-      b = bigram_weights[k->id()][n2];
-
-      if (a + b < bigram_weights[n1][n2]) {
-        best_split[n1][n2] = k->id();
-        bigram_weights[n1][n2] = a + b;
+void BigramRescore::propagate(int t) {
+  // Slots are laid out successors first, so taking the lowest dirty
+  // slot first recomputes each node at most once.
+  priority_queue <int, vector<int>, greater<int> > queue;
+  foreach (int s, _dirty[t]) {
+    queue.push(s);
+  }
+  _dirty[t].clear();
+
+  while (!queue.empty()) {
+    int s = queue.top();
+    queue.pop();
+    _is_dirty[s] = false;
+    int n = _slot_node[s];
+    if (!relax(t, s) || !passes(t, n)) continue;
+    foreach (int p, _preds[n]) {
+      int p_slot = slot(t, p);
+      if (!_is_dirty[p_slot]) {
+        _is_dirty[p_slot] = true;
+        queue.push(p_slot);
       }
     }
   }
-  if (old_split != best_split[n1][n2])
-    score_changed++;
 }
 
-
 void BigramRescore::recompute_bigram_weights(bool initialize) {
+  recomputed = 0;
+  score_changed = 0;
 
-  int count = 0;
-  recomputed =0;
-  score_changed =0;
-
-  clock_t begin=clock();
-
-  if (initialize || !OPTIMIZE) {
-    for (int i=0; i < graph->get_graph().num_nodes(); i++) {
-      update_filter[i] = 1;
-      for (int j=0;j < graph->get_graph().num_nodes(); j++) {
-        if (i != j) {
-          need_to_recompute[i][j] = 1;
-        }
+  if (initialize) {
+    for (unsigned int t = 0; t < _targets.size(); t++) {
+      for (int s = _target_start[t]; s < _target_start[t + 1]; s++) {
+        relax(t, s);
       }
     }
-  } else {
-    //assert (false);
-    // need to figure out edge conversion
-    for (int k=0; k < update_len; k++ ) {
-      int up_pos = update_position[k];
-      if (graph->is_word(up_pos)) continue;
-      //cout << "UPDATE " << up_pos << endl;
-      Bigram b = graph->get_nodes_by_labels(up_pos);
-      //if (graph->is_word(up_pos)) continue;
-      //int up_node = graph->orig_id_to_edge
-
-      //cout << up_node << endl;
-      //if (seen[up_node]) continue;
-      //cout << up_pos << " " << b.w1 << " " << b.w2 << endl;
-      //cout << forward_paths[b.w1].size() << endl;
-
-      for (uint i=0; i < forward_paths[b.w2].size(); i++) {
-        int rnode = forward_paths[b.w2][i];
-
-        for (uint j=0; j < backward_paths[b.w1].size(); j++) {
-
-          int lnode = backward_paths[b.w1][j];
-
-          //cout << lnode << " " << rnode << endl;
-          count ++;
-          //cout << b.w1 << " " << lnode << " " << rnode << endl;
-          need_to_recompute[lnode][rnode] = 1;
-        }
-      }
-    }
-  }
-  clock_t end;
-  if (TIMING) {
-    end=clock();
-    cout << "Dirty: " << double(Clock::diffclock(end,begin)) << " ms"<< endl;
-    begin = clock();
+    return;
   }
-  //for (unsigned int i=0; i< gd->valid_bigrams.size() ;i++) {
-  foreach (const WordBigram & b, gd->valid_bigrams()) {
-    int w1 = b.w1.id();
-    int w2 = b.w2.id();
-
-    Node n1 = graph->lookup_word(b.w1);
-    Node n2 = graph->lookup_word(b.w2);
 
-    // first do it with recursion
-    if (need_to_recompute[n1->id()][n2->id()] && gd->path_exists(*n1, *n2)) {
-      find_shortest(n1->id(), n2->id());
-      if (bigram_path[n1->id()][n2->id()] != NULL) {
-        bigram_path[n1->id()][n2->id()]->clear();
-      }
+  // Only the tail of each changed edge needs recomputing directly.
+  vector <int> dirty_targets;
+  for (int k=0; k < update_len; k++ ) {
+    int up_pos = update_position[k];
+    if (graph->is_word(up_pos)) continue;
+    Bigram b = graph->get_nodes_by_labels(up_pos);
+    for (unsigned int i = 0; i < _node_slots[b.w1].size(); i++) {
+      int t = _node_slots[b.w1][i].first;
+      int s = _node_slots[b.w1][i].second;
+      if (_is_dirty[s]) continue;
+      if (_dirty[t].empty()) dirty_targets.push_back(t);
+      _is_dirty[s] = true;
+      _dirty[t].push_back(s);
     }
   }
-  if (TIMING) {
-    cout << "COUNT " << count << " " <<
-        recomputed << " " << score_changed << endl;
-    end=clock();
-    cout << "FIND Shortest: " <<
-        double(Clock::diffclock(end,begin)) << " ms"<< endl;
+  foreach (int t, dirty_targets) {
+    propagate(t);
   }
 }
-
-
@@ -2,12 +2,28 @@
 #define BIGRAMRESCORE_H_
 
 #include <cmath>
+#include <algorithm>
 #include "ForestLattice.h"
 #include "GraphDecompose.h"
 #include <iostream>
 #include "../common.h"
 #include <vector>
 using namespace std;
+
+/**
+ * Best lattice path between the words of each valid bigram, under
+ * weights on the lattice edges that change every round.
+ *
+ * Paths may only pass through non-phrase nodes. For every node that
+ * ends a bigram (a target) we keep the shortest distance from each
+ * node that can reach it, so all bigrams into the same word share
+ * their suffix sub-paths. Only those (target, node) pairs are stored,
+ * so memory follows the lattice rather than nodes squared. When
+ * weights change only the nodes on the changed edges are dirtied.
+ * They are recomputed from their out-edges in reverse topological
+ * order, and a node whose distance moved (up or down) dirties its
+ * predecessors in turn.
+ */
 class BigramRescore {
 
  public:
@@ -23,88 +39,102 @@ class BigramRescore {
     assert(w1 >= 0);
     assert(w2 >= 0);
 
-    // for testing
-    //get_bigram_weight(w1, w2);
-
-    Node no1 = graph->lookup_word(w1);
-    Node no2 = graph->lookup_word(w2);
-
-    int n1 = no1->id();
-    int n2 = no2->id();
-
-    assert(gd->path_exists(n1, n2));
-    if (bigram_path[n1][n2] == NULL) {
-      bigram_path[n1][n2] = new vector<int>();
+    int n1 = graph->lookup_word(w1)->id();
+    int n2 = graph->lookup_word(w2)->id();
+    int t = _target_index[n2];
+    assert(t != -1);
+
+    // Edge labels along the path (not the words themselves).
+    vector <int> path;
+    for (int n = n1; n != n2; ) {
+      int s = slot(t, n);
+      assert(s != -1 && _dist[s] != INF);
+      int next = _best_next[s];
+      int edge_label = graph->get_edge_label(n, next);
+      if (edge_label != -1) {
+        assert(!graph->is_word(edge_label));
+        path.push_back(edge_label);
+      }
+      n = next;
     }
-
-    if (bigram_path[n1][n2]->empty()) {
-      reconstruct_path(n1, n2, best_split, *bigram_path[n1][n2]);
-
-      // We do NOT want this since many node-node paths
-      // bigram_path[n1][n2]->push_back(w2);
-     }
-
-    //cout << "PATH " << n1 << " " << n2 << endl;
-    // SANITY CHECK (remove!)
-
-    //double should_score = 0.0;
-    /* foreach (int id, (*bigram_path[n1][n2])) { */
-    /*   //cout << "\t on path" << (*bigram_path[n1][n2])[i]<< endl; */
-    /*   should_score += current_weights[id]; */
-    /*   cout << "BIGRAMPATH" << " " << id << " " << current_weights[id] << endl; */
-    /* } */
-    //cout << should_score << " " << bigram_weights[n1][n2] << " " << n1 << " " << n2 << endl;
-    //assert (fabs(should_score -bigram_weights[n1][n2]) < 1e-4);
-
-    assert (bigram_path[n1][n2] != NULL);
-    //cout << bigram_path[n1][n2]->size() << endl;
-    return (*bigram_path[n1][n2]);
+    return path;
   }
 
-  inline float get_bigram_weight(int w1, int w2) {
+  inline float get_bigram_weight(int w1, int w2) const {
     // w1 and w2 are word ids
-    Node n1 = graph->lookup_word(w1);
-    Node n2 = graph->lookup_word(w2);
-    //assert (gd->path_exists(n1, n2));
-    //assert(bigram_weights[n1][n2] != INF);
-    //cout << "Bigram weights "<<  bigram_weights[n1][n2] << " " <<  current_weights[w2] << endl;
-    return bigram_weights[n1->id()][n2->id()] + current_weights[w2];
+    int n1 = graph->lookup_word(w1)->id();
+    int n2 = graph->lookup_word(w2)->id();
+    return _dist[slot(_target_index[n2], n1)] + current_weights[w2];
   }
 
+  // Nodes recomputed, and how many of those changed, in the last
+  // call to recompute_bigram_weights.
+  int last_recomputed() const { return recomputed; }
+  int last_changed() const { return score_changed; }
 
  private:
-  void reconstruct_path(int n1, int n2, const vector <vector< int> > & best_split, vector <int > & array );
+  // Weight of the lattice edge n1 -> n2.
+  inline float edge_weight(int n1, int n2) const {
+    int edge_label = graph->get_edge_label(n1, n2);
+    return (edge_label == -1) ? 0.0 : current_weights[edge_label];
+  }
 
-  vector <float > current_weights;
-  vector <int > update_position;
-  //vector <bool > update_filter;
-  vector <bool > update_filter;
-  int update_len;
+  // Can a path to target t continue through node n.
+  inline bool passes(int t, int n) const {
+    return n == _targets[t] || !graph->is_phrase_node(n);
+  }
 
+  void setup_problems();
 
-  vector < vector < vector <int> *> > bigram_path;
+  // Recompute the distance of slot s of target t from the out-edges
+  // of its node. Returns true if it changed.
+  bool relax(int t, int s);
 
-  vector < vector < int > > best_split;
-  vector< vector<float> > bigram_weights;
+  // Recompute the dirty nodes of target t, successors first.
+  void propagate(int t);
 
+  vector <float > current_weights;
+  vector <int > update_position;
+  int update_len;
 
-  vector<vector <bool> > need_to_recompute;
-  //vector <Bigram> for_updates[NUMSTATES];
+  // Lattice adjacency by node id.
+  vector <vector <int> > _succ;
+  vector <vector <int> > _preds;
+
+  // Target nodes and the target index of each node (-1 if none).
+  vector <int> _targets;
+  vector <int> _target_index;
+
+  // Every (target, node) pair where the node can reach the target has
+  // a slot. Target t's slots are _target_start[t] .. _target_start[t + 1],
+  // with _slot_node giving their nodes, successors first.
+  vector <int> _target_start;
+  vector <int> _slot_node;
+
+  // Per node, (target, slot) of each target it can reach, by target.
+  vector <vector <pair <int, int> > > _node_slots;
+
+  // Slot of node n for target t, or -1.
+  inline int slot(int t, int n) const {
+    const vector <pair <int, int> > & slots = _node_slots[n];
+    vector <pair <int, int> >::const_iterator found =
+        lower_bound(slots.begin(), slots.end(), pair<int, int>(t, -1));
+    if (found == slots.end() || found->first != t) return -1;
+    return found->second;
+  }
 
+  // Per slot, the distance to the target and the next node on the
+  // best path.
+  vector <float> _dist;
+  vector <int> _best_next;
 
+  // Per target, a sparse set of dirty slots.
+  vector <vector <int> > _dirty;
+  vector <bool> _is_dirty;
 
   int recomputed, score_changed;
-  void cache_paths(int, int);
-  void cache_forward();
-  vector<vector<int> > forward_paths;
-  vector<vector<int> > backward_paths;
-
-  void setup_problems();
-  void find_shortest(const Graphnode & n1, const Graphnode & n2);
 
   const GraphDecompose * gd;
   const ForestLattice * graph;
-  //vector <vector <bitset <NUMSTATES> > > bigram_cache;
-
 };
 #endif
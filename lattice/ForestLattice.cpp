@@ -2,9 +2,14 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <algorithm>
 #include "../common.h"
 using namespace std;
 
+static bool by_to_node(const pair<int, int> & a, const pair<int, int> & b) {
+  return a.first < b.first;
+}
+
 ostream& operator<<(ostream& os, const Word& w){ 
    os << w.id() << endl;
   return os;
@@ -71,7 +76,8 @@ ForestLattice::ForestLattice(const Lattice & lat):
   final.resize(num_nodes);
   node_edges.resize(num_nodes);
   //graph.resize(num_nodes);
-  _edge_by_nodes.resize(num_nodes);
+  _edge_start.resize(num_nodes + 1);
+  _edge_start[0] = 0;
   _edge_label_by_nodes.resize(num_word_nodes);
   //_words_lookup.resize(lat.GetExtension(num_original_ids));
   
@@ -89,6 +95,9 @@ ForestLattice::ForestLattice(const Lattice & lat):
   }
  
  _original_id_to_edge.resize(num_word_nodes);
+ // (to node, label) of each out edge by node id, flattened into the
+ // CSR rows after the loop since nodes need not come in id order.
+ vector <vector <pair <int, int> > > out_edges_by_node(num_nodes);
  //int same =0;
   for (int i = 0; i < lat.node_size(); i++) {
     const Lattice_Node & node =  lat.node(i);
@@ -100,13 +109,9 @@ ForestLattice::ForestLattice(const Lattice & lat):
     
     node_edges[node.id()] = node.edge_size();
     //graph[node.id()].resize(node.edge_size());
-    _edge_by_nodes[node.id()].resize(num_nodes);
     //_edge_label_by_nodes[node.id()].resize(num_nodes);
 
-
-    for (int j =0; j < lat.node_size(); j++) {
-      _edge_by_nodes[node.id()][j] = -1;
-    }
+    vector <pair <int, int> > & out_edges = out_edges_by_node[node.id()];
 
     if (node.GetExtension(has_phrases)) {
       const Phraselets & plets  = node.GetExtension(phraselets);
@@ -195,17 +200,20 @@ ForestLattice::ForestLattice(const Lattice & lat):
          
         }
         //edges[]
-        _edge_by_nodes[node.id()][edge.to_id()] = original_id;
+        out_edges.push_back(pair<int, int>(edge.to_id(), original_id));
         _edge_label_by_nodes[original_id] = label;
         //cout << "EDGE " << original_id << " " << node.id() << " " << edge.to_id() << endl;
         _original_id_to_edge[original_id] = Bigram(node.id(), edge.to_id());
       } else {
         //cout << "NO EDGE " << node.id() << " " << edge.to_id() << " " << endl;
-        _edge_by_nodes[node.id()][edge.to_id()] = -1;
+        out_edges.push_back(pair<int, int>(edge.to_id(), -1));
       }
 
     }
 
+    // With parallel edges the last one's label is kept.
+    stable_sort(out_edges.begin(), out_edges.end(), by_to_node);
+
 
     if (node.GetExtension(has_phrases)) {
       word_node[node.id()] = 1; //node.getExtension(word);
@@ -220,6 +228,15 @@ ForestLattice::ForestLattice(const Lattice & lat):
     }
   }
 
+  for (int n = 0; n < num_nodes; n++) {
+    const vector <pair <int, int> > & out_edges = out_edges_by_node[n];
+    for (unsigned int j = 0; j < out_edges.size(); j++) {
+      _edge_to.push_back(out_edges[j].first);
+      _edge_label.push_back(out_edges[j].second);
+    }
+    _edge_start[n + 1] = _edge_to.size();
+  }
+
   start = lat.start();
   for (int i=0; i < lat.final_size(); i++) {
     final[lat.final(i)] = 1;
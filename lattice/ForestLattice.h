@@ -6,6 +6,7 @@
 #include "lattice.pb.h"
 
 #include <string>
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include "Graph.h"
@@ -114,13 +115,18 @@ class ForestLattice {
   }
 
   
+  // Label of the edge n1 -> n2, -1 if it has none or does not exist.
   inline int get_edge_label(int n1, int n2) const {
-    return _edge_by_nodes[n1][n2];
+    vector<int>::const_iterator begin = _edge_to.begin() + _edge_start[n1];
+    vector<int>::const_iterator end = _edge_to.begin() + _edge_start[n1 + 1];
+    vector<int>::const_iterator found = upper_bound(begin, end, n2);
+    if (found == begin || *(found - 1) != n2) return -1;
+    return _edge_label[found - 1 - _edge_to.begin()];
   }
 
   inline int get_edge_label(const Graphnode &n1, 
                             const Graphnode &n2) const {
-    return _edge_by_nodes[n1.id()][n2.id()];
+    return get_edge_label(n1.id(), n2.id());
   }
 
   inline Bigram get_nodes_by_labels(int orig_id) const {    
@@ -214,7 +220,11 @@ class ForestLattice {
 
   //vector <LatNode *> _nodes; 
   //vector<vector<int> > graph;
-  vector<vector<int> > _edge_by_nodes;
+  // Out edges of node n are _edge_start[n] .. _edge_start[n + 1],
+  // sorted by to node.
+  vector<int> _edge_start;
+  vector<int> _edge_to;
+  vector<int> _edge_label;
 
   Cache <Graphnode, vector<Word> > _first_words;
   Cache <Graphnode, vector<Word> > _last_words;
@@ -1,7 +1,6 @@
 #include "ForestLattice.h"
 
 #include <vector>
-#include <bitset>
 #include <iostream>
 #include <assert.h>
 #include "GraphDecompose.h"
@@ -23,23 +22,26 @@ void GraphDecompose::compute_bigrams() {
     }
   }
 
+  // Phrase nodes reachable from each phrase node, read off its row.
   foreach (Node n, _lat.phrase_nodes()) {
-    foreach (Node n2, _lat.phrase_nodes()) {
-      if (n->id() == n2->id()) continue;
-      if (!all_pairs_path_exist[n->id()][n2->id()]) continue; 
-      foreach (const Word & w1, _lat.last_words(*n)) {
-        foreach (const Word & w2, _lat.first_words(*n2)) {
-          _valid_bigrams.push_back(WordBigram(w1, w2));
-          forward_bigrams[w1.id()].push_back(w2.id());        
-          backward_bigrams[w2.id()].push_back(w1.id());        
+    const uint64_t * row = &_reach[n->id() * _row_words];
+    for (int w = 0; w < _row_words; w++) {
+      for (uint64_t bits = row[w] & ~_passes[w]; bits; bits &= bits - 1) {
+        const Graphnode & n2 = _lat.node((w << 6) + __builtin_ctzll(bits));
+        if (n->id() == n2.id()) continue;
+        foreach (const Word & w1, _lat.last_words(*n)) {
+          foreach (const Word & w2, _lat.first_words(n2)) {
+            _valid_bigrams.push_back(WordBigram(w1, w2));
+            forward_bigrams[w1.id()].push_back(w2.id());
+            backward_bigrams[w2.id()].push_back(w1.id());
+          }
         }
-      }   
+      }
     }
   }
 }
 
 void GraphDecompose::decompose() {
-  int num_nodes = _lat.get_graph().num_nodes();
   forward_bigrams.resize(_lat.num_word_nodes);
   backward_bigrams.resize(_lat.num_word_nodes);
   
@@ -48,72 +50,85 @@ void GraphDecompose::decompose() {
     forward_bigrams[w1].clear();
   }
 
-  all_pairs_path.resize(num_nodes);
-  all_pairs_path_exist.resize(num_nodes);
-
-  for (int i =0; i < num_nodes; i++ ) {
-    all_pairs_path_exist[i].resize(num_nodes);
-    all_pairs_path[i].resize(num_nodes);
-  }
-  //g = gr;
+  topological_sort();
   graph_to_all_pairs();
-  //all_pairs_to_bigram();
   compute_bigrams();
 }
 
-void GraphDecompose::graph_to_all_pairs() {
-
-  // INITIALIZE DP CHART
-  //for (int n=0;n < _lat.num_nodes;n++) {
+void GraphDecompose::topological_sort() {
+  int num_nodes = _lat.get_graph().num_nodes();
+  vector <int> in_degree(num_nodes, 0);
   foreach (Node n, _lat.get_graph().nodes()) {
+    foreach (Edge e, n->edges()) {
+      in_degree[e->to_node()->id()]++;
+    }
+  }
 
-    // Initialize all INF
-    foreach (Node n2, _lat.get_graph().nodes()) {
-      all_pairs_path_exist[n->id()][n2->id()] =0;
+  _topo_order.clear();
+  _topo_position.resize(num_nodes);
+  vector <int> ready;
+  for (int n = 0; n < num_nodes; n++) {
+    if (in_degree[n] == 0) ready.push_back(n);
+  }
+  while (!ready.empty()) {
+    int n = ready.back();
+    ready.pop_back();
+    _topo_position[n] = _topo_order.size();
+    _topo_order.push_back(n);
+    foreach (Edge e, _lat.node(n).edges()) {
+      int to = e->to_node()->id();
+      if (--in_degree[to] == 0) ready.push_back(to);
     }
-    
-    
-    // If path exists set it to 1
-    foreach (Edge e, n->edges()) {
-      Node n2 = e->to_node();
-      all_pairs_path_exist[n->id()][n2->id()] =1;
-      all_pairs_path[n->id()][n2->id()] = new vector <Node>();
-      all_pairs_path[n->id()][n2->id()]->push_back(n2);      
+  }
+  // The lattice must be acyclic.
+  assert((int)_topo_order.size() == num_nodes);
+}
+
+void GraphDecompose::graph_to_all_pairs() {
+  int num_nodes = _lat.get_graph().num_nodes();
+  _row_words = (num_nodes + 63) / 64;
+  _reach.assign(num_nodes * _row_words, 0);
+  _passes.assign(_row_words, 0);
+
+  for (int n = 0; n < num_nodes; n++) {
+    if (!_lat.is_phrase_node(n)) {
+      _passes[n >> 6] |= (uint64_t)1 << (n & 63);
     }
-    all_pairs_path_exist[n->id()][n->id()] =1;
-    all_pairs_path[n->id()][n->id()] = new vector<Node>();
   }
-  
-  
 
-  // RUN Modified FLOYD WARSHALL
-  //for (int k=0;k < _lat.get_graph().num_nodes(); k++) {
-  foreach (Node k, _lat.get_graph().nodes()) {
-    // lex nodes can't be in the middle of a path
-    if (_lat.is_phrase_node(*k)) continue;
-    
-    //for (int n=0; n < _lat.get_graph().num_nodes(); n++) {
-    foreach(Node n, _lat.get_graph().nodes()) {
-      if (!path_exists(*n,*k)) continue;
-      if (n->id() == k->id()) continue;
-      
-      foreach(Node n2, _lat.get_graph().nodes()) {
-        if (n2->id() == n->id()) continue;
-        if (k->id() == n2->id()) continue;
-        if (path_exists(*n, *k) &&  path_exists(*k, *n2) ) {
- 
-          if (!path_exists(*n, *n2)) {
-            all_pairs_path_exist[n->id()][n2->id()] =1;
-            all_pairs_path[n->id()][n2->id()] = new vector<Node>();
-          }
-          all_pairs_path[n->id()][n2->id()]->push_back(k);  
-        }
+  // Successors come later in topological order, so their rows are
+  // complete when we reach n. A successor that is a phrase node ends
+  // the path there.
+  for (int i = num_nodes - 1; i >= 0; i--) {
+    int n = _topo_order[i];
+    uint64_t * row = &_reach[n * _row_words];
+    row[n >> 6] |= (uint64_t)1 << (n & 63);
+    foreach (Edge e, _lat.node(n).edges()) {
+      int to = e->to_node()->id();
+      if (_lat.is_phrase_node(to)) {
+        row[to >> 6] |= (uint64_t)1 << (to & 63);
+        continue;
+      }
+      const uint64_t * to_row = &_reach[to * _row_words];
+      for (int w = 0; w < _row_words; w++) {
+        row[w] |= to_row[w];
       }
     }
   }
 }
-  
-  
+
+vector <Node> GraphDecompose::get_path(int w1, int w2) const {
+  vector <Node> path;
+  if (w1 == w2 || !path_exists(w1, w2)) return path;
+  foreach (Edge e, _lat.node(w1).edges()) {
+    int k = e->to_node()->id();
+    if (k == w2 || (!_lat.is_phrase_node(k) && path_exists(k, w2))) {
+      path.push_back(e->to_node());
+    }
+  }
+  return path;
+}
+
 // void GraphDecompose::reconstruct_path(const Graphnode & n, const Graphnode & n2, vector <vector <int> > & array) {
 //   // find the path between nodes n and n2, and fill in array
 //   foreach (Node k,  *(all_pairs_path[n][n2])) {    
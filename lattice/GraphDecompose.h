@@ -2,62 +2,81 @@
 #define GRAPHDECOMPOSE_H_
 
 
-#include <vector> 
-#include <bitset> 
+#include <stdint.h>
+#include <vector>
 #include "ForestLattice.h"
 
-using namespace std; 
+using namespace std;
 
+/**
+ * Reachability over the lattice, where a path may only pass through
+ * non-phrase nodes, and the bigrams it allows.
+ *
+ * The closure is kept as a bit matrix in 64 bit words, filled by
+ * OR-ing successor rows in reverse topological order. Paths are not
+ * stored; their next hops are read off the closure on demand.
+ */
 class GraphDecompose {
- public: 
+ public:
+
 
-  
   vector <vector <int> > forward_bigrams;
   vector <vector <int> > backward_bigrams;
-  
+
   GraphDecompose( const ForestLattice & lattice): _lat(lattice){}
   void decompose();
 
-  
+
   bool path_exists(const Graphnode & n1, const Graphnode & n2) const {
-    //assert (w1 < _lat.num_nodes && w2 < _lat.num_nodes);
-    return all_pairs_path_exist[n1.id()][n2.id()];
+    return path_exists((int)n1.id(), (int)n2.id());
   }
 
-  /* bool path_exists(int w1, int w2) const { */
-  /*   //assert (w1 < _lat.num_nodes && w2 < _lat.num_nodes); */
-  /*   return all_pairs_path_exist[w1][w2]; */
-  /* } */
-
-
-  const vector <Node> * get_path(const Graphnode & n1, const Graphnode & n2) const {
-    return all_pairs_path[n1.id()][n2.id()];
+  bool path_exists(int w1, int w2) const {
+    return (_reach[w1 * _row_words + (w2 >> 6)] >> (w2 & 63)) & 1;
   }
 
-
-  // Do Not use
-  vector <Node> * get_path(int w1, int w2) const {
-    return all_pairs_path[w1][w2];
+  /**
+   * The next hops k of the paths from n1 to n2: successors of n1 that
+   * are n2 itself or an allowed intermediate with a path to n2. Every
+   * path splits uniquely into the edge (n1, k) and a path from k.
+   */
+  vector <Node> get_path(const Graphnode & n1, const Graphnode & n2) const {
+    return get_path((int)n1.id(), (int)n2.id());
   }
 
+  vector <Node> get_path(int w1, int w2) const;
+
   const vector <WordBigram> & valid_bigrams() const {
     return _valid_bigrams;
   }
 
+  // Lattice nodes in topological order, and the position of each.
+  const vector <int> & topological_order() const {
+    return _topo_order;
+  }
+
+  const vector <int> & topological_position() const {
+    return _topo_position;
+  }
+
  private:
-    // DP chart - points to the next node on the path
-  
-  vector< vector<vector<Node> * > > all_pairs_path;
-  vector< vector<bool> > all_pairs_path_exist;
+  // Row n has bit m set if m is reachable from n.
+  vector <uint64_t> _reach;
+
+  // Non-phrase nodes, the allowed intermediates.
+  vector <uint64_t> _passes;
+  int _row_words;
+
+  vector <int> _topo_order;
+  vector <int> _topo_position;
 
-  vector <vector <vector <vector <int> > > >  bigram_paths;
   const ForestLattice &_lat;
 
   vector <WordBigram> _valid_bigrams;
 
   void compute_bigrams();
+  void topological_sort();
   void graph_to_all_pairs();
-  //  void reconstruct_path(const Graphnode &  n, const Graphnode & n2, vector <vector <int> > & array);
 };
 
 #endif
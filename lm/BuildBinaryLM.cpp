@@ -0,0 +1,37 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "CompactLM.h"
+using namespace std;
+
+// Convert an ARPA language model to the binary format read by
+// CompactLM.
+//
+// usage: build_binary_lm model.arpa model.bin [quantize]
+int main(int argc, char ** argv) {
+  if (argc < 3) {
+    cerr << "usage: " << argv[0] << " model.arpa model.bin [quantize]" << endl;
+    return 1;
+  }
+  bool quantize = (argc > 3 && string(argv[3]) == "quantize");
+  ifstream arpa(argv[1]);
+  if (!arpa) {
+    cerr << "Could not open " << argv[1] << endl;
+    return 1;
+  }
+  if (!CompactLM::build_from_arpa(arpa, argv[2], quantize)) {
+    cerr << "Conversion failed" << endl;
+    return 1;
+  }
+
+  // Check the result maps back.
+  CompactLM * lm = CompactLM::from_file(argv[2]);
+  if (lm == NULL) {
+    cerr << "Could not load " << argv[2] << endl;
+    return 1;
+  }
+  cerr << "Wrote order " << lm->order() << " model with "
+       << lm->vocab_size() << " words" << endl;
+  delete lm;
+  return 0;
+}
@@ -0,0 +1,524 @@
+#include "CompactLM.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+static const char kMagic[8] = {'D', 'D', 'L', 'M', 'B', 'I', 'N', '\0'};
+static const uint32_t kVersion = 1;
+
+// Sections start on 8 byte boundaries.
+static size_t align(size_t offset) {
+  return (offset + 7) & ~((size_t)7);
+}
+
+LanguageModel * load_binary_lm(const char * file_name) {
+  return CompactLM::from_file(file_name);
+}
+
+CompactLM::~CompactLM() {
+  if (_data != NULL) {
+    munmap(_data, _size);
+  }
+}
+
+CompactLM * CompactLM::from_file(const char * file_name) {
+  int fd = open(file_name, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CompactLMHeader)) {
+    close(fd);
+    return NULL;
+  }
+  void * data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+
+  const CompactLMHeader * header = (const CompactLMHeader *)data;
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion ||
+      header->order < 1 || header->order > LM_MAX_ORDER) {
+    munmap(data, st.st_size);
+    return NULL;
+  }
+
+  CompactLM * lm = new CompactLM();
+  lm->_data = data;
+  lm->_size = st.st_size;
+  lm->_header = header;
+
+  const char * base = (const char *)data;
+  size_t offset = align(sizeof(CompactLMHeader));
+  lm->_vocab_strings = base + offset;
+  offset = align(offset + header->vocab_bytes);
+  lm->_vocab_offsets = (const uint32_t *)(base + offset);
+  offset = align(offset + header->vocab_size * sizeof(uint32_t));
+  lm->_vocab_sorted = (const uint32_t *)(base + offset);
+  offset = align(offset + header->vocab_size * sizeof(uint32_t));
+
+  size_t value_size = header->quantized ? sizeof(uint16_t) : sizeof(float);
+  for (unsigned int d = 0; d < header->order; d++) {
+    Level & level = lm->_levels[d];
+    uint32_t nodes = header->num_nodes[d];
+    uint32_t probs = header->num_probs[d];
+    level.node_word = (const uint32_t *)(base + offset);
+    offset = align(offset + (nodes + 1) * sizeof(uint32_t));
+    level.child_begin = (const uint32_t *)(base + offset);
+    offset = align(offset + (nodes + 1) * sizeof(uint32_t));
+    level.prob_begin = (const uint32_t *)(base + offset);
+    offset = align(offset + (nodes + 1) * sizeof(uint32_t));
+    level.bow = header->quantized ? NULL : (const float *)(base + offset);
+    level.bow_code = header->quantized ? (const uint16_t *)(base + offset) : NULL;
+    offset = align(offset + nodes * value_size);
+    level.prob_word = (const uint32_t *)(base + offset);
+    offset = align(offset + probs * sizeof(uint32_t));
+    level.prob = header->quantized ? NULL : (const float *)(base + offset);
+    level.prob_code = header->quantized ? (const uint16_t *)(base + offset) : NULL;
+    offset = align(offset + probs * value_size);
+  }
+  if (offset > lm->_size) {
+    cerr << "Truncated language model " << file_name << endl;
+    delete lm;
+    return NULL;
+  }
+  return lm;
+}
+
+LMWord CompactLM::index(const string & word) const {
+  const char * target = word.c_str();
+  int low = 0, high = _header->vocab_size;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    uint32_t id = _vocab_sorted[mid];
+    int cmp = strcmp(_vocab_strings + _vocab_offsets[id], target);
+    if (cmp == 0) return id;
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return unknown();
+}
+
+const char * CompactLM::word(LMWord index) const {
+  if (index >= _header->vocab_size) return "";
+  return _vocab_strings + _vocab_offsets[index];
+}
+
+// Binary search for word in sorted[begin, end).
+static int find_sorted(const uint32_t * sorted, uint32_t begin,
+                       uint32_t end, LMWord word) {
+  const uint32_t * found = lower_bound(sorted + begin, sorted + end, word);
+  if (found == sorted + end || *found != word) return -1;
+  return found - sorted;
+}
+
+int CompactLM::find_child(int depth, int node, LMWord word) const {
+  if (depth + 1 >= (int)_header->order) return -1;
+  const Level & level = _levels[depth];
+  return find_sorted(_levels[depth + 1].node_word,
+                     level.child_begin[node], level.child_begin[node + 1],
+                     word);
+}
+
+int CompactLM::find_prob(int depth, int node, LMWord word) const {
+  const Level & level = _levels[depth];
+  return find_sorted(level.prob_word,
+                     level.prob_begin[node], level.prob_begin[node + 1],
+                     word);
+}
+
+// Same search as SRILM's Ngram::wordProbBO.
+float CompactLM::word_prob(LMWord word, const LMWord * context) const {
+  LMState state;
+  return word_prob_prime(word, context, state);
+}
+
+float CompactLM::word_prob_prime(LMWord word, const LMWord * context,
+                                 LMState & state) const {
+  state = LMState();
+  int node = 0;
+  int depth = 0;
+  while (true) {
+    int entry = find_prob(depth, node, word);
+    if (entry != -1) {
+      state.logp = prob_value(depth, entry);
+      state.bow = 0.0;
+    }
+    if (depth + 1 >= (int)_header->order || context[depth] == kLMNone) break;
+    int next = find_child(depth, node, context[depth]);
+    if (next == -1) break;
+    state.bow += bow_value(depth + 1, next);
+    node = next;
+    depth++;
+  }
+  state.node = node;
+  state.length = depth;
+  return state.logp + state.bow;
+}
+
+bool CompactLM::has_next(const LMState & state, LMWord next) const {
+  return find_child(state.length, state.node, next) != -1;
+}
+
+float CompactLM::word_prob_from_state(LMWord word, const LMWord * context,
+                                      const LMState & state) const {
+  float logp = state.logp;
+  float bow = state.bow;
+  int depth = state.length;
+  int next = find_child(depth, state.node, context[depth]);
+  if (next != -1) {
+    bow += bow_value(depth + 1, next);
+    int entry = find_prob(depth + 1, next, word);
+    if (entry != -1) {
+      logp = prob_value(depth + 1, entry);
+      bow = 0.0;
+    }
+  }
+  return logp + bow;
+}
+
+float CompactLM::context_bow(const LMWord * context, unsigned length) const {
+  float bow = 0.0;
+  int node = 0;
+  unsigned int depth = 0;
+  while (depth + 1 < _header->order && context[depth] != kLMNone) {
+    int next = find_child(depth, node, context[depth]);
+    if (next == -1) break;
+    node = next;
+    depth++;
+    if (depth > length) {
+      bow += bow_value(depth, node);
+    }
+  }
+  return bow;
+}
+
+unsigned CompactLM::context_length(LMWord word, const LMWord * context) const {
+  int node = 0;
+  unsigned int depth = 0;
+  while (depth + 1 < _header->order && context[depth] != kLMNone) {
+    int next = find_child(depth, node, context[depth]);
+    if (next != -1 &&
+        (word == kLMNone || find_prob(depth + 1, next, word) != -1)) {
+      node = next;
+      depth++;
+    } else {
+      break;
+    }
+  }
+  return depth;
+}
+
+/*
+ * ARPA conversion. The trie is built with maps in memory, then
+ * written out level by level.
+ */
+
+namespace {
+
+struct BuildNode {
+  BuildNode(): bow(0.0) {}
+  map <LMWord, int> children;
+  map <LMWord, float> probs;
+  float bow;
+};
+
+class Builder {
+ public:
+  Builder(int order): _order(order), _nodes(1) {}
+
+  LMWord add_word(const string & word) {
+    map <string, LMWord>::const_iterator found = _vocab.find(word);
+    if (found != _vocab.end()) return found->second;
+    LMWord id = _words.size();
+    _vocab[word] = id;
+    _words.push_back(word);
+    return id;
+  }
+
+
+  // Node for the context words[0 ... length) (most recent first).
+  int context_node(const vector <LMWord> & words, int length) {
+    int node = 0;
+    for (int i = 0; i < length; i++) {
+      map <LMWord, int>::const_iterator found = _nodes[node].children.find(words[i]);
+      if (found != _nodes[node].children.end()) {
+        node = found->second;
+      } else {
+        int child = _nodes.size();
+        _nodes.push_back(BuildNode());
+        _nodes[node].children[words[i]] = child;
+        node = child;
+      }
+    }
+    return node;
+  }
+
+  // ngram is in text order w1 ... wn.
+  void add_ngram(const vector <LMWord> & ngram, float prob,
+                 bool has_bow, float bow) {
+    int n = ngram.size();
+    vector <LMWord> reversed(ngram.rbegin(), ngram.rend());
+    // The context of wn is w(n-1) ... w1.
+    vector <LMWord> context(reversed.begin() + 1, reversed.end());
+    _nodes[context_node(context, n - 1)].probs[ngram[n - 1]] = prob;
+    // The highest order has no contexts to back off from.
+    if (has_bow && n < _order) {
+      _nodes[context_node(reversed, n)].bow = bow;
+    }
+  }
+
+  bool write(const char * out_file, bool quantize);
+
+ private:
+  int _order;
+  map <string, LMWord> _vocab;
+  vector <string> _words;
+  vector <BuildNode> _nodes;
+};
+
+struct Quantizer {
+  Quantizer(const vector <float> & values): base(0.0), step(1.0) {
+    if (values.empty()) return;
+    float low = *min_element(values.begin(), values.end());
+    float high = *max_element(values.begin(), values.end());
+    base = low;
+    step = (high > low) ? (high - low) / 65535.0 : 1.0;
+  }
+
+  uint16_t code(float value) const {
+    double c = (value - base) / step + 0.5;
+    if (c < 0.0) return 0;
+    if (c > 65535.0) return 65535;
+    return (uint16_t)c;
+  }
+
+  float base;
+  float step;
+};
+
+class SectionWriter {
+ public:
+  SectionWriter(FILE * out): _out(out), _offset(0), _ok(true) {}
+
+  void write(const void * data, size_t bytes) {
+    if (bytes != 0 && fwrite(data, 1, bytes, _out) != bytes) {
+      _ok = false;
+    }
+    _offset += bytes;
+  }
+
+  void pad() {
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    write(zeros, align(_offset) - _offset);
+  }
+
+  template <class T>
+  void section(const vector <T> & values) {
+    if (!values.empty()) write(&values[0], values.size() * sizeof(T));
+    pad();
+  }
+
+  void values(const vector <float> & values, bool quantize,
+              float & base, float & step) {
+    if (!quantize) {
+      section(values);
+      base = 0.0;
+      step = 1.0;
+      return;
+    }
+    Quantizer q(values);
+    vector <uint16_t> codes(values.size());
+    for (unsigned int i = 0; i < values.size(); i++) {
+      codes[i] = q.code(values[i]);
+    }
+    section(codes);
+    base = q.base;
+    step = q.step;
+  }
+
+  bool ok() const { return _ok; }
+
+ private:
+  FILE * _out;
+  size_t _offset;
+  bool _ok;
+};
+
+bool Builder::write(const char * out_file, bool quantize) {
+  int order = _order;
+  CompactLMHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.order = order;
+  header.quantized = quantize;
+  header.vocab_size = _words.size();
+  header.unknown = add_word("<unk>");
+  header.vocab_size = _words.size();
+
+  // Vocabulary.
+  vector <char> strings;
+  vector <uint32_t> offsets;
+  for (unsigned int i = 0; i < _words.size(); i++) {
+    offsets.push_back(strings.size());
+    strings.insert(strings.end(), _words[i].begin(), _words[i].end());
+    strings.push_back('\0');
+  }
+  vector <uint32_t> sorted;
+  for (map <string, LMWord>::const_iterator it = _vocab.begin();
+       it != _vocab.end(); it++) {
+    sorted.push_back(it->second);
+  }
+  header.vocab_bytes = strings.size();
+
+  // Lay out the levels. Nodes at each depth are ordered by parent,
+  // then by word, so each node's children are a sorted range.
+  vector <vector <int> > levels(order);
+  levels[0].push_back(0);
+  for (int d = 0; d + 1 < order; d++) {
+    for (unsigned int i = 0; i < levels[d].size(); i++) {
+      const BuildNode & node = _nodes[levels[d][i]];
+      for (map <LMWord, int>::const_iterator it = node.children.begin();
+           it != node.children.end(); it++) {
+        levels[d + 1].push_back(it->second);
+      }
+    }
+  }
+
+  FILE * out = fopen(out_file, "wb");
+  if (out == NULL) return false;
+  SectionWriter writer(out);
+  for (int d = 0; d < order; d++) {
+    header.num_nodes[d] = levels[d].size();
+  }
+  // Header is rewritten at the end once the quantizers are known.
+  writer.write(&header, sizeof(header));
+  writer.pad();
+  writer.section(strings);
+  writer.section(offsets);
+  writer.section(sorted);
+
+  uint32_t next_child = 0;
+  for (int d = 0; d < order; d++) {
+    vector <uint32_t> node_word, child_begin, prob_begin, prob_word;
+    vector <float> bows, probs;
+    for (unsigned int i = 0; i < levels[d].size(); i++) {
+      const BuildNode & node = _nodes[levels[d][i]];
+      child_begin.push_back(next_child);
+      if (d + 1 < order) next_child += node.children.size();
+      prob_begin.push_back(prob_word.size());
+      bows.push_back(node.bow);
+      for (map <LMWord, float>::const_iterator it = node.probs.begin();
+           it != node.probs.end(); it++) {
+        prob_word.push_back(it->first);
+        probs.push_back(it->second);
+      }
+    }
+    // Words of the nodes at this depth, in layout order.
+    if (d == 0) {
+      node_word.push_back(kLMNone);
+    } else {
+      for (unsigned int i = 0; i < levels[d - 1].size(); i++) {
+        const BuildNode & parent = _nodes[levels[d - 1][i]];
+        for (map <LMWord, int>::const_iterator it = parent.children.begin();
+             it != parent.children.end(); it++) {
+          node_word.push_back(it->first);
+        }
+      }
+    }
+    // Sentinels close the last node's ranges.
+    node_word.push_back(kLMNone);
+    child_begin.push_back(next_child);
+    prob_begin.push_back(prob_word.size());
+    next_child = 0;
+    header.num_probs[d] = prob_word.size();
+
+    writer.section(node_word);
+    writer.section(child_begin);
+    writer.section(prob_begin);
+    writer.values(bows, quantize, header.bow_base[d], header.bow_step[d]);
+    writer.section(prob_word);
+    writer.values(probs, quantize, header.prob_base[d], header.prob_step[d]);
+  }
+
+  bool ok = writer.ok();
+  ok = ok && fseek(out, 0, SEEK_SET) == 0;
+  ok = ok && fwrite(&header, sizeof(header), 1, out) == 1;
+  ok = (fclose(out) == 0) && ok;
+  return ok;
+}
+
+// ARPA uses -inf for impossible events, clamp to kLMLogZero.
+float parse_score(const string & token) {
+  if (token == "-inf" || token == "-Infinity") return kLMLogZero;
+  return max((float)atof(token.c_str()), kLMLogZero);
+}
+
+}  // namespace
+
+bool CompactLM::build_from_arpa(istream & arpa, const char * out_file,
+                                bool quantize) {
+  string line;
+  int order = 0;
+  while (getline(arpa, line)) {
+    if (line == "\\data\\") break;
+  }
+  while (getline(arpa, line)) {
+    if (line.compare(0, 6, "ngram ") == 0) {
+      order = max(order, atoi(line.c_str() + 6));
+    } else if (!line.empty()) {
+      break;
+    }
+  }
+  if (order < 1 || order > LM_MAX_ORDER) {
+    cerr << "Bad ARPA order " << order << endl;
+    return false;
+  }
+
+  Builder builder(order);
+  int n = 0;
+  long count = 0;
+  do {
+    if (line.empty()) continue;
+    if (line[0] == '\\') {
+      if (line == "\\end\\") break;
+      n = atoi(line.c_str() + 1);
+      if (n < 1 || n > order) {
+        cerr << "Bad ARPA section " << line << endl;
+        return false;
+      }
+      continue;
+    }
+    istringstream tokens(line);
+    string token;
+    tokens >> token;
+    float prob = parse_score(token);
+    vector <LMWord> ngram(n);
+    for (int i = 0; i < n; i++) {
+      if (!(tokens >> token)) {
+        cerr << "Bad ARPA line " << line << endl;
+        return false;
+      }
+      ngram[i] = builder.add_word(token);
+    }
+    bool has_bow = static_cast<bool>(tokens >> token);
+    builder.add_ngram(ngram, prob, has_bow, has_bow ? parse_score(token) : 0.0);
+    count++;
+  } while (getline(arpa, line));
+
+  cerr << "Read " << count << " ngrams of order " << order << endl;
+  return builder.write(out_file, quantize);
+}
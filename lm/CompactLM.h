@@ -0,0 +1,135 @@
+#ifndef COMPACTLM_H_
+#define COMPACTLM_H_
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include "LanguageModel.h"
+using namespace std;
+
+#define LM_MAX_ORDER 8
+
+/**
+ * Fixed size header at the start of a binary model file.
+ */
+struct CompactLMHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t order;
+  uint32_t quantized;
+  uint32_t vocab_size;
+  uint32_t unknown;
+  uint32_t vocab_bytes;
+  // Per depth (context length), not counting the sentinel node.
+  uint32_t num_nodes[LM_MAX_ORDER];
+  uint32_t num_probs[LM_MAX_ORDER];
+  // Quantized value is base + code * step.
+  float prob_base[LM_MAX_ORDER];
+  float prob_step[LM_MAX_ORDER];
+  float bow_base[LM_MAX_ORDER];
+  float bow_step[LM_MAX_ORDER];
+};
+
+/**
+ * In-tree backoff language model over a memory mapped binary file.
+ *
+ * The layout is SRILM's context trie flattened into sorted arrays.
+ * A node at depth d is a context of d words (most recent first).
+ * Its children at depth d + 1 and its word probabilities are
+ * contiguous ranges sorted by word, found by binary search, and the
+ * range ends at the start of the next node's range. Probabilities
+ * and backoffs are floats or, for quantized models, 16 bit codes.
+ *
+ * The file is mapped read only and shared, so several decoders
+ * using the same model share its pages and start without parsing.
+ */
+class CompactLM : public LanguageModel {
+ public:
+  ~CompactLM();
+
+  /**
+   * Map a binary model. Returns NULL if the file is not one.
+   */
+  static CompactLM * from_file(const char * file_name);
+
+  /**
+   * Convert an ARPA model to the binary format.
+   *
+   * @param arpa The ARPA text
+   * @param out_file Where to write the binary model
+   * @param quantize Store 16 bit codes instead of floats
+   * @return false if the ARPA file could not be parsed or written
+   */
+  static bool build_from_arpa(istream & arpa,
+                              const char * out_file,
+                              bool quantize);
+
+  int order() const { return _header->order; }
+
+  int vocab_size() const { return _header->vocab_size; }
+
+  LMWord index(const string & word) const;
+
+  LMWord unknown() const { return _header->unknown; }
+
+  // The string for index (for debugging).
+  const char * word(LMWord index) const;
+
+  float word_prob(LMWord word, const LMWord * context) const;
+
+  float context_bow(const LMWord * context, unsigned length) const;
+
+  unsigned context_length(LMWord word, const LMWord * context) const;
+
+  float word_prob_prime(LMWord word, const LMWord * context,
+                        LMState & state) const;
+
+  bool has_next(const LMState & state, LMWord next) const;
+
+  float word_prob_from_state(LMWord word, const LMWord * context,
+                             const LMState & state) const;
+
+ private:
+  CompactLM(): _data(NULL), _size(0) {}
+
+  struct Level {
+    const uint32_t * node_word;
+    const uint32_t * child_begin;
+    const uint32_t * prob_begin;
+    const float * bow;
+    const uint16_t * bow_code;
+    const uint32_t * prob_word;
+    const float * prob;
+    const uint16_t * prob_code;
+  };
+
+  // Index of the child of node (at depth) for word, -1 if none.
+  int find_child(int depth, int node, LMWord word) const;
+
+  // Index of the probability entry of node (at depth) for word.
+  int find_prob(int depth, int node, LMWord word) const;
+
+  inline float prob_value(int depth, int entry) const {
+    const Level & level = _levels[depth];
+    if (level.prob != NULL) return level.prob[entry];
+    return _header->prob_base[depth] +
+        level.prob_code[entry] * _header->prob_step[depth];
+  }
+
+  inline float bow_value(int depth, int node) const {
+    const Level & level = _levels[depth];
+    if (level.bow != NULL) return level.bow[node];
+    return _header->bow_base[depth] +
+        level.bow_code[node] * _header->bow_step[depth];
+  }
+
+  void * _data;
+  size_t _size;
+  const CompactLMHeader * _header;
+  const char * _vocab_strings;
+  const uint32_t * _vocab_offsets;
+  const uint32_t * _vocab_sorted;
+  Level _levels[LM_MAX_ORDER];
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef LANGUAGEMODEL_H_
+#define LANGUAGEMODEL_H_
+
+#include <stdint.h>
+#include <string>
+using namespace std;
+
+// Index of a word in the language model vocabulary.
+typedef unsigned int LMWord;
+
+// Terminates context arrays (same role as SRILM's Vocab_None).
+const LMWord kLMNone = (LMWord)-1;
+
+// Log10 probability of an unseen event.
+const float kLMLogZero = -99.0;
+
+/**
+ * Cursor into a model's context trie, left by word_prob_prime and
+ * read by has_next and word_prob_from_state. Callers own their
+ * states, so one model can be scored from several threads.
+ */
+struct LMState {
+  LMState(): node(0), length(0), logp(kLMLogZero), bow(0.0) {}
+
+  // Deepest context node matched (trie pointer or node index,
+  // depending on the model).
+  intptr_t node;
+
+  // Number of context words matched.
+  unsigned length;
+
+  // Most specific probability found so far, and the backoff weight
+  // accumulated since.
+  float logp;
+  float bow;
+};
+
+/**
+ * Backoff n-gram language model. Scores are log10 and contexts are
+ * given most recent word first, terminated by kLMNone, as in SRILM.
+ * Implementations must be safe to query from several threads.
+ */
+class LanguageModel {
+ public:
+  virtual ~LanguageModel() {}
+
+  // The n in n-gram.
+  virtual int order() const = 0;
+
+  virtual int vocab_size() const = 0;
+
+  // The index of word, or unknown() if it is not in the vocabulary.
+  virtual LMWord index(const string & word) const = 0;
+
+  virtual LMWord unknown() const = 0;
+
+  /**
+   * Backed off log10 P(word | context).
+   */
+  virtual float word_prob(LMWord word, const LMWord * context) const = 0;
+
+  /**
+   * Sum of the backoff weights of the contexts longer than length,
+   * the cost of dropping context words past length.
+   */
+  virtual float context_bow(const LMWord * context,
+                            unsigned length) const = 0;
+
+  /**
+   * Length of the longest context that has an explicit probability
+   * for word (the context length word_prob actually uses).
+   */
+  virtual unsigned context_length(LMWord word,
+                                  const LMWord * context) const = 0;
+
+  /**
+   * Score word against context like word_prob, leaving state at the
+   * deepest context node matched.
+   */
+  virtual float word_prob_prime(LMWord word, const LMWord * context,
+                                LMState & state) const = 0;
+
+  /**
+   * Does the node in state have a child context for next.
+   */
+  virtual bool has_next(const LMState & state, LMWord next) const = 0;
+
+  /**
+   * Score word with one more context word than state matched,
+   * context[state.length]. Used to score many longer contexts after
+   * a single word_prob_prime.
+   */
+  virtual float word_prob_from_state(LMWord word, const LMWord * context,
+                                     const LMState & state) const = 0;
+};
+
+/**
+ * Load a binary model written by build_binary_lm.
+ * Returns NULL if the file is not a binary model.
+ */
+LanguageModel * load_binary_lm(const char * file_name);
+
+#endif
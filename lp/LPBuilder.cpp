@@ -58,12 +58,12 @@ void  LatticeVars::initialize_all_pairs(const GraphDecompose & gd,
         all_pairs_vars[i][j].resize(num_nodes);
 
 
-        const vector <Node> * path = gd.get_path(i, j);
+        const vector <Node> path = gd.get_path(i, j);
         
-        assert (path->size() != 0 || i == j);
+        assert (path.size() != 0 || i == j);
 
         //for (int k = 0; k < path->size(); k++) {
-        foreach (Node k , *path) {
+        foreach (Node k , path) {
           int kid = k->id();
           stringstream buf;
           buf << name <<" SHORTEST " << i << " " << j << " " << kid;
@@ -92,9 +92,9 @@ void LatticeVars::add_all_pairs_constraints(const GraphDecompose & gd,
       if (i == j) continue; 
       {
         GRBLinExpr sum;
-        const vector <Node> * path = gd.get_path(i, j);
+        const vector <Node> path = gd.get_path(i, j);
         bool has = false;
-        foreach (Node k, *path) {
+        foreach (Node k, path) {
           int last = k->id();
           
           assert(has_all_pairs_var[i][j][last]);
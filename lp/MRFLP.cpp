@@ -10,10 +10,12 @@ void MRFLP::add_node_vars() {
     int node_id = node->id();
     Cache <State, GRBVar> * node_state_vars = new Cache<State, GRBVar>(n_states);
     node_vars.set_value(*node, node_state_vars);
-    foreach (const State & state, mrf.states(*node)) {
+    const vector <State> & states = mrf.states(*node);
+    for (int i = 0; i < states.size(); i++) {
+      const State & state = states[i];
       stringstream buf;
       buf <<  "mrf_node_" << node->id() << "_" << state.id() ;
-      double pot = mrf.node_pot(*node, state);
+      double pot = mrf.node_pot(node_id, i);
       node_state_vars->set_value(state, lp_conf->addSimpleVar(pot, buf));
     }
   }
@@ -25,19 +27,22 @@ void MRFLP::add_edge_vars() {
     Cache <State, Cache< State, GRBVar > * > * edge_state_vars = new Cache <State, Cache< State, GRBVar > * > (mrf.state_max(*edge->from_node()));
     edge_vars.set_value(*edge, edge_state_vars);
 
-    foreach (const State & state1, mrf.states(*edge->from_node())) {
+    const vector <State> & from_states = mrf.states(*edge->from_node());
+    const vector <State> & to_states = mrf.states(*edge->to_node());
+    for (int i = 0; i < from_states.size(); i++) {
+      const State & state1 = from_states[i];
       Cache <State, GRBVar> * inner_edge_state_vars = 
         new Cache<State, GRBVar>(mrf.state_max(*edge->to_node()));
       edge_state_vars->set_value(state1, inner_edge_state_vars);
-      foreach (const State & state2, mrf.states(*edge->to_node())) {
-        if (BLANK) {
-          bool has_pot = mrf.has_edge_pot(*edge, state1, state2);
-          if (!has_pot) continue;
-        }
+
+      // Only pairs with a potential get a var (the rest are blank).
+      for (int entry = mrf.edge_begin(edge->id(), i); 
+           entry < mrf.edge_end(edge->id(), i); entry++) {
+        const State & state2 = to_states[mrf.edge_to(entry)];
         stringstream buf;
         int n1 = edge->from_node()->id();
         int n2 = edge->to_node()->id();
-        double pot = mrf.edge_pot(*edge, state1, state2);
+        double pot = mrf.edge_value(entry);
         buf << "mrf_edge_" << n1 << "_" << state1.id() << "_" << n2 << "_" << state2.id() ;
         inner_edge_state_vars->set_value(state2, lp_conf->addSimpleVar(pot, buf));
       }
@@ -79,16 +84,18 @@ void MRFLP::add_edge_vars() {
 void MRFLP::show() const {
   cout << mrf.label() <<endl;
   foreach (Node node, mrf.graph().nodes()) {
-    foreach (const State & state, mrf.states(*node)) {
+    const vector <State> & states = mrf.states(*node);
+    for (int i = 0; i < states.size(); i++) {
+      const State & state = states[i];
       GRBVar var = node_vars.get(*node)->get(state);
       if (var.get(GRB_DoubleAttr_X)) {
         cout << (GRBLinExpr)var<< " "<< node->id() << " " << node->label() << " " << state.id() << " " << state.label() << " " << var.get(GRB_DoubleAttr_X) << " "<< endl;
       }
 
       foreach (Edge edge, node->edges()) {
-        foreach (const State & other_state, mrf.states(*edge->to_node())) {
-          bool has_pot = mrf.has_edge_pot(*edge, state, other_state);
-          if (!has_pot) continue;
+        for (int entry = mrf.edge_begin(edge->id(), i); 
+             entry < mrf.edge_end(edge->id(), i); entry++) {
+          const State & other_state = mrf.states(*edge->to_node())[mrf.edge_to(entry)];
           GRBVar var = edge_vars.get(*edge)->get(state)->get(other_state);
           if (var.get(GRB_DoubleAttr_X)) {
             cout << (GRBLinExpr)var<< " "<< edge->to_node()->id() << " " << state.id() << " " << other_state.id() << " " << var.get(GRB_DoubleAttr_X) << " "<< var.get(GRB_DoubleAttr_Obj) <<  endl;
@@ -118,15 +125,15 @@ void MRFLP::add_edge_constraints() {
   clock_t s=clock();      
   foreach (Node node, mrf.graph().nodes()) {
     GRBLinExpr sum;
-    foreach (const State & my_state, mrf.states(*node)) {
+    const vector <State> & my_states = mrf.states(*node);
+    for (int my_i = 0; my_i < my_states.size(); my_i++) {
+      const State & my_state = my_states[my_i];
       
       foreach (Edge edge, node->edges()) {
         GRBLinExpr sum;
-        foreach (const State & other_state, mrf.states(*edge->to_node())) {
-          if (BLANK) {
-            bool has_pot = mrf.has_edge_pot(*edge, my_state, other_state);
-            if (!has_pot) continue;
-          }
+        for (int entry = mrf.edge_begin(edge->id(), my_i); 
+             entry < mrf.edge_end(edge->id(), my_i); entry++) {
+          const State & other_state = mrf.states(*edge->to_node())[mrf.edge_to(entry)];
           sum += edge_vars.get(*edge)->get(my_state)->get(other_state);
         }
         // or it could be blank
@@ -142,12 +149,10 @@ void MRFLP::add_edge_constraints() {
 
       foreach (Edge edge, node->in_edges()) {
         GRBLinExpr sum;
-        foreach (const State & other_state, mrf.states(*edge->from_node())) {
-          if (BLANK) {
-            bool has_pot = mrf.has_edge_pot(*edge, other_state, my_state);
-            
-            if (!has_pot)continue;
-          }
+        const vector <State> & other_states = mrf.states(*edge->from_node());
+        for (int other_i = 0; other_i < other_states.size(); other_i++) {
+          const State & other_state = other_states[other_i];
+          if (mrf.edge_entry(edge->id(), other_i, my_i) == -1) continue;
           sum += edge_vars.get(*edge)->get(other_state)->get(my_state);
         }
         // or it could be blank
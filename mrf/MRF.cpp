@@ -4,6 +4,10 @@
 
 void MRF::process_node(graph::Graph_Node proto_node, Graphnode * internal_node) {
   const graph::MRFNode & mrfnode = proto_node.GetExtension(graph::mrf_node); 
+  int id = internal_node->id();
+
+  // Nodes come in id order, so each block goes on the end.
+  assert(_node_start.size() == id + 1);
   int max_state = 0;
   for (int i =0; i < mrfnode.node_potentials_size(); i++ ) {
     const graph::NodeStatePotential & node_poten = mrfnode.node_potentials(i);
@@ -11,46 +15,93 @@ void MRF::process_node(graph::Graph_Node proto_node, Graphnode * internal_node)
     max_state = max(state.id(), max_state);
   }
       
-  Cache <State, double> * node_potentials = new Cache <State, double> (max_state+1);
-  _max_node->set_value(*internal_node, max_state+1);
-  _node_potentials->set_value(*internal_node, node_potentials);
+  _max_node[id] = max_state + 1;
+  _state_start.push_back(_state_index.size());
+  _state_index.resize(_state_index.size() + max_state + 1, -1);
   
+  vector <State> & states = _node_states->get_no_check(*internal_node);
   for (int i =0; i < mrfnode.node_potentials_size(); i++ ) {
     const graph::NodeStatePotential & node_poten = mrfnode.node_potentials(i);
     const graph::State & state = node_poten.state();
     float weight = node_poten.node_potential();
     State s(state.id(), state.label());
-    _node_states->get_no_check(*internal_node).push_back(s);
+    _state_index[_state_start[id] + s.id()] = states.size();
+    states.push_back(s);
     _num_assignments = max(_num_assignments, make_assignment(*internal_node, s).id());
-    node_potentials->set_value(s, weight);
+    _node_pot.push_back(weight);
   }
-  
+  _node_start.push_back(_node_pot.size());
 }
 
+struct EdgeEntry {
+  int from, to;
+  double value;
+
+  bool operator<(const EdgeEntry & other) const {
+    if (from != other.from) {
+      return from < other.from;
+    }
+    return to < other.to;
+  }
+};
+
 void MRF::process_edge(graph::Graph_Edge proto_edge, Graphedge * internal_edge) {
   const graph::MRFEdge & mrf_edge = proto_edge.GetExtension(graph::mrf_edge);
-  map <int, map <int,  double > > & edge_weights = _edge_potentials->get_no_check(*internal_edge);
-
-  int n_from_states = states(*internal_edge->from_node()).size();
-  int n_to_states = states(*internal_edge->to_node()).size();
-  
+  int edge = internal_edge->id();
+  int from_node = internal_edge->from_node()->id();
+  int to_node = internal_edge->to_node()->id();
+  int n_from_states = num_states(from_node);
+  int n_to_states = num_states(to_node);
 
+  // Edges come in id order too.
+  assert(_edge_start.size() == edge);
+  vector <EdgeEntry> entries;
+  entries.reserve(mrf_edge.edge_potentials_size());
   for (int i =0; i < mrf_edge.edge_potentials_size(); i++ ) {
     const graph::EdgeStatePotential & edge_poten = mrf_edge.edge_potentials(i);
-    int from = edge_poten.from_state_id();
-    int to = edge_poten.to_state_id();
-    
-    edge_weights[from][to] = edge_poten.edge_potential();
+    EdgeEntry entry;
+    entry.from = state_index(from_node, edge_poten.from_state_id());
+    entry.to = state_index(to_node, edge_poten.to_state_id());
+    entry.value = edge_poten.edge_potential();
+    // A potential on a state its node doesn't have can never be looked
+    // up (the map ignored it too), and would break the rows below.
+    if (entry.from == -1 || entry.to == -1) {
+      continue;
+    }
+    entries.push_back(entry);
+  }
+
+  // Later potentials for the same pair win, as they did in the map.
+  stable_sort(entries.begin(), entries.end());
+  _edge_start.push_back(_edge_row.size());
+  int row = 0;
+  for (int i = 0; i < entries.size(); i++) {
+    if (i + 1 < entries.size() && 
+        !(entries[i] < entries[i + 1])) {
+      continue;
+    }
+    while (row <= entries[i].from) {
+      _edge_row.push_back(_edge_to.size());
+      row++;
+    }
+    _edge_to.push_back(entries[i].to);
+    _edge_val.push_back(entries[i].value);
+  }
+  while (row <= n_from_states) {
+    _edge_row.push_back(_edge_to.size());
+    row++;
   }
+  int stored = _edge_to.size() - _edge_row[_edge_start[edge]];
+  _edge_dense.push_back(stored == n_from_states * n_to_states);
 }
 
 
 void MRF::set_up(graph::Graph graph, int nodes , int edges) {
   _num_nodes = nodes;
   _node_states = new Cache <Graphnode, vector <State> >(nodes);
-  _max_node = new Cache <Graphnode, int >(nodes);
-  _node_potentials = new Cache <Graphnode, Cache <State, double> * >(nodes);
-  _edge_potentials = new Cache <Graphedge, map<int, map<int, double> > >(edges);
+  _max_node.resize(nodes, 0);
+  _node_start.push_back(0);
+  _edge_start.reserve(edges);
   _label = graph.label();
 }
 
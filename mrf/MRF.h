@@ -1,6 +1,7 @@
 #ifndef MRF_H
 #define MRF_H
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <Graph.h>
@@ -82,26 +83,111 @@ class MRF : public GraphProtoInterface {
   //void solve(vector <double> extra_node_potentials) const;
 
   void set_up(graph::Graph graph, int nodes , int edges);
+
+  // Potentials are stored by local state index, the position of the
+  // state in states(node), rather than by state id.
+
+  /** 
+   * The local index of a state id at a node
+   * 
+   * @return The index, or -1 if the node has no such state
+   */
+  int state_index(int node, int state_id) const {
+    if (state_id < 0 || state_id >= _max_node[node]) return -1;
+    return _state_index[_state_start[node] + state_id];
+  }
+
+  int num_states(int node) const {
+    return _node_start[node + 1] - _node_start[node];
+  }
+
+  // Flat id of a node's first state, counting the states of all nodes
+  // in order (the layout of the node potentials).
+  int state_offset(int node) const {
+    return _node_start[node];
+  }
+
+  int total_states() const {
+    return _node_start.back();
+  }
+
+  /** 
+   * Node potentials of all states of a node, by local index.
+   */
+  const double * node_pots(int node) const {
+    return &_node_pot[_node_start[node]];
+  }
+
+  double node_pot(int node, int s) const {
+    return _node_pot[_node_start[node] + s];
+  }
+
   const double node_pot(const Graphnode & node, const State & s1) const {
-    return _node_potentials->get(node)->get(s1);
+    return node_pot(node.id(), state_index(node.id(), s1.id()));
   }
 
-  const bool has_edge_pot(const Graphedge & edge, const State & s1, const State & s2) const {
-    return _edge_potentials->get(edge)[s1.id()].find(s2.id()) 
-      != _edge_potentials->get(edge)[s1.id()].end();
+  // Edge potentials are CSR, one row per from state with the to states
+  // that have a potential in order. Pairs with no potential are not
+  // stored. An edge with every pair is dense: row s starts at
+  // edge_begin(edge, 0) + s * num_states(to), and its columns are
+  // 0 .. num_states(to) - 1.
+
+  /** 
+   * Entries of the row of from state s (local index) are
+   * edge_begin(edge, s) ... edge_end(edge, s) - 1.
+   */
+  int edge_begin(int edge, int s) const {
+    return _edge_row[_edge_start[edge] + s];
   }
 
-  const double edge_pot(const Graphedge & edge, const State & s1, const State & s2) const {
-    if (has_edge_pot(edge, s1, s2)) {
-      return  _edge_potentials->get(edge)[s1.id()][s2.id()];
+  int edge_end(int edge, int s) const {
+    return _edge_row[_edge_start[edge] + s + 1];
+  }
+
+  // The to state (local index) of an entry.
+  int edge_to(int entry) const {
+    return _edge_to[entry];
+  }
+
+  double edge_value(int entry) const {
+    return _edge_val[entry];
+  }
+
+  bool edge_dense(int edge) const {
+    return _edge_dense[edge];
+  }
+
+  /** 
+   * The entry for a pair of local states.
+   * 
+   * @return The entry, or -1 if the pair has no potential
+   */
+  int edge_entry(int edge, int s1, int s2) const {
+    int begin = edge_begin(edge, s1);
+    if (_edge_dense[edge]) {
+      return begin + s2;
     }
-    return 0.0;
+    const int * first = &_edge_to[0] + begin;
+    const int * last = &_edge_to[0] + edge_end(edge, s1);
+    const int * it = lower_bound(first, last, s2);
+    if (it == last || *it != s2) return -1;
+    return begin + (it - first);
   }
-  
-  const map<int, double> &states_with_potential(const Graphedge & edge, const State & s1) const {
-    return _edge_potentials->get(edge)[s1.id()];
+
+  const bool has_edge_pot(const Graphedge & edge, const State & s1, const State & s2) const {
+    return edge_entry(edge.id(), 
+                      state_index(edge.from_node()->id(), s1.id()),
+                      state_index(edge.to_node()->id(), s2.id())) != -1;
   }
 
+  const double edge_pot(const Graphedge & edge, const State & s1, const State & s2) const {
+    int entry = edge_entry(edge.id(), 
+                           state_index(edge.from_node()->id(), s1.id()),
+                           state_index(edge.to_node()->id(), s2.id()));
+    if (entry == -1) return 0.0;
+    return _edge_val[entry];
+  }
+  
   /* const vector<State>  & states() const { */
   /*   return _states; */
   /* } */
@@ -121,7 +207,7 @@ class MRF : public GraphProtoInterface {
   } 
 
   int state_max(const Graphnode & node) const {
-    return _max_node->get(node);
+    return _max_node[node.id()];
   } 
 
   const int assignments() const{
@@ -150,12 +236,26 @@ class MRF : public GraphProtoInterface {
  private:
   int _num_nodes;
   Cache <Graphnode, vector <State> > * _node_states; 
-  Cache <Graphnode, int > * _max_node; 
-
-  Cache <Graphnode, Cache <State, double> * > * _node_potentials; 
 
-  // This will be zero on any edge with no potential (makes things way faster)
-  Cache <Graphedge, map <int, map<int, double> > > * _edge_potentials; 
+  // One past the largest state id, by node.
+  vector <int> _max_node; 
+
+  // Local index by state id, node's block starts at _state_start.
+  vector <int> _state_start;
+  vector <int> _state_index;
+
+  // Node potentials, node's block starts at _node_start (which has an
+  // extra entry at the end).
+  vector <int> _node_start;
+  vector <double> _node_pot;
+
+  // CSR edge potentials. Edge's row offsets start at _edge_start, and
+  // index into _edge_to and _edge_val.
+  vector <int> _edge_start;
+  vector <int> _edge_row;
+  vector <int> _edge_to;
+  vector <double> _edge_val;
+  vector <bool> _edge_dense;
 
   int _num_assignments;
 
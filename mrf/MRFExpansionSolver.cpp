@@ -0,0 +1,285 @@
+#include "MRFExpansionSolver.h"
+
+#include <cmath>
+#include "../common.h"
+
+MRFExpansionSolver::MRFExpansionSolver(const MRF & mrf)
+    : _mrf(mrf), _max_cycles(20), _cycles(0), _moves(0),
+      _bound(0.0), _energy(0.0), _local_minimum(false) {
+  const Graph & graph = mrf.graph();
+  _node_start.push_back(0);
+  foreach (Node node, graph.nodes()) {
+    const vector <State> & states = mrf.states(*node);
+    for (int s = 0; s < mrf.num_states(node->id()); s++) {
+      _state_id.push_back(states[s].id());
+      _labels.push_back(states[s].id());
+    }
+    _node_start.push_back(_state_id.size());
+  }
+  sort(_labels.begin(), _labels.end());
+  _labels.erase(unique(_labels.begin(), _labels.end()), _labels.end());
+  _label_nodes.resize(_labels.size());
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    for (int state = _node_start[node]; state < _node_start[node + 1];
+         state++) {
+      int label = lower_bound(_labels.begin(), _labels.end(),
+                              _state_id[state]) - _labels.begin();
+      _label_nodes[label].push_back(node);
+    }
+  }
+
+  int num_edges = graph.num_edges();
+  _same_pot.resize(num_edges);
+  _diff_pot.resize(num_edges);
+  _hard.resize(num_edges);
+  for (int edge = 0; edge < num_edges; edge++) {
+    double same_pot, diff_pot;
+    bool hard;
+    bool potts = read_edge(mrf, edge, &same_pot, &diff_pot, &hard);
+    assert(potts);
+    _same_pot[edge] = same_pot;
+    _diff_pot[edge] = diff_pot;
+    _hard[edge] = hard;
+  }
+  _unary.resize(num_states());
+  _same_cost.resize(num_edges);
+  _diff_cost.resize(num_edges);
+  _var.assign(graph.num_nodes(), -1);
+}
+
+bool MRFExpansionSolver::read_edge(const MRF & mrf, int edge,
+                                   double * same_pot, double * diff_pot,
+                                   bool * hard) {
+  const Graphedge & e = *mrf.graph().edges()[edge];
+  const vector <State> & from_states = mrf.states(*e.from_node());
+  const vector <State> & to_states = mrf.states(*e.to_node());
+  int from = e.from_node()->id();
+  int to = e.to_node()->id();
+  bool has_same = false, has_diff = false, missing = false;
+  for (int s = 0; s < mrf.num_states(from); s++) {
+    for (int t = 0; t < mrf.num_states(to); t++) {
+      int entry = mrf.edge_entry(edge, s, t);
+      if (from_states[s].id() == to_states[t].id()) {
+        if (entry == -1) return false;
+        double value = mrf.edge_value(entry);
+        if (has_same && fabs(value - *same_pot) > 1e-9) return false;
+        *same_pot = value;
+        has_same = true;
+      } else if (entry == -1) {
+        missing = true;
+      } else {
+        double value = mrf.edge_value(entry);
+        if (has_diff && fabs(value - *diff_pot) > 1e-9) return false;
+        *diff_pot = value;
+        has_diff = true;
+      }
+    }
+  }
+  if (missing && has_diff) return false;
+  *hard = missing;
+  if (!has_same) *same_pot = has_diff ? *diff_pot : 0.0;
+  if (!has_diff) *diff_pot = *same_pot;
+  return true;
+}
+
+bool MRFExpansionSolver::is_potts(const MRF & mrf, double scale) {
+  for (int edge = 0; edge < mrf.graph().num_edges(); edge++) {
+    double same_pot, diff_pot;
+    bool hard;
+    if (!read_edge(mrf, edge, &same_pot, &diff_pot, &hard)) return false;
+    if (!hard && -scale * (diff_pot - same_pot) < 0.0) return false;
+  }
+  return true;
+}
+
+double MRFExpansionSolver::pair_cost(const Graphedge & edge,
+                                     const vector <int> & assignment) const {
+  int from = edge.from_node()->id();
+  int to = edge.to_node()->id();
+  bool same = _state_id[_node_start[from] + assignment[from]] ==
+      _state_id[_node_start[to] + assignment[to]];
+  return same ? _same_cost[edge.id()] : _diff_cost[edge.id()];
+}
+
+double MRFExpansionSolver::energy(const vector <int> & assignment) const {
+  double total = 0.0;
+  for (int node = 0; node < _mrf.graph().num_nodes(); node++) {
+    total += _unary[_node_start[node] + assignment[node]];
+  }
+  foreach (Edge edge, _mrf.graph().edges()) {
+    total += pair_cost(*edge, assignment);
+  }
+  return total;
+}
+
+// Pairwise cost is the same cost plus w if the ids differ. The same
+// costs are the same for every cut, so only w is added.
+void MRFExpansionSolver::add_pair(const Graphedge & edge, int alpha,
+                                  const vector <int> & assignment) {
+  int from = edge.from_node()->id();
+  int to = edge.to_node()->id();
+  double w = _diff_cost[edge.id()] - _same_cost[edge.id()];
+  if (w == 0.0) return;
+  int from_var = _var[from], to_var = _var[to];
+  int from_id = _state_id[_node_start[from] + assignment[from]];
+  int to_id = _state_id[_node_start[to] + assignment[to]];
+  if (from_var != -1 && to_var != -1) {
+    // Costs w[from_id != to_id], w, w, 0 for (stay, stay), (stay,
+    // switch), (switch, stay), (switch, switch).
+    double stay = (from_id != to_id) ? w : 0.0;
+    _flow.add_terminal(from_var, 0.0, stay);
+    _flow.add_edge(from_var, to_var, w - stay, w);
+  } else if (from_var != -1) {
+    _flow.add_terminal(from_var, (to_id != alpha) ? w : 0.0,
+                       (from_id != to_id) ? w : 0.0);
+  } else {
+    _flow.add_terminal(to_var, (from_id != alpha) ? w : 0.0,
+                       (from_id != to_id) ? w : 0.0);
+  }
+}
+
+bool MRFExpansionSolver::expand(int label, vector <int> * assignment,
+                                double * current) {
+  const Graph & graph = _mrf.graph();
+  const vector <int> & nodes = _label_nodes[label];
+  int alpha = _labels[label];
+  int vars = 0;
+  foreach (int node, nodes) {
+    int a = _mrf.state_index(node, alpha);
+    _var[node] = (a == (*assignment)[node]) ? -1 : vars++;
+  }
+  if (vars == 0) return false;
+
+  // A node in the sink set switches to alpha. Its source link is
+  // cut when it switches, its sink link when it stays. Only edges
+  // at a node that can switch matter, and an edge between two is
+  // added from its from node.
+  _flow.reset(vars);
+  foreach (int node, nodes) {
+    if (_var[node] == -1) continue;
+    int a = _mrf.state_index(node, alpha);
+    _flow.add_terminal(_var[node], _unary[_node_start[node] + a],
+                       _unary[_node_start[node] + (*assignment)[node]]);
+  }
+  foreach (int node, nodes) {
+    if (_var[node] == -1) continue;
+    const Graphnode & n = graph.node(node);
+    foreach (Edge edge, n.edges()) {
+      add_pair(*edge, alpha, *assignment);
+    }
+    foreach (Edge edge, n.in_edges()) {
+      if (_var[edge->from_node()->id()] == -1) {
+        add_pair(*edge, alpha, *assignment);
+      }
+    }
+  }
+  _flow.solve();
+
+  // Cost change of the nodes that switch and their edges, counting
+  // an edge between two of them once.
+  _proposal = *assignment;
+  foreach (int node, nodes) {
+    if (_var[node] != -1 && _flow.in_sink_set(_var[node])) {
+      _proposal[node] = _mrf.state_index(node, alpha);
+    }
+  }
+  double delta = 0.0;
+  foreach (int node, nodes) {
+    if (_proposal[node] == (*assignment)[node]) continue;
+    delta += _unary[_node_start[node] + _proposal[node]] -
+        _unary[_node_start[node] + (*assignment)[node]];
+    const Graphnode & n = graph.node(node);
+    foreach (Edge edge, n.edges()) {
+      delta += pair_cost(*edge, _proposal) - pair_cost(*edge, *assignment);
+    }
+    foreach (Edge edge, n.in_edges()) {
+      int from = edge->from_node()->id();
+      if (_proposal[from] == (*assignment)[from]) {
+        delta += pair_cost(*edge, _proposal) - pair_cost(*edge, *assignment);
+      }
+    }
+  }
+  foreach (int node, nodes) {
+    _var[node] = -1;
+  }
+
+  if (delta < -1e-9 * max(1.0, fabs(*current))) {
+    assignment->swap(_proposal);
+    *current += delta;
+    return true;
+  }
+  return false;
+}
+
+double MRFExpansionSolver::solve(double scale,
+                                 const vector <double> & state_cost,
+                                 vector <int> * assignment, double * primal) {
+  const Graph & graph = _mrf.graph();
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    for (int s = 0; s < _mrf.num_states(node); s++) {
+      int state = _node_start[node] + s;
+      _unary[state] = -scale * _mrf.node_pot(node, s) +
+          (state_cost.empty() ? 0.0 : state_cost[state]);
+    }
+  }
+  for (int edge = 0; edge < graph.num_edges(); edge++) {
+    _same_cost[edge] = -scale * _same_pot[edge];
+    _diff_cost[edge] = _hard[edge] ? INF : -scale * _diff_pot[edge];
+  }
+
+  assignment->assign(graph.num_nodes(), 0);
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    int start = _node_start[node];
+    for (int s = 1; s < _mrf.num_states(node); s++) {
+      if (_unary[start + s] < _unary[start + (*assignment)[node]]) {
+        (*assignment)[node] = s;
+      }
+    }
+  }
+
+  // Cost of the cheapest states and of every edge's equal pair; no
+  // assignment costs less.
+  double base = 0.0;
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    base += _unary[_node_start[node] + (*assignment)[node]];
+  }
+  for (int edge = 0; edge < graph.num_edges(); edge++) {
+    base += _same_cost[edge];
+  }
+
+  // Updated by each move's change; recomputed at the end.
+  double current = energy(*assignment);
+  double initial = current;
+  _moves = 0;
+  bool changed = true;
+  for (_cycles = 0; changed && _cycles < _max_cycles; _cycles++) {
+    changed = false;
+    for (int label = 0; label < _labels.size(); label++) {
+      if (expand(label, assignment, &current)) {
+        changed = true;
+        _moves++;
+      }
+    }
+  }
+
+  current = energy(*assignment);
+  _energy = current;
+  _local_minimum = !changed;
+
+  // A move is only taken if it gains more than the tolerance in
+  // expand, so each label may leave up to that much on the table.
+  _bound = base;
+  if (_local_minimum) {
+    double slack = _labels.size() * 1e-9 *
+        max(1.0, max(fabs(initial), fabs(current)));
+    _bound = max(base, base + 0.5 * (current - base - slack));
+  }
+
+  *primal = current;
+  if (!state_cost.empty()) {
+    for (int node = 0; node < graph.num_nodes(); node++) {
+      *primal -= state_cost[_node_start[node] + (*assignment)[node]];
+    }
+  }
+  return _bound;
+}
@@ -0,0 +1,123 @@
+#ifndef MRFEXPANSIONSOLVER_H
+#define MRFEXPANSIONSOLVER_H
+
+#include <cmath>
+#include <vector>
+#include <MaxFlow.h>
+#include "MRF.h"
+using namespace std;
+
+/**
+ * Alpha-expansion (Boykov, Veksler and Zabih) for Potts MRFs of any
+ * shape. Labels are state ids. Each move offers every node the choice of
+ * keeping its state or switching to the state with id alpha, and takes
+ * the best choice for all nodes at once by a minimum cut; moves cycle
+ * over the labels until none lowers the cost.
+ *
+ * Costs are as in MRFLoopySolver: a node's potential is charged once
+ * and a pair with no edge potential is not allowed. An edge is Potts if
+ * all pairs of equal ids share one potential and all pairs of unequal
+ * ids share another (or are all missing, which makes the edge a hard
+ * equality). The result is a local minimum within a known factor of the
+ * best. Since a local minimum costs at most twice the best once each
+ * node's cheapest state and each edge's equal cost are taken off (Boykov,
+ * Veksler and Zabih, theorem 6.1), half of that excess is a lower bound.
+ */
+class MRFExpansionSolver {
+ public:
+  MRFExpansionSolver(const MRF & mrf);
+
+  /**
+   * Whether every edge is Potts, and under this scale costs unequal
+   * pairs at least as much as equal ones, so each move is a cut.
+   */
+  static bool is_potts(const MRF & mrf, double scale);
+
+  // Flat id of a node's first state.
+  int state_offset(int node) const {
+    return _node_start[node];
+  }
+
+  int num_states() const {
+    return _node_start.back();
+  }
+
+  /**
+   * Stop after this many cycles over the labels.
+   */
+  void set_max_cycles(int max_cycles) {
+    _max_cycles = max_cycles;
+  }
+
+  /**
+   * Run expansion moves from the best state of each node alone.
+   * @param scale Multiplies the (negated) potentials
+   * @param state_cost Extra cost by flat state id (or empty)
+   * @param assignment Set to the local state of each node
+   * @param primal Set to the cost without state_cost
+   * @return A lower bound on the best cost, including state_cost
+   */
+  double solve(double scale, const vector <double> & state_cost,
+               vector <int> * assignment, double * primal);
+
+  // About the last solve.
+  int cycles() const { return _cycles; }
+  int moves() const { return _moves; }
+  double bound() const { return _bound; }
+
+  // Cost of the assignment, including state_cost.
+  double energy() const { return _energy; }
+
+  // Whether the moves stopped at a local minimum rather than at the
+  // cycle limit. If not, the bound takes only the cheapest states.
+  bool local_minimum() const { return _local_minimum; }
+
+  // Whether the bound meets the cost, which makes the assignment
+  // optimal and the bound its exact cost.
+  bool tight() const {
+    return _energy - _bound < 1e-6 * max(1.0, fabs(_bound));
+  }
+
+ private:
+  const MRF & _mrf;
+  vector <int> _node_start;
+
+  // State id by flat state, every id in use in order, and the nodes
+  // that have each one.
+  vector <int> _state_id;
+  vector <int> _labels;
+  vector <vector <int> > _label_nodes;
+
+  // Unscaled potentials of each edge for equal and unequal ids.
+  vector <double> _same_pot;
+  vector <double> _diff_pot;
+  vector <bool> _hard;
+
+  // Scaled costs for the current solve.
+  vector <double> _unary;
+  vector <double> _same_cost;
+  vector <double> _diff_cost;
+
+  // Cut variable of each node in a move, or -1 if it can't move.
+  vector <int> _var;
+  vector <int> _proposal;
+  Scarab::Graph::MaxFlow _flow;
+
+  int _max_cycles;
+  int _cycles;
+  int _moves;
+  double _bound;
+  double _energy;
+  bool _local_minimum;
+
+  static bool read_edge(const MRF & mrf, int edge, double * same_pot,
+                        double * diff_pot, bool * hard);
+  double energy(const vector <int> & assignment) const;
+  double pair_cost(const Graphedge & edge,
+                   const vector <int> & assignment) const;
+  void add_pair(const Graphedge & edge, int alpha,
+                const vector <int> & assignment);
+  bool expand(int label, vector <int> * assignment, double * current);
+};
+
+#endif
@@ -13,20 +13,18 @@ MRFHypergraph *  MRFHypergraph::from_mrf(const MRF & mrf) {
 
   mrf_hyp->_canonical_hnode = new Cache <NodeAssignment, Hypernode * > (mrf.assignments());
   mrf_hyp->_canonical_assignment = new map<int, NodeAssignment>();
-  Cache <Graphnode, Cache <Graphnode, Cache <State, Hypernode * > *> * > middle_nodes (nodes.size());
+
+  // The message node of edge e for to state t is middle_nodes[middle_start[e] + t].
+  vector <int> middle_start(mrf.graph().num_edges(), 0);
+  vector <Hypernode *> middle_nodes;
   int hnode_id = 0;
   int hedge_id = 0;
   
   foreach (Node n, nodes) {
-    Cache <Graphnode, Cache <State, Hypernode * > *> * c = 
-      new Cache <Graphnode, Cache <State, Hypernode * > *> (nodes.size());
-    middle_nodes.set_value(*n, c);
-    
     // out edges
     foreach (Edge e, n->edges()) {
       Node to_node = e->to_node();
-      Cache <State, Hypernode * > * c2 = new Cache <State, Hypernode * >(mrf.state_max(*to_node));
-      c->set_value(*to_node, c2);
+      middle_start[e->id()] = middle_nodes.size();
 
       foreach (const State & s, mrf.states(*to_node)) {
         // one node for each "message"
@@ -36,36 +34,31 @@ MRFHypergraph *  MRFHypergraph::from_mrf(const MRF & mrf) {
 
         hnode_id++;
         mrf_hyp->_nodes.push_back(node);
-        // TODO 
-        c2->set_value(s, node); 
+        middle_nodes.push_back(node);
       }
     }
 
     // One hypergraph canonical node for each hypergraph state 
-    foreach (const State & my_s, mrf.states(*n) ) {
+    const vector <State> & my_states = mrf.states(*n);
+    for (int my_i = 0; my_i < my_states.size(); my_i++) {
+      const State & my_s = my_states[my_i];
       stringstream buf;
       buf << n->id() << "_" << my_s.id(); 
-      stringstream wstr;
-      double node_pot = -mrf.node_pot(*n, my_s);
-      HypernodeImpl * base_hnode = new HypernodeImpl(buf.str(), hnode_id,  
-                                                     svector_from_str<int, double>(wstr.str()));
+      double node_pot = -mrf.node_pot(n->id(), my_i);
+      HypernodeImpl * base_hnode = new HypernodeImpl(buf.str(), hnode_id, new wvector());
       NodeAssignment assign = mrf.make_assignment(*n, my_s);
-      int id = assign.id();
       mrf_hyp->_canonical_hnode->set_value(assign, base_hnode);
-      (*mrf_hyp->_canonical_assignment)[base_hnode->id()] = mrf.make_assignment(*n, my_s);
+      (*mrf_hyp->_canonical_assignment)[base_hnode->id()] = assign;
       hnode_id++;
       mrf_hyp->_nodes.push_back(base_hnode);
 
       // outgoing edges
       foreach (Edge e, n->edges()) {
-        Node to_node = e->to_node();
-        const map<int, double> &states = mrf.states_with_potential(*e, my_s);
-        for (map<int, double>::const_iterator it = states.begin(); 
-             it != states.end(); ++it ) {
-          int to_s = it->first;
-          double edge_potential = it->second;
-          //if (!mrf.has_edge_pot(*e, my_s, to_s)) continue;
-          Hypernode * to_hnode = middle_nodes.get(*n)->get(*to_node)->get_by_key(to_s);
+        for (int entry = mrf.edge_begin(e->id(), my_i); 
+             entry < mrf.edge_end(e->id(), my_i); entry++) {
+          int to_s = mrf.edge_to(entry);
+          double edge_potential = mrf.edge_value(entry);
+          Hypernode * to_hnode = middle_nodes[middle_start[e->id()] + to_s];
           vector <Hypernode *> tail_node;
           tail_node.push_back( base_hnode);
           stringstream wstr;
@@ -83,8 +76,7 @@ MRFHypergraph *  MRFHypergraph::from_mrf(const MRF & mrf) {
       // Incoming edges
       vector <Hypernode *> tail_nodes;
       foreach (Edge e, n->in_edges()) {
-        Node from_node = e->from_node();
-        Hypernode * mid_node = middle_nodes.get(*from_node)->get(*n)->get(my_s);
+        Hypernode * mid_node = middle_nodes[middle_start[e->id()] + my_i];
         tail_nodes.push_back(mid_node);
       }
       HyperedgeImpl * edge = new HyperedgeImpl("", new wvector(), hedge_id, tail_nodes, base_hnode);
@@ -106,11 +98,12 @@ MRFHypergraph *  MRFHypergraph::from_mrf(const MRF & mrf) {
   hnode_id++;
   mrf_hyp->_nodes.push_back(mrf_hyp->_root);
 
-  foreach (const State & last_state, mrf.states(*root) ) {
+  const vector <State> & root_states = mrf.states(*root);
+  for (int last_i = 0; last_i < root_states.size(); last_i++) {
     vector <Hypernode *> tail_nodes;
-    Hypernode * last_node = mrf_hyp->_canonical_hnode->get(mrf.make_assignment(*root, last_state));
+    Hypernode * last_node = mrf_hyp->_canonical_hnode->get(mrf.make_assignment(*root, root_states[last_i]));
     tail_nodes.push_back(last_node);
-    double node_pot = -mrf.node_pot(*root, last_state);
+    double node_pot = -mrf.node_pot(root->id(), last_i);
     stringstream wstr;
     wstr << "value="<< node_pot;
     HyperedgeImpl * edge = new HyperedgeImpl("",svector_from_str<int, double>(wstr.str()), hedge_id, tail_nodes, mrf_hyp->_root);
@@ -0,0 +1,211 @@
+#include "MRFLoopySolver.h"
+
+#include <cmath>
+#include "../common.h"
+
+MRFLoopySolver::MRFLoopySolver(const MRF & mrf)
+    : _mrf(mrf), _max_iterations(200), _tolerance(1e-6),
+      _iterations(0), _converged(false), _bound(-INF), _energy(INF) {
+  const Graph & graph = mrf.graph();
+  int max_states = 0;
+  _node_start.push_back(0);
+  foreach (Node node, graph.nodes()) {
+    int n = mrf.num_states(node->id());
+    _node_start.push_back(_node_start.back() + n);
+    max_states = max(max_states, n);
+  }
+  int from_size = 0, to_size = 0;
+  foreach (Edge edge, graph.edges()) {
+    _from_start.push_back(from_size);
+    _to_start.push_back(to_size);
+    from_size += mrf.num_states(edge->from_node()->id());
+    to_size += mrf.num_states(edge->to_node()->id());
+  }
+  _from_message.resize(from_size, 0.0);
+  _to_message.resize(to_size, 0.0);
+  _belief.resize(num_states());
+  _from_rest.resize(max_states);
+  _to_rest.resize(max_states);
+  _column.resize(max_states);
+}
+
+double MRFLoopySolver::pair_cost(int edge, int s, int t, double scale) const {
+  int entry = _mrf.edge_entry(edge, s, t);
+  if (entry == -1) return INF;
+  return -scale * _mrf.edge_value(entry);
+}
+
+void MRFLoopySolver::update_edge(int edge, double scale) {
+  const Graphedge & e = *_mrf.graph().edges()[edge];
+  int from = e.from_node()->id();
+  int to = e.to_node()->id();
+  int from_states = _mrf.num_states(from);
+  int to_states = _mrf.num_states(to);
+  double * from_message = &_from_message[_from_start[edge]];
+  double * to_message = &_to_message[_to_start[edge]];
+  double * from_belief = &_belief[_node_start[from]];
+  double * to_belief = &_belief[_node_start[to]];
+
+  // Beliefs without this edge's messages.
+  for (int s = 0; s < from_states; s++) {
+    _from_rest[s] = from_belief[s] - from_message[s];
+  }
+  for (int t = 0; t < to_states; t++) {
+    _to_rest[t] = to_belief[t] - to_message[t];
+    _column[t] = INF;
+  }
+
+  // Row minima for the from node, column minima for the to node, in
+  // one pass over the rows.
+  for (int s = 0; s < from_states; s++) {
+    double row = INF;
+    for (int entry = _mrf.edge_begin(edge, s); entry < _mrf.edge_end(edge, s);
+         entry++) {
+      int t = _mrf.edge_to(entry);
+      double cost = -scale * _mrf.edge_value(entry);
+      row = min(row, cost + _to_rest[t]);
+      _column[t] = min(_column[t], cost + _from_rest[s]);
+    }
+    from_message[s] = 0.5 * (row - _from_rest[s]);
+    from_belief[s] = _from_rest[s] + from_message[s];
+  }
+  for (int t = 0; t < to_states; t++) {
+    to_message[t] = 0.5 * (_column[t] - _to_rest[t]);
+    to_belief[t] = _to_rest[t] + to_message[t];
+  }
+}
+
+double MRFLoopySolver::current_bound(double scale) const {
+  double bound = 0.0;
+  for (int node = 0; node < _mrf.graph().num_nodes(); node++) {
+    double best = INF;
+    for (int state = _node_start[node]; state < _node_start[node + 1];
+         state++) {
+      best = min(best, _belief[state]);
+    }
+    bound += best;
+  }
+  for (int edge = 0; edge < _mrf.graph().num_edges(); edge++) {
+    const double * from_message = &_from_message[_from_start[edge]];
+    const double * to_message = &_to_message[_to_start[edge]];
+    int from_states = _mrf.num_states(_mrf.graph().edges()[edge]->from_node()->id());
+    double best = INF;
+    for (int s = 0; s < from_states; s++) {
+      for (int entry = _mrf.edge_begin(edge, s);
+           entry < _mrf.edge_end(edge, s); entry++) {
+        best = min(best, -scale * _mrf.edge_value(entry) -
+                   from_message[s] - to_message[_mrf.edge_to(entry)]);
+      }
+    }
+    bound += best;
+  }
+  return bound;
+}
+
+double MRFLoopySolver::decode(double scale, const vector <double> & state_cost,
+                              vector <int> * assignment, double * primal) {
+  // Take nodes in order, swapping the messages from decided neighbours
+  // for the actual pair costs.
+  const Graph & graph = _mrf.graph();
+  assignment->assign(graph.num_nodes(), -1);
+  vector <double> score;
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    const Graphnode & n = graph.node(node);
+    int states = _mrf.num_states(node);
+    score.assign(&_belief[_node_start[node]],
+                 &_belief[_node_start[node]] + states);
+    foreach (Edge edge, n.edges()) {
+      int other = (*assignment)[edge->to_node()->id()];
+      if (other == -1) continue;
+      const double * message = &_from_message[_from_start[edge->id()]];
+      for (int s = 0; s < states; s++) {
+        score[s] += pair_cost(edge->id(), s, other, scale) - message[s];
+      }
+    }
+    foreach (Edge edge, n.in_edges()) {
+      int other = (*assignment)[edge->from_node()->id()];
+      if (other == -1) continue;
+      const double * message = &_to_message[_to_start[edge->id()]];
+      for (int t = 0; t < states; t++) {
+        score[t] += pair_cost(edge->id(), other, t, scale) - message[t];
+      }
+    }
+    int best = 0;
+    for (int s = 1; s < states; s++) {
+      if (score[s] < score[best]) best = s;
+    }
+    (*assignment)[node] = best;
+  }
+
+  double energy = 0.0;
+  *primal = 0.0;
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    int s = (*assignment)[node];
+    double node_cost = -scale * _mrf.node_pot(node, s);
+    *primal += node_cost;
+    energy += node_cost + (state_cost.empty() ? 0.0 :
+                           state_cost[_node_start[node] + s]);
+  }
+  foreach (Edge edge, graph.edges()) {
+    double cost = pair_cost(edge->id(),
+                            (*assignment)[edge->from_node()->id()],
+                            (*assignment)[edge->to_node()->id()], scale);
+    *primal += cost;
+    energy += cost;
+  }
+  return energy;
+}
+
+double MRFLoopySolver::solve(double scale, const vector <double> & state_cost,
+                             vector <int> * assignment, double * primal) {
+  const Graph & graph = _mrf.graph();
+
+  // Rebuild the beliefs from the kept messages under the new costs.
+  for (int node = 0; node < graph.num_nodes(); node++) {
+    for (int s = 0; s < _mrf.num_states(node); s++) {
+      int state = _node_start[node] + s;
+      _belief[state] = -scale * _mrf.node_pot(node, s) +
+          (state_cost.empty() ? 0.0 : state_cost[state]);
+    }
+  }
+  foreach (Edge edge, graph.edges()) {
+    int from = _node_start[edge->from_node()->id()];
+    int to = _node_start[edge->to_node()->id()];
+    for (int s = 0; s < _mrf.num_states(edge->from_node()->id()); s++) {
+      _belief[from + s] += _from_message[_from_start[edge->id()] + s];
+    }
+    for (int t = 0; t < _mrf.num_states(edge->to_node()->id()); t++) {
+      _belief[to + t] += _to_message[_to_start[edge->id()] + t];
+    }
+  }
+
+  _bound = current_bound(scale);
+  _energy = INF;
+  _converged = false;
+  vector <int> decoded;
+  double decoded_primal;
+  bool found = false;
+  for (_iterations = 1; _iterations <= _max_iterations; _iterations++) {
+    for (int edge = 0; edge < graph.num_edges(); edge++) {
+      update_edge(edge, scale);
+    }
+    double last = _bound;
+    _bound = current_bound(scale);
+
+    double energy = decode(scale, state_cost, &decoded, &decoded_primal);
+    if (!found || energy < _energy) {
+      found = true;
+      _energy = energy;
+      *assignment = decoded;
+      *primal = decoded_primal;
+    }
+
+    double slack = _tolerance * max(1.0, fabs(_bound));
+    if (_energy - _bound < slack || _bound - last < slack) {
+      _converged = true;
+      break;
+    }
+  }
+  _iterations = min(_iterations, _max_iterations);
+  return _bound;
+}
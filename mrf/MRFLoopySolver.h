@@ -0,0 +1,107 @@
+#ifndef MRFLOOPYSOLVER_H
+#define MRFLOOPYSOLVER_H
+
+#include <cmath>
+#include <vector>
+#include "MRF.h"
+using namespace std;
+
+/**
+ * MPLP (Globerson and Jaakkola) block coordinate descent on the LP
+ * relaxation of an MRF of any shape, for MRFs MRFTreeSolver can't take.
+ * Each edge sends a message to both of its nodes; the sum of the node
+ * and edge minima under the messages is a lower bound on the best
+ * assignment, and each edge update can only raise it.
+ *
+ * Costs are as in MRFTreeSolver, but each node's potential is charged
+ * once and a pair with no edge potential is not allowed. Messages are
+ * kept between calls, so a solve after a small change in state_cost
+ * starts near the last fixed point.
+ */
+class MRFLoopySolver {
+ public:
+  MRFLoopySolver(const MRF & mrf);
+
+  // Flat id of a node's first state.
+  int state_offset(int node) const {
+    return _node_start[node];
+  }
+
+  int num_states() const {
+    return _node_start.back();
+  }
+
+  /**
+   * Stop after this many passes over the edges.
+   */
+  void set_max_iterations(int max_iterations) {
+    _max_iterations = max_iterations;
+  }
+
+  /**
+   * Stop when a pass raises the bound, or the bound is within the
+   * decoded cost, by less than this.
+   */
+  void set_tolerance(double tolerance) {
+    _tolerance = tolerance;
+  }
+
+  /**
+   * Run MPLP and decode an assignment from the node beliefs.
+   * @param scale Multiplies the (negated) potentials
+   * @param state_cost Extra cost by flat state id (or empty)
+   * @param assignment Set to the local state of each node
+   * @param primal Set to the decoded cost without state_cost
+   * @return The lower bound, including state_cost
+   */
+  double solve(double scale, const vector <double> & state_cost,
+               vector <int> * assignment, double * primal);
+
+  // About the last solve.
+  int iterations() const { return _iterations; }
+  bool converged() const { return _converged; }
+  double bound() const { return _bound; }
+
+  // Cost of the decoded assignment, including state_cost (INF if it
+  // uses a pair with no potential).
+  double energy() const { return _energy; }
+
+  // Whether the bound meets the decoded cost, which makes the decoded
+  // assignment optimal and the bound its exact cost.
+  bool tight() const {
+    return _energy - _bound < _tolerance * max(1.0, fabs(_bound));
+  }
+
+ private:
+  const MRF & _mrf;
+  vector <int> _node_start;
+
+  // Messages of each edge, to its from node at _from_start[edge] + s
+  // and to its to node at _to_start[edge] + t.
+  vector <int> _from_start;
+  vector <int> _to_start;
+  vector <double> _from_message;
+  vector <double> _to_message;
+
+  // Node beliefs by flat state, and scratch for one edge.
+  vector <double> _belief;
+  vector <double> _from_rest;
+  vector <double> _to_rest;
+  vector <double> _column;
+
+  int _max_iterations;
+  double _tolerance;
+
+  int _iterations;
+  bool _converged;
+  double _bound;
+  double _energy;
+
+  void update_edge(int edge, double scale);
+  double current_bound(double scale) const;
+  double decode(double scale, const vector <double> & state_cost,
+                vector <int> * assignment, double * primal);
+  double pair_cost(int edge, int s, int t, double scale) const;
+};
+
+#endif
@@ -2,8 +2,10 @@
 #define MRFSOLVERS_H
 
 #include "DualDecomposition.h"
-#include "MRFHypergraph.h"
-#include "HypergraphAlgorithms.h"
+#include "ThreadPool.h"
+#include "MRFTreeSolver.h"
+#include "MRFLoopySolver.h"
+#include "MRFExpansionSolver.h"
 #include "MRFConstraints.h"
 #include "EdgeCache.h"
 
@@ -11,7 +13,7 @@
 
 
 template <class Other>
-class ConstrainerDual:public DualDecompositionSubproblem {
+class ConstrainerDual:public DualDecompositionSubproblem, public ParallelTask {
  public:
    ConstrainerDual(const vector <MRF*> & constraints, 
                    const wvector & base_weights,
@@ -22,24 +24,76 @@ class ConstrainerDual:public DualDecompositionSubproblem {
     _base_weights(base_weights)
     {
     _cur_weights = new wvector();
-    _hypergraphs.resize(constraints.size());
+    _solvers.resize(constraints.size());
+    _loopy_solvers.resize(constraints.size());
+    _expansion_solvers.resize(constraints.size());
+    _use_graph_cut = false;
+    _state_lag.resize(constraints.size());
+    _state_cost.resize(constraints.size());
 
     // cache
     _dirty_cache.resize(constraints.size());
     _subgrad_cache.resize(constraints.size());
     _dual_cache.resize(constraints.size());
+    _exact_cache.resize(constraints.size(), true);
     _primal_cache.resize(constraints.size());
+    _time_cache.resize(constraints.size());
+    _smooth_grad_cache.resize(constraints.size());
+    _smooth_dual_cache.resize(constraints.size());
+    _temperature = 0.0;
     for (int i = 0; i < constraints.size(); i++) {
       _dirty_cache[i] = true;
     }
 
     _is_first = true;
+    _pool = new ThreadPool(1);
+    _thread_assignment.resize(1);
+    _thread_marginals.resize(1);
   };
 
+  ~ConstrainerDual() {
+    delete _pool;
+    foreach (MRFTreeSolver * solver, _solvers) {
+      delete solver;
+    }
+    foreach (MRFLoopySolver * solver, _loopy_solvers) {
+      delete solver;
+    }
+    foreach (MRFExpansionSolver * solver, _expansion_solvers) {
+      delete solver;
+    }
+  }
   
   void solve(const SubgradState & info,
              SubgradResult & result);
 
+  /** 
+   * Solve dirty constraint groups on a pool of threads.
+   * 
+   * @param num_threads Number of threads (1 is serial)
+   */
+  void set_num_threads(int num_threads) {
+    delete _pool;
+    _pool = new ThreadPool(num_threads);
+    _thread_assignment.resize(_pool->num_threads());
+    _thread_marginals.resize(_pool->num_threads());
+  }
+
+  /** 
+   * Solve groups that are not trees but are Potts models by 
+   * alpha-expansion rather than MPLP. Much faster on large soft Potts
+   * groups (MPLP converges at once on hard equality ones), but 
+   * the dual of those groups is then a looser bound, so they rarely 
+   * give a certificate. Set before the first solve.
+   * 
+   * @param use_graph_cut 
+   */
+  void set_use_graph_cut(bool use_graph_cut) {
+    _use_graph_cut = use_graph_cut;
+  }
+
+  void run_item(int group, int thread_id);
+
   void update_weights(const wvector & updates,  
                       wvector * weights, 
                       double mult) {
@@ -77,24 +131,48 @@ class ConstrainerDual:public DualDecompositionSubproblem {
   const MrfAligner<Other> & _consistency;
   const vector < MRF*> & constraints;
   wvector * _cur_weights; 
-  vector <MRFHypergraph *> _hypergraphs;
 
   const wvector & _base_weights;
+
+  // Weight of the "value" feature, which scales the potentials.
+  double _value_weight;
+
+  // One solver per group, with the lagrange id of each flat state (or
+  // -1) and a buffer for the state costs. Groups that are not trees get
+  // an MRFLoopySolver instead, whose dual is the LP bound and whose
+  // assignment is decoded from it, or with graph cuts on, an
+  // MRFExpansionSolver if they are Potts.
+  vector <MRFTreeSolver *> _solvers;
+  vector <MRFLoopySolver *> _loopy_solvers;
+  vector <MRFExpansionSolver *> _expansion_solvers;
+  bool _use_graph_cut;
+  vector <vector <int> > _state_lag;
+  vector <vector <double> > _state_cost;
+
+  // Assignment and marginal buffers by thread.
+  vector <vector <int> > _thread_assignment;
+  vector <vector <double> > _thread_marginals;
+
   bool assign_to_lag(int group_num, const NodeAssignment & a, int & lag);
   MrfIndex lag_to_assign(int lag);
-  wvector build_mrf_subgradient(int group_num, 
-                                const MRFHypergraph & mrf, 
-                                HNodes best_nodes);
-  EdgeCache build_mrf_constraint_vector(int group_num, 
-                                        const MRFHypergraph & mrf);
+  void set_up_group(int group);
   
   // cache
   vector <wvector> _subgrad_cache;
   vector <double> _primal_cache;
   vector <double> _dual_cache;
+  // False for a group whose dual is a bound below its best cost. Not
+  // vector <bool>: workers write different groups at once.
+  vector <int> _exact_cache;
   vector <bool> _dirty_cache;  
+  vector <double> _time_cache;
 
-  
+  // Smoothed (soft-min) version, filled when _temperature > 0
+  double _temperature;
+  vector <wvector> _smooth_grad_cache;
+  vector <double> _smooth_dual_cache;
+
+  ThreadPool * _pool;
 };
 
 
@@ -112,97 +190,194 @@ MrfIndex ConstrainerDual<Other>::lag_to_assign(int lag) {
 }
 
 template <class Other>
-wvector ConstrainerDual<Other>::build_mrf_subgradient(int group_num, 
-                                                      const MRFHypergraph & mrf, 
-                                                      HNodes best_nodes) {
-  wvector ret;
-  foreach (HNode n, best_nodes) {
-    if (mrf.node_has_assignment(n)) {
-      const NodeAssignment & a = mrf.assignment_from_node(n);
+void ConstrainerDual<Other>::set_up_group(int group) {
+  const MRF & mrf = *constraints[group];
+  if (MRFTreeSolver::is_tree(mrf)) {
+    _solvers[group] = new MRFTreeSolver(mrf);
+  } else if (_use_graph_cut && 
+             MRFExpansionSolver::is_potts(mrf, _value_weight)) {
+    _expansion_solvers[group] = new MRFExpansionSolver(mrf);
+  } else {
+    _loopy_solvers[group] = new MRFLoopySolver(mrf);
+  }
+  _state_lag[group].assign(mrf.total_states(), -1);
+  _state_cost[group].assign(mrf.total_states(), 0.0);
+  foreach (Node n, mrf.graph().nodes()) {
+    const vector <State> & states = mrf.states(*n);
+    for (int s = 0; s < states.size(); s++) {
       int lag;
-      if (assign_to_lag(group_num, a, lag)) {
-        ret[lag] +=1;
-      }      
+      if (assign_to_lag(group, mrf.make_assignment(*n, states[s]), lag)) {
+        _state_lag[group][mrf.state_offset(n->id()) + s] = lag;
+      }
     }
   }
-  return ret;
 }
+
 template <class Other>
-EdgeCache ConstrainerDual<Other>::build_mrf_constraint_vector(int group_num, 
-                                                               const MRFHypergraph & mrf) {
-  EdgeCache ret(mrf.num_edges());
+void ConstrainerDual<Other>::run_item(int group, int thread_id) {
+  const MRF & mrf = *constraints[group];
+  const vector <int> & state_lag = _state_lag[group];
+  vector <double> & state_cost = _state_cost[group];
+  for (int state = 0; state < state_lag.size(); state++) {
+    state_cost[state] = (state_lag[state] == -1) ? 0.0 :
+      svector_getitem(*_cur_weights, state_lag[state]);
+  }
 
-  foreach (Node n, mrf.mrf().graph().nodes()) {
-    foreach (const State & s, mrf.mrf().states(*n)) {
-      
-      int lag;
-      NodeAssignment assign = mrf.mrf().make_assignment(*n, s);
-      if (!assign_to_lag(group_num, assign, lag)) continue;
-
-      
-      HNode hnode = mrf.node_from_assignment(assign);
-      assert(hnode->edges().size() != 0);
-      foreach (HEdge edge, hnode->edges()) {
-        if (!ret.has_key(*edge)) {
-          ret.set_value(*edge, 0.0);
-        }
-        ret.set_value(*edge, ret.get(*edge) + (*_cur_weights)[lag]);
+  vector <int> & assignment = _thread_assignment[thread_id];
+  double start = Clock::thread_cpu_ms();
+  if (_solvers[group] != NULL) {
+    _dual_cache[group] = _solvers[group]->solve(_value_weight, state_cost, 
+                                                &assignment, 
+                                                &_primal_cache[group]);
+    _exact_cache[group] = true;
+  } else if (_expansion_solvers[group] != NULL) {
+    _dual_cache[group] = _expansion_solvers[group]->solve(_value_weight, state_cost, 
+                                                          &assignment, 
+                                                          &_primal_cache[group]);
+    _exact_cache[group] = _expansion_solvers[group]->tight();
+  } else {
+    _dual_cache[group] = _loopy_solvers[group]->solve(_value_weight, state_cost, 
+                                                      &assignment, 
+                                                      &_primal_cache[group]);
+    _exact_cache[group] = _loopy_solvers[group]->tight();
+  }
+  _time_cache[group] = Clock::thread_cpu_ms() - start;
+
+  wvector local_subgrad;
+  best_derivations[group].clear();
+  for (int node = 0; node < assignment.size(); node++) {
+    if (assignment[node] == -1) continue;
+    const Graphnode & n = mrf.graph().node(node);
+    best_derivations[group].push_back(
+        mrf.make_assignment(n, mrf.states(n)[assignment[node]]));
+    int lag = state_lag[mrf.state_offset(node) + assignment[node]];
+    if (lag != -1) {
+      local_subgrad[lag] += 1;
+    }
+  }
+  _subgrad_cache[group] = local_subgrad;
+
+  // Only tree groups have a soft version; solve() turns smoothing off
+  // for the round if any group lacks one.
+  if (_temperature > 0.0 && _solvers[group] != NULL) {
+    vector <double> & state_marginals = _thread_marginals[thread_id];
+    _smooth_dual_cache[group] = 
+      _solvers[group]->marginals(_value_weight, state_cost, _temperature, 
+                                 &state_marginals);
+    wvector smooth_grad;
+    for (int state = 0; state < state_lag.size(); state++) {
+      if (state_lag[state] != -1 && state_marginals[state] != 0.0) {
+        smooth_grad[state_lag[state]] += state_marginals[state];
       }
     }
-  } 
-  return ret;
-} 
+    _smooth_grad_cache[group] = smooth_grad;
+  }
+}
 
 template <class Other>
 void ConstrainerDual<Other>::solve(const SubgradState & info,
                                    SubgradResult & result) {
 
-  wvector weights =  (*_cur_weights);
   cout << " constrainer " << endl;
   result.dual =0;
   result.primal = 0;
-  int group = 0;
 
   clock_t s = clock();
   cout <<"Num constraints " <<  constraints.size() << endl;
   
-  foreach (const MRF * pmrf, constraints) {
-    const MRF & mrf = *pmrf;
+  // Looking up the value feature shares the feature numberizer, 
+  // so it stays on this thread.
+  if (_is_first) {
+    wvector * value = svector_from_str<int, double>("value=1");
+    _value_weight = value->dot(_base_weights);
+    delete value;
+    for (int group = 0; group < constraints.size(); group++) {
+      set_up_group(group);
+    }
+  }
 
-    if (_is_first) {
-      //cout << " Build hypergraph " << endl;
-      _hypergraphs[group] = MRFHypergraph::from_mrf(mrf);
+  // A new temperature invalidates every smoothed group.
+  if (info.smoothing != _temperature) {
+    _temperature = info.smoothing;
+    for (int group = 0; group < constraints.size(); group++) {
+      _dirty_cache[group] = true;
     }
+  }
+
+  vector <int> dirty;
+  for (int group = 0; group < constraints.size(); group++) {
     if (_dirty_cache[group]) {
-      MRFHypergraph * hypergraph = _hypergraphs[group];
-
-      HypergraphAlgorithms ha(*hypergraph);   
-      NodeCache  score_memo_table(hypergraph->num_nodes()); 
-    
-      NodeBackCache  back_memo_table(hypergraph->num_nodes());
-      EdgeCache * edge_weights = ha.cache_edge_weights(_base_weights);
-      EdgeCache added = build_mrf_constraint_vector(group, *hypergraph) ;
-      EdgeCache * final_weights = ha.combine_edge_weights(*edge_weights, added);
-
-      _dual_cache[group] = ha.best_path(*final_weights, score_memo_table, back_memo_table);
-
-      //wvector feature_vec = ha.construct_best_feature_vector(back_memo_table);
-      HNodes best_nodes = ha.construct_best_node_order(back_memo_table);
-      best_derivations[group] = hypergraph->derivation_to_assignments(best_nodes);
-      HEdges best_edges = ha.construct_best_edges(back_memo_table);
-      wvector feature_vec = ha.construct_best_feature_vector(back_memo_table);
-      _primal_cache[group] = feature_vec.dot(_base_weights);
-      wvector local_subgrad = build_mrf_subgradient(group, *hypergraph, best_nodes);
-    
-      _subgrad_cache[group] = local_subgrad;
-      _dirty_cache[group] = false;
+      dirty.push_back(group);
     }
+  }
+  _pool->run(*this, dirty);
+  foreach (int group, dirty) {
+    _dirty_cache[group] = false;
+  }
 
+  // How the loopy groups did this round, with solve time per route.
+  int loopy = 0, unconverged = 0, iterations = 0;
+  double bound = 0.0, energy = 0.0;
+  int expansion = 0, cycles = 0, moves = 0;
+  double expansion_bound = 0.0, expansion_energy = 0.0;
+  double tree_ms = 0.0, loopy_ms = 0.0, expansion_ms = 0.0;
+  foreach (int group, dirty) {
+    if (_solvers[group] != NULL) {
+      tree_ms += _time_cache[group];
+    } else if (_expansion_solvers[group] != NULL) {
+      MRFExpansionSolver * solver = _expansion_solvers[group];
+      expansion++;
+      cycles += solver->cycles();
+      moves += solver->moves();
+      expansion_bound += solver->bound();
+      expansion_energy += solver->energy();
+      expansion_ms += _time_cache[group];
+    } else {
+      MRFLoopySolver * solver = _loopy_solvers[group];
+      loopy++;
+      iterations += solver->iterations();
+      if (!solver->converged()) unconverged++;
+      bound += solver->bound();
+      energy += solver->energy();
+      loopy_ms += _time_cache[group];
+    }
+  }
+  cout << "MRF tree ms: " << tree_ms << endl;
+  if (loopy > 0) {
+    cout << "MRF loopy groups: " << loopy 
+         << " iterations: " << iterations 
+         << " unconverged: " << unconverged 
+         << " bound: " << bound 
+         << " decoded: " << energy 
+         << " gap: " << energy - bound 
+         << " ms: " << loopy_ms << endl;
+  }
+  if (expansion > 0) {
+    cout << "MRF graph-cut groups: " << expansion 
+         << " cycles: " << cycles 
+         << " moves: " << moves 
+         << " bound: " << expansion_bound 
+         << " energy: " << expansion_energy 
+         << " ms: " << expansion_ms << endl;
+  }
+
+  // Reduce in group order so the result does not depend on 
+  // how the groups were scheduled.
+  result.dual_exact = true;
+  result.has_smooth = _temperature > 0.0;
+  for (int group = 0; group < constraints.size(); group++) {
     result.dual += _dual_cache[group];
+    result.dual_exact = result.dual_exact && _exact_cache[group];
     result.primal += _primal_cache[group];
     result.subgrad += _subgrad_cache[group];
-    group++;
+    if (result.has_smooth && _solvers[group] != NULL) {
+      result.smooth_dual += _smooth_dual_cache[group];
+      result.smooth_grad += _smooth_grad_cache[group];
+    } else {
+      result.has_smooth = false;
+    }
   }
+  result.dirty = dirty.size();
 
 /*   for (wvector::const_iterator it = subgrad.begin(); it != subgrad.end(); it++) { */
 /*     if (it->second !=0.0) {  */
@@ -0,0 +1,212 @@
+#include "MRFTreeSolver.h"
+
+#include <cmath>
+#include "../common.h"
+
+// Soft-min of a and b at temperature t.
+static inline double soft_min(double a, double b, double t) {
+  double m = min(a, b);
+  return m - t * log(1.0 + exp(-fabs(a - b) / t));
+}
+
+MRFTreeSolver::MRFTreeSolver(const MRF & mrf) : _mrf(mrf) {
+  const Graph & graph = mrf.graph();
+  _node_start.push_back(0);
+  foreach (Node node, graph.nodes()) {
+    _node_start.push_back(_node_start.back() + mrf.num_states(node->id()));
+  }
+  int messages = 0;
+  foreach (Edge edge, graph.edges()) {
+    // Messages flow from a node to a later one.
+    assert(edge->from_node()->id() < edge->to_node()->id());
+    _message_start.push_back(messages);
+    messages += mrf.num_states(edge->to_node()->id());
+  }
+  _message.resize(messages);
+  _has_message.resize(messages);
+  _back_state.resize(messages);
+  _back_entry.resize(messages);
+  _belief.resize(num_states());
+  _outside.resize(num_states());
+}
+
+bool MRFTreeSolver::is_tree(const MRF & mrf) {
+  const Graph & graph = mrf.graph();
+  foreach (Node node, graph.nodes()) {
+    bool last = node->id() == graph.num_nodes() - 1;
+    if (node->edges().size() != (last ? 0 : 1)) return false;
+    foreach (Edge edge, node->edges()) {
+      if (edge->to_node()->id() <= node->id()) return false;
+    }
+  }
+  return true;
+}
+
+void MRFTreeSolver::collect_beliefs(int node,
+                                    const vector <double> & state_cost) {
+  const Graphnode & n = _mrf.graph().node(node);
+  for (int s = 0; s < _mrf.num_states(node); s++) {
+    int state = _node_start[node] + s;
+    double belief = extra(state_cost, state);
+    foreach (Edge edge, n.in_edges()) {
+      belief += _message[_message_start[edge->id()] + s];
+    }
+    _belief[state] = belief;
+  }
+}
+
+double MRFTreeSolver::solve(double scale, const vector <double> & state_cost,
+                            vector <int> * assignment, double * primal) {
+  const Graph & graph = _mrf.graph();
+  int num_nodes = graph.num_nodes();
+  assert(num_nodes != 0);
+
+  for (int node = 0; node < num_nodes; node++) {
+    collect_beliefs(node, state_cost);
+    const double * node_pots = _mrf.node_pots(node);
+    foreach (Edge edge, graph.node(node).edges()) {
+      int e = edge->id();
+      int start = _message_start[e];
+      int to_states = _mrf.num_states(edge->to_node()->id());
+      for (int t = 0; t < to_states; t++) {
+        _message[start + t] = INF;
+        _has_message[start + t] = false;
+      }
+      for (int s = 0; s < _mrf.num_states(node); s++) {
+        double base = _belief[_node_start[node] + s] - scale * node_pots[s];
+        for (int entry = _mrf.edge_begin(e, s); entry < _mrf.edge_end(e, s);
+             entry++) {
+          int t = start + _mrf.edge_to(entry);
+          double value = base - scale * _mrf.edge_value(entry);
+          _has_message[t] = true;
+          if (value < _message[t]) {
+            _message[t] = value;
+            _back_state[t] = s;
+            _back_entry[t] = entry;
+          }
+        }
+      }
+      // A state nothing can reach sends no cost (and fixes nothing).
+      for (int t = 0; t < to_states; t++) {
+        if (!_has_message[start + t]) _message[start + t] = 0.0;
+      }
+    }
+  }
+
+  // The last node is the root.
+  int root = num_nodes - 1;
+  double best = INF;
+  int best_state = -1;
+  for (int s = 0; s < _mrf.num_states(root); s++) {
+    double value = _belief[_node_start[root] + s] -
+        scale * _mrf.node_pot(root, s);
+    if (value < best) {
+      best = value;
+      best_state = s;
+    }
+  }
+  assert(best_state != -1);
+
+  assignment->assign(num_nodes, -1);
+  *primal = -scale * _mrf.node_pot(root, best_state);
+  vector <pair <int, int> > stack;
+  stack.push_back(make_pair(root, best_state));
+  while (!stack.empty()) {
+    int node = stack.back().first;
+    int s = stack.back().second;
+    stack.pop_back();
+    (*assignment)[node] = s;
+    foreach (Edge edge, graph.node(node).in_edges()) {
+      int m = _message_start[edge->id()] + s;
+      if (!_has_message[m]) continue;
+      int from = edge->from_node()->id();
+      *primal += -scale * (_mrf.node_pot(from, _back_state[m]) +
+                           _mrf.edge_value(_back_entry[m]));
+      stack.push_back(make_pair(from, _back_state[m]));
+    }
+  }
+  return best;
+}
+
+double MRFTreeSolver::marginals(double scale,
+                                const vector <double> & state_cost,
+                                double temperature,
+                                vector <double> * state_marginals) {
+  const Graph & graph = _mrf.graph();
+  int num_nodes = graph.num_nodes();
+  assert(num_nodes != 0);
+
+  // Inside, as solve with soft-min.
+  for (int node = 0; node < num_nodes; node++) {
+    collect_beliefs(node, state_cost);
+    const double * node_pots = _mrf.node_pots(node);
+    foreach (Edge edge, graph.node(node).edges()) {
+      int e = edge->id();
+      int start = _message_start[e];
+      int to_states = _mrf.num_states(edge->to_node()->id());
+      for (int t = 0; t < to_states; t++) {
+        _message[start + t] = 0.0;
+        _has_message[start + t] = false;
+      }
+      for (int s = 0; s < _mrf.num_states(node); s++) {
+        double base = _belief[_node_start[node] + s] - scale * node_pots[s];
+        for (int entry = _mrf.edge_begin(e, s); entry < _mrf.edge_end(e, s);
+             entry++) {
+          int t = start + _mrf.edge_to(entry);
+          double value = base - scale * _mrf.edge_value(entry);
+          _message[t] = _has_message[t] ?
+              soft_min(_message[t], value, temperature) : value;
+          _has_message[t] = true;
+        }
+      }
+    }
+  }
+
+  int root = num_nodes - 1;
+  double total = 0.0;
+  for (int s = 0; s < _mrf.num_states(root); s++) {
+    double value = _belief[_node_start[root] + s] -
+        scale * _mrf.node_pot(root, s);
+    total = (s == 0) ? value : soft_min(total, value, temperature);
+  }
+
+  // Outside, from the root back. A state no message carries is never
+  // reached and keeps INF.
+  state_marginals->assign(num_states(), 0.0);
+  for (int node = num_nodes - 1; node >= 0; node--) {
+    const double * node_pots = _mrf.node_pots(node);
+    for (int s = 0; s < _mrf.num_states(node); s++) {
+      int state = _node_start[node] + s;
+      bool reached = false;
+      double outside = 0.0;
+      if (node == root) {
+        outside = -scale * node_pots[s];
+        reached = true;
+      }
+      foreach (Edge edge, graph.node(node).edges()) {
+        int e = edge->id();
+        int to_start = _node_start[edge->to_node()->id()];
+        for (int entry = _mrf.edge_begin(e, s); entry < _mrf.edge_end(e, s);
+             entry++) {
+          int t = _mrf.edge_to(entry);
+          double above = _outside[to_start + t];
+          if (above > INF / 2) continue;
+
+          // Outside of the message: the rest of the to state's belief.
+          double message_outside = above + _belief[to_start + t] -
+              _message[_message_start[e] + t];
+          double value = message_outside -
+              scale * (node_pots[s] + _mrf.edge_value(entry));
+          outside = reached ? soft_min(outside, value, temperature) : value;
+          reached = true;
+        }
+      }
+      _outside[state] = reached ? outside : INF;
+      if (reached) {
+        (*state_marginals)[state] =
+            exp(-(_belief[state] + outside - total) / temperature);
+      }
+    }
+  }
+  return total;
+}
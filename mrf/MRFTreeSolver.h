@@ -0,0 +1,81 @@
+#ifndef MRFTREESOLVER_H
+#define MRFTREESOLVER_H
+
+#include <vector>
+#include "MRF.h"
+using namespace std;
+
+/**
+ * Max-product (min-sum) message passing on an MRF, reading the potential
+ * tables directly. Like MRFHypergraph::from_mrf, edge direction is the
+ * elimination order (every edge goes to a later node, and the last node
+ * is the root), so it is exact on trees. It finds the same path as
+ * best_path on the MRFHypergraph without building one.
+ *
+ * Costs are scale * -potential, plus an extra cost for each (node,
+ * state) such as a lagrange multiplier. States are numbered flat,
+ * state_offset(node) + local index. Message and belief buffers are
+ * allocated once and reused across calls.
+ */
+class MRFTreeSolver {
+ public:
+  MRFTreeSolver(const MRF & mrf);
+
+  /**
+   * Whether the solver is exact on this MRF: every edge goes to a later
+   * node and every node but the last has exactly one out edge.
+   */
+  static bool is_tree(const MRF & mrf);
+
+  // Flat id of a node's first state.
+  int state_offset(int node) const {
+    return _node_start[node];
+  }
+
+  int num_states() const {
+    return _node_start.back();
+  }
+
+  /**
+   * Lowest cost assignment.
+   * @param scale Multiplies the (negated) potentials
+   * @param state_cost Extra cost by flat state id (or empty)
+   * @param assignment Set to the local state of each node, -1 for nodes
+   *                   the best path does not reach
+   * @param primal Set to the cost without state_cost
+   * @return The cost, including state_cost
+   */
+  double solve(double scale, const vector <double> & state_cost,
+               vector <int> * assignment, double * primal);
+
+  /**
+   * Smoothed version of solve, as in HypergraphAlgorithms::soft_marginals.
+   * @param state_marginals Set to the posterior of each flat state
+   * @return The soft-min cost
+   */
+  double marginals(double scale, const vector <double> & state_cost,
+                   double temperature, vector <double> * state_marginals);
+
+ private:
+  const MRF & _mrf;
+  vector <int> _node_start;
+
+  // Messages by edge and to state, at _message_start[edge] + t.
+  vector <int> _message_start;
+  vector <double> _message;
+  vector <bool> _has_message;
+  vector <int> _back_state;
+  vector <int> _back_entry;
+
+  // Beliefs by flat state, outside scores for marginals.
+  vector <double> _belief;
+  vector <double> _outside;
+
+  inline double extra(const vector <double> & state_cost, int state) const {
+    return state_cost.empty() ? 0.0 : state_cost[state];
+  }
+
+  void collect_beliefs(int node, const vector <double> & state_cost);
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include <cpptest.h>
+#include <cpptest-suite.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "MRF.h"
+#include "MRFHypergraph.h"
+#include "MRFTreeSolver.h"
+#include "MRFLoopySolver.h"
+#include "MRFExpansionSolver.h"
+#include "HypergraphAlgorithms.h"
+#include "EdgeCache.h"
+#include "../common.h"
+using namespace Test;
+using namespace std;
+
+static double random_double() {
+  return rand() / (double)RAND_MAX;
+}
+
+// A random MRF. Each node but the last gets an edge to a later node,
+// which makes a tree in the order MRFTreeSolver wants; extra edges
+// then add cycles. Potts groups share state ids and give a bonus to
+// equal ids, and hard ones leave out unequal pairs, as
+// pos_constraints_mrf.py does. Other groups leave out some pairs.
+static graph::Graph * random_mrf(int num_nodes, int max_states, int extra,
+                                 bool potts, bool hard) {
+  graph::Graph * g = new graph::Graph();
+  g->set_label("random");
+  vector <vector <int> > ids(num_nodes);
+  for (int i = 0; i < num_nodes; i++) {
+    graph::Graph_Node * node = g->add_node();
+    node->set_id(i);
+    node->set_label("node");
+    graph::MRFNode * mrf_node = node->MutableExtension(graph::mrf_node);
+    int k = 1 + rand() % max_states;
+    for (int s = 0; s < k; s++) {
+      int id = potts ? s : 2 * s + rand() % 2;
+      ids[i].push_back(id);
+      graph::NodeStatePotential * pot = mrf_node->add_node_potentials();
+      pot->mutable_state()->set_id(id);
+      pot->mutable_state()->set_label("");
+      pot->set_node_potential(random_double() * 4 - 2);
+    }
+  }
+  vector <pair <int, int> > edges;
+  for (int i = 0; i < num_nodes - 1; i++) {
+    edges.push_back(make_pair(i, i + 1 + rand() % (num_nodes - 1 - i)));
+  }
+  for (int e = 0; e < extra; e++) {
+    int a = rand() % num_nodes, b = rand() % num_nodes;
+    if (a != b) edges.push_back(make_pair(min(a, b), max(a, b)));
+  }
+  for (int e = 0; e < edges.size(); e++) {
+    int i = edges[e].first, j = edges[e].second;
+    graph::Graph_Edge * edge = g->mutable_node(i)->add_edge();
+    edge->set_to_node(j);
+    graph::MRFEdge * mrf_edge = edge->MutableExtension(graph::mrf_edge);
+    double bonus = random_double() * 3;
+    foreach (int s1, ids[i]) {
+      foreach (int s2, ids[j]) {
+        bool same = (s1 == s2);
+        if (potts && hard && !same) continue;
+        if (!potts && rand() % 4 == 0) continue;
+        graph::EdgeStatePotential * pot = mrf_edge->add_edge_potentials();
+        pot->set_from_state_id(s1);
+        pot->set_to_state_id(s2);
+        pot->set_edge_potential(
+            potts ? (same ? bonus : 0.0) : random_double() * 10 - 5);
+      }
+    }
+  }
+  return g;
+}
+
+static vector <double> random_state_cost(const MRF & mrf) {
+  vector <double> state_cost(mrf.total_states());
+  for (int state = 0; state < state_cost.size(); state++) {
+    state_cost[state] = random_double() * 2 - 1;
+  }
+  return state_cost;
+}
+
+// Cost of an assignment, as the solvers count it (INF for a pair with
+// no potential).
+static double assignment_cost(const MRF & mrf, double scale,
+                              const vector <double> & state_cost,
+                              const vector <int> & assignment) {
+  double total = 0.0;
+  for (int node = 0; node < assignment.size(); node++) {
+    total += -scale * mrf.node_pot(node, assignment[node]) +
+        state_cost[mrf.state_offset(node) + assignment[node]];
+  }
+  foreach (Edge edge, mrf.graph().edges()) {
+    int entry = mrf.edge_entry(edge->id(),
+                               assignment[edge->from_node()->id()],
+                               assignment[edge->to_node()->id()]);
+    total += (entry == -1) ? INF : -scale * mrf.edge_value(entry);
+  }
+  return total;
+}
+
+// Best cost over all assignments.
+static double brute_force(const MRF & mrf, double scale,
+                          const vector <double> & state_cost) {
+  int num_nodes = mrf.graph().num_nodes();
+  vector <int> assignment(num_nodes, 0);
+  double best = INF;
+  while (true) {
+    best = min(best, assignment_cost(mrf, scale, state_cost, assignment));
+    int node = 0;
+    while (node < num_nodes &&
+           ++assignment[node] == mrf.num_states(node)) {
+      assignment[node] = 0;
+      node++;
+    }
+    if (node == num_nodes) break;
+  }
+  return best;
+}
+
+class MRFTestSuite : public Test::Suite
+{
+public:
+
+  MRFTestSuite() {
+    TEST_ADD(MRFTestSuite::tree_solver_test);
+    TEST_ADD(MRFTestSuite::loopy_bound_test);
+    TEST_ADD(MRFTestSuite::expansion_bound_test);
+  }
+
+private:
+  // MRFTreeSolver against best_path and soft_marginals on the
+  // MRFHypergraph, with the state costs added to the edges into each
+  // state's node. The hypergraph keeps feature values as floats, so
+  // costs only match to single precision.
+  void tree_solver_test() {
+    srand(7);
+    for (int round = 0; round < 200; round++) {
+      double scale = (round % 3 == 0) ? 1.0 : 0.5 + (rand() % 10) / 5.0;
+      char weight_str[64];
+      sprintf(weight_str, "value=%g", scale);
+      wvector * weights = svector_from_str<int, double>(weight_str);
+
+      MRF mrf;
+      mrf.build_from_proto(random_mrf(2 + rand() % 7, 4, 0, false, false));
+      TEST_ASSERT(MRFTreeSolver::is_tree(mrf));
+      MRFTreeSolver solver(mrf);
+      vector <double> state_cost = random_state_cost(mrf);
+
+      MRFHypergraph * hypergraph = MRFHypergraph::from_mrf(mrf);
+      HypergraphAlgorithms algorithms(*hypergraph);
+      EdgeCache * edge_weights = algorithms.cache_edge_weights(*weights);
+      foreach (Node node, mrf.graph().nodes()) {
+        const vector <State> & states = mrf.states(*node);
+        for (int s = 0; s < states.size(); s++) {
+          HNode hnode = hypergraph->node_from_assignment(
+              mrf.make_assignment(*node, states[s]));
+          double cost = state_cost[solver.state_offset(node->id()) + s];
+          foreach (HEdge edge, hnode->edges()) {
+            edge_weights->set_value(*edge,
+                                    edge_weights->get_value(*edge) + cost);
+          }
+        }
+      }
+
+      NodeCache score(hypergraph->num_nodes());
+      NodeBackCache back(hypergraph->num_nodes());
+      double best = algorithms.best_path(*edge_weights, score, back);
+      double best_primal =
+          algorithms.construct_best_feature_vector(back).dot(*weights);
+      vector <int> assignment;
+      double primal;
+      TEST_ASSERT_DELTA(solver.solve(scale, state_cost, &assignment, &primal),
+                        best, 1e-4);
+      TEST_ASSERT_DELTA(primal, best_primal, 1e-4);
+
+      double temperature = 0.5 + random_double();
+      NodeCache node_marginals(hypergraph->num_nodes());
+      EdgeCache edge_marginals(hypergraph->num_edges());
+      double soft = algorithms.soft_marginals(*edge_weights, temperature,
+                                              node_marginals, edge_marginals);
+      vector <double> state_marginals;
+      TEST_ASSERT_DELTA(solver.marginals(scale, state_cost, temperature,
+                                         &state_marginals), soft, 1e-4);
+      foreach (Node node, mrf.graph().nodes()) {
+        const vector <State> & states = mrf.states(*node);
+        for (int s = 0; s < states.size(); s++) {
+          HNode hnode = hypergraph->node_from_assignment(
+              mrf.make_assignment(*node, states[s]));
+          double expected = node_marginals.has_key(*hnode) ?
+              node_marginals.get_value(*hnode) : 0.0;
+          TEST_ASSERT_DELTA(
+              state_marginals[solver.state_offset(node->id()) + s],
+              expected, 1e-4);
+        }
+      }
+      delete edge_weights;
+      delete hypergraph;
+      delete weights;
+    }
+  }
+
+  // The MPLP bound is below the best cost and the decoded assignment
+  // above it; when they meet, both are the best cost.
+  void loopy_bound_test() {
+    srand(11);
+    for (int round = 0; round < 400; round++) {
+      MRF mrf;
+      mrf.build_from_proto(random_mrf(2 + rand() % 6, 3, 1 + rand() % 5,
+                                      round % 2 == 0, false));
+      MRFLoopySolver solver(mrf);
+      vector <double> state_cost = random_state_cost(mrf);
+      double best = brute_force(mrf, 1.0, state_cost);
+      if (best > INF / 2) continue;
+
+      vector <int> assignment;
+      double primal;
+      double bound = solver.solve(1.0, state_cost, &assignment, &primal);
+      TEST_ASSERT(bound <= best + 1e-6);
+      TEST_ASSERT(solver.energy() >= best - 1e-6);
+      TEST_ASSERT_DELTA(solver.energy(),
+                        assignment_cost(mrf, 1.0, state_cost, assignment),
+                        1e-6);
+      if (solver.tight()) {
+        TEST_ASSERT_DELTA(solver.energy(), best, 1e-5);
+      }
+    }
+  }
+
+  // The same for alpha-expansion on soft and hard Potts groups.
+  void expansion_bound_test() {
+    srand(5);
+    for (int round = 0; round < 400; round++) {
+      MRF mrf;
+      mrf.build_from_proto(random_mrf(2 + rand() % 6, 3, 1 + rand() % 5,
+                                      true, round % 2 == 1));
+      TEST_ASSERT(MRFExpansionSolver::is_potts(mrf, 1.0));
+      MRFExpansionSolver solver(mrf);
+      vector <double> state_cost = random_state_cost(mrf);
+      double best = brute_force(mrf, 1.0, state_cost);
+      if (best > INF / 2) continue;
+
+      vector <int> assignment;
+      double primal;
+      double bound = solver.solve(1.0, state_cost, &assignment, &primal);
+      TEST_ASSERT(bound <= best + 1e-6);
+      TEST_ASSERT(solver.energy() >= best - 1e-6);
+      TEST_ASSERT_DELTA(solver.energy(),
+                        assignment_cost(mrf, 1.0, state_cost, assignment),
+                        1e-6);
+      if (solver.tight()) {
+        TEST_ASSERT_DELTA(solver.energy(), best, 1e-5);
+      }
+    }
+  }
+};
+
+
+int main(int argc, const char * argv[]) {
+  Test::TextOutput output(Test::TextOutput::Verbose);
+  MRFTestSuite mts;
+  return mts.run(output) ? 0 : 1;
+}
@@ -5,27 +5,67 @@ void CorpusSolver::solve(const SubgradState & info,
   
   cout << "Round " << info.round;
 
-  result.dual =0;
-  result.primal = 0;
+  // A new temperature changes every smoothed result.
+  if (info.smoothing != _temperature) {
+    _temperature = info.smoothing;
+    for (int sent_num =0; sent_num < _corpus_size;sent_num++) {
+      _dirty_cache[sent_num] = true;
+    }
+  }
+
+  vector <int> dirty;
   for (int sent_num =0; sent_num < _corpus_size;sent_num++) {
     if (_dirty_cache[sent_num]) {
-      double local_dual, local_primal;
-      wvector  local_subgrad;
-      solve_one(sent_num, local_dual, local_primal, local_subgrad);
-      _subgrad_cache[sent_num] = local_subgrad;
-      _primal_cache[sent_num] = local_primal;
-      _dual_cache[sent_num] = local_dual;
-      _dirty_cache[sent_num] = false;
+      dirty.push_back(sent_num);
     }
+  }
+  set_up_scratch(_pool->num_threads());
+  _pool->run(*this, dirty);
+  foreach (int sent_num, dirty) {
+    _dirty_cache[sent_num] = false;
+    show_one(sent_num);
+  }
+
+  // Reduce in sentence order so the result does not depend on 
+  // how the sentences were scheduled.
+  result.dual =0;
+  result.primal = 0;
+  result.has_smooth = _temperature > 0.0;
+  result.dirty = dirty.size();
+  for (int sent_num =0; sent_num < _corpus_size;sent_num++) {
     result.subgrad += _subgrad_cache[sent_num];
     result.dual += _dual_cache[sent_num];
     result.primal += _primal_cache[sent_num];
+    if (result.has_smooth && _smooth_ok_cache[sent_num]) {
+      result.smooth_grad += _smooth_grad_cache[sent_num];
+      result.smooth_dual += _smooth_dual_cache[sent_num];
+    } else {
+      result.has_smooth = false;
+    }
   }
   cout << "Corpus dual: " << result.dual << endl;
   cout << "Corpus primal: " << result.primal << endl;
 
 }
 
+void CorpusSolver::run_item(int sent_num, int thread_id) {
+  double local_dual = 0.0, local_primal = 0.0;
+  wvector  local_subgrad;
+  solve_one(sent_num, thread_id, local_dual, local_primal, local_subgrad);
+  _subgrad_cache[sent_num] = local_subgrad;
+  _primal_cache[sent_num] = local_primal;
+  _dual_cache[sent_num] = local_dual;
+
+  if (_temperature > 0.0) {
+    double smooth_dual = 0.0;
+    wvector smooth_grad;
+    _smooth_ok_cache[sent_num] = 
+      solve_one_smooth(sent_num, thread_id, _temperature, smooth_dual, smooth_grad);
+    _smooth_grad_cache[sent_num] = smooth_grad;
+    _smooth_dual_cache[sent_num] = smooth_dual;
+  }
+}
+
 
 //       if (round == 100) {
 //         cout << endl;
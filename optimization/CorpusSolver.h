@@ -3,25 +3,77 @@
 
 
 #include "DualDecomposition.h"
+#include "ThreadPool.h"
 #include "Weights.h"
 
-class CorpusSolver:public DualDecompositionSubproblem {
+class CorpusSolver:public DualDecompositionSubproblem, public ParallelTask {
  public:
  CorpusSolver(int corpus_size):_corpus_size(corpus_size) {
     _cur_weights = new wvector();
+    _pool = new ThreadPool(1);
+    _temperature = 0.0;
     _dirty_cache.resize(corpus_size);
     _subgrad_cache.resize(corpus_size);
     _dual_cache.resize(corpus_size);
     _primal_cache.resize(corpus_size);
+    _smooth_ok_cache.resize(corpus_size);
+    _smooth_grad_cache.resize(corpus_size);
+    _smooth_dual_cache.resize(corpus_size);
     for (int i = 0; i < corpus_size; i++) {
       _dirty_cache[i] = true;
     }
   }
 
-  virtual void solve_one(int sent_num, double & dual, double & primal, wvector & subgrad) = 0; 
+  ~CorpusSolver() {
+    delete _pool;
+  }
+
+  /** 
+   * Solve a single sentence. May be called from several threads at
+   * once (on different sentences), so implementations should only
+   * read shared state and write to their own sentence's slots, or to
+   * the scratch of thread_id (see set_up_scratch).
+   */
+  virtual void solve_one(int sent_num, int thread_id, double & dual, double & primal, wvector & subgrad) = 0; 
+
+  /** 
+   * Smoothed version of solve_one at the given temperature 
+   * (see SubgradState::smoothing). Same threading rules as solve_one.
+   * 
+   * @return False if smoothing is not supported
+   */
+  virtual bool solve_one_smooth(int sent_num, int thread_id, double temperature, 
+                                double & smooth_dual, wvector & smooth_grad) {
+    return false;
+  }
+
+  /** 
+   * Make room for per-thread scratch, kept between rounds. Called
+   * before each round; thread ids are below num_threads.
+   */
+  virtual void set_up_scratch(int num_threads) {}
+
+  /** 
+   * Print what solve_one found for a sentence. Called after each round,
+   * in sentence order, for the sentences it re-solved, so output from
+   * different threads does not interleave.
+   */
+  virtual void show_one(int sent_num) const {}
   
   void solve(const SubgradState & info,
              SubgradResult & result);
+
+  /** 
+   * Solve dirty sentences on a pool of threads.
+   * 
+   * @param num_threads Number of threads (1 is serial)
+   */
+  void set_num_threads(int num_threads) {
+    delete _pool;
+    _pool = new ThreadPool(num_threads);
+  }
+
+  void run_item(int sent_num, int thread_id);
   
   void update_weights(const wvector & updates,  
                       wvector * weights, 
@@ -48,12 +100,26 @@ class CorpusSolver:public DualDecompositionSubproblem {
   }
  protected:
   virtual int lag_to_sent_num(int lag) = 0;
+
+  // Thread-safe lookup of the current dual value for lag
+  double cur_weight(int lag) const {
+    return svector_getitem(*_cur_weights, lag);
+  }
+
   wvector * _cur_weights;
   vector <wvector> _subgrad_cache;
   vector <double> _primal_cache;
   vector <double> _dual_cache;
   vector <bool> _dirty_cache;  
+
+  // Smoothed results, only used when _temperature > 0.0
+  double _temperature;
+  vector <int> _smooth_ok_cache;
+  vector <wvector> _smooth_grad_cache;
+  vector <double> _smooth_dual_cache;
+
   int _corpus_size;
+  ThreadPool * _pool;
 };
 
 
@@ -1,28 +1,77 @@
 #include "DualDecomposition.h"
 #include <time.h>
+#include <assert.h>
+
+DualDecompositionRunner::DualDecompositionRunner(DualDecompositionSubproblem & s1, 
+                                                 DualDecompositionSubproblem & s2 ) {
+  _subproblems.push_back(&s1);
+  _subproblems.push_back(&s2);
+  _mults.push_back(1.0);
+  _mults.push_back(-1.0);
+  _pool = new ThreadPool(1);
+}
+
+DualDecompositionRunner::DualDecompositionRunner(const vector <DualDecompositionSubproblem *> & subproblems,
+                                                 const vector <double> & mults): 
+  _subproblems(subproblems), _mults(mults) {
+  assert(_subproblems.size() == _mults.size());
+  _pool = new ThreadPool(1);
+}
+
+void DualDecompositionRunner::set_concurrent(bool concurrent) {
+  delete _pool;
+  _pool = new ThreadPool(concurrent ? _subproblems.size() : 1);
+}
+
+void DualDecompositionRunner::run_item(int sub, int thread_id) {
+  double start = Clock::wall_ms();
+  double cpu_start = Clock::thread_cpu_ms();
+  _subproblems[sub]->solve(*_info, _results[sub]);
+  _times[sub] = Clock::wall_ms() - start;
+  _cpu_times[sub] = Clock::thread_cpu_ms() - cpu_start;
+}
 
 void DualDecompositionRunner::solve(const SubgradState & info, SubgradResult & result) { 
-  SubgradResult result1, result2;
-  clock_t start=clock();
-  _sub_producer1.solve(info, result1);
-  clock_t end=clock();
-  cout << "First subproblem"<< double(Clock::diffclock(end,start)) << endl;
-
-  start=clock();
-  _sub_producer2.solve(info, result2);
-  end=clock();
-  cout << "Second subproblem"<< double(Clock::diffclock(end,start)) << endl;
-  
-  result.subgrad = result1.subgrad - result2.subgrad;
-  result.dual = result1.dual + result2.dual;
-  result.primal = result1.primal + result2.primal;
+  _info = &info;
+  _results.clear();
+  _results.resize(_subproblems.size());
+  _times.resize(_subproblems.size());
+  _cpu_times.resize(_subproblems.size());
+
+  _pool->run(*this, _subproblems.size());
+
+  result.dual = 0.0;
+  result.primal = 0.0;
+  result.has_smooth = true;
+  result.dual_exact = true;
+  result.dirty = 0;
+  for (unsigned int i = 0; i < _subproblems.size(); i++) {
+    cout << "Subproblem " << i << " " << _times[i] << endl;
+    result.subgrad += _mults[i] * _results[i].subgrad;
+    result.dual += _results[i].dual;
+    result.primal += _results[i].primal;
+    result.dual_exact = result.dual_exact && _results[i].dual_exact;
+    if (_results[i].has_smooth) {
+      result.smooth_grad += _mults[i] * _results[i].smooth_grad;
+      result.smooth_dual += _results[i].smooth_dual;
+    } else {
+      result.has_smooth = false;
+    }
+    if (_results[i].dirty < 0 || result.dirty < 0) {
+      result.dirty = -1;
+    } else {
+      result.dirty += _results[i].dirty;
+    }
+  }
+  result.subproblem_wall_ms = _times;
+  result.subproblem_cpu_ms = _cpu_times;
 }
 
 void DualDecompositionRunner::update_weights(const wvector & updates,  
                     wvector * weights) {
-
-_sub_producer1.update_weights(updates, weights, 1.0);
-_sub_producer2.update_weights(updates, weights, -1.0);
+  for (unsigned int i = 0; i < _subproblems.size(); i++) {
+    _subproblems[i]->update_weights(updates, weights, _mults[i]);
+  }
 }
 
 
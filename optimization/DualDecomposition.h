@@ -9,6 +9,7 @@
 #define DUALDECOMPOSITION_H
 #include <iostream>
 #include "Subgradient.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
@@ -48,36 +49,83 @@ class DualDecompositionSubproblem {
 
 
 /** 
- * Internal wrapper class to run two subproblem dual decomposition
- * as a subgradient optimization problem. 
+ * Internal wrapper class to run dual decomposition over several
+ * subproblems as a subgradient optimization problem. Each subproblem
+ * has a multiplier; it sees mult * weights as its dual penalty and
+ * the subgradient is the mult weighted sum of subproblem subgradients.
+ * The standard two problem setup is (1.0, -1.0). 
  * 
  */
 
-class DualDecompositionRunner : public SubgradientProducer{
+class DualDecompositionRunner : public SubgradientProducer, public ParallelTask {
  public:
 
 
- DualDecompositionRunner(DualDecompositionSubproblem & s1, DualDecompositionSubproblem & s2 ):
-  _sub_producer1(s1), _sub_producer2(s2) {}
+  DualDecompositionRunner(DualDecompositionSubproblem & s1, DualDecompositionSubproblem & s2 );
 
+  DualDecompositionRunner(const vector <DualDecompositionSubproblem *> & subproblems,
+                          const vector <double> & mults);
+
+  ~DualDecompositionRunner() {
+    delete _pool;
+  }
   
   void solve(const SubgradState & info, SubgradResult & result);
   
   void update_weights(const wvector & updates,  
                       wvector * weights);
-  
-  DualDecompositionSubproblem & _sub_producer1;
-  DualDecompositionSubproblem & _sub_producer2;
+
+  /** 
+   * Solve the subproblems at the same time, each on its own thread. 
+   * Only safe if the subproblems do not share mutable state.
+   */
+  void set_concurrent(bool concurrent);
+
+  /** 
+   * Wall time (ms) of each subproblem in the last round.
+   */
+  const vector <double> & subproblem_times() const {
+    return _times;
+  }
+
+  /** 
+   * Thread cpu time (ms) of each subproblem in the last round.
+   */
+  const vector <double> & subproblem_cpu_times() const {
+    return _cpu_times;
+  }
+
+  int num_subproblems() const {
+    return _subproblems.size();
+  }
+
+  void run_item(int sub, int thread_id);
+
+ private:
+  vector <DualDecompositionSubproblem *> _subproblems;
+  vector <double> _mults;
+
+  // Per round scratch
+  const SubgradState * _info;
+  vector <SubgradResult> _results;
+  vector <double> _times;
+  vector <double> _cpu_times;
+
+  ThreadPool * _pool;
 };
 
 
 /** 
  * Dual Decomposition Manager. 
- * Call with two subproblems runs dual decomposition
+ * Call with two (or more) subproblems runs dual decomposition
  * 
  */
 
 class DualDecomposition {
+ private:
+  // Built before subgradsolver, which keeps a reference to it.
+  DualDecompositionRunner _runner;
+
  public:
 
   DualDecomposition(DualDecompositionSubproblem & s1, 
@@ -87,6 +135,35 @@ class DualDecomposition {
   _runner(s1, s2), 
     subgradsolver(_runner, rate){}
 
+  /** 
+   * Multi-way decomposition. For instance tagger (1.0), 
+   * parser (1.0) and a constraint mrf (-1.0) aligned to both, 
+   * where the tagger and parser use disjoint lagrangian indices.
+   */
+  DualDecomposition(const vector <DualDecompositionSubproblem *> & subproblems, 
+                    const vector <double> & mults,
+                    SubgradRate & rate
+                    ): 
+  _runner(subproblems, mults), 
+    subgradsolver(_runner, rate){}
+
+  /** 
+   * Use a DualOptimizer (see DualOptimizers.h) instead of a rate. 
+   */
+  DualDecomposition(DualDecompositionSubproblem & s1, 
+                    DualDecompositionSubproblem & s2,
+                    DualOptimizer & optimizer
+                    ): 
+  _runner(s1, s2), 
+    subgradsolver(_runner, optimizer){}
+
+  DualDecomposition(const vector <DualDecompositionSubproblem *> & subproblems, 
+                    const vector <double> & mults,
+                    DualOptimizer & optimizer
+                    ): 
+  _runner(subproblems, mults), 
+    subgradsolver(_runner, optimizer){}
+
   /** 
    * Solve the subgradient problem
    * 
@@ -96,10 +173,11 @@ class DualDecomposition {
     subgradsolver.solve(example);
   }
 
-  Subgradient subgradsolver;
+  void set_concurrent(bool concurrent) {
+    _runner.set_concurrent(concurrent);
+  }
 
- private:  
-  DualDecompositionRunner _runner;
+  Subgradient subgradsolver;
 };
 
 
@@ -0,0 +1,225 @@
+#include "DualOptimizers.h"
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include "../common.h"
+using namespace std;
+
+// Euclidean projection onto the probability simplex.
+static void project_simplex(vector <double> & x) {
+  vector <double> sorted(x);
+  sort(sorted.begin(), sorted.end());
+  reverse(sorted.begin(), sorted.end());
+  double total = 0.0, tau = 0.0;
+  for (unsigned int i = 0; i < sorted.size(); i++) {
+    total += sorted[i];
+    double t = (total - 1.0) / (i + 1);
+    if (sorted[i] - t > 0.0) {
+      tau = t;
+    }
+  }
+  for (unsigned int i = 0; i < x.size(); i++) {
+    x[i] = max(x[i] - tau, 0.0);
+  }
+}
+
+BundleOptimizer::BundleOptimizer(double mu, int max_bundle):
+  _center_value(0.0), _predicted(0.0), _has_center(false),
+  _mu(mu), _max_bundle(max_bundle), _tolerance(1e-6), _converged(false) {}
+
+void BundleOptimizer::move_center(const wvector & delta) {
+  for (unsigned int j = 0; j < _bundle.size(); j++) {
+    _bundle[j].a += _bundle[j].g.dot(delta);
+  }
+}
+
+// Solve the dual of the master problem
+//   min_{theta in simplex} theta . a + |G theta|^2 / (2 mu)
+// by projected gradient. The bundle is small, so this is cheap
+// compared to a call to the client.
+void BundleOptimizer::solve_master(vector <double> & theta) const {
+  int k = _bundle.size();
+  vector <vector <double> > gram(k, vector <double>(k));
+  double lipschitz = 0.0;
+  for (int i = 0; i < k; i++) {
+    for (int j = 0; j <= i; j++) {
+      gram[i][j] = gram[j][i] = _bundle[i].g.dot(_bundle[j].g);
+    }
+  }
+  for (int i = 0; i < k; i++) {
+    double row = 0.0;
+    for (int j = 0; j < k; j++) {
+      row += fabs(gram[i][j]);
+    }
+    lipschitz = max(lipschitz, row / _mu);
+  }
+  double step = 1.0 / max(lipschitz, 1e-12);
+  project_simplex(theta);
+
+  vector <double> grad(k);
+  for (int iter = 0; iter < 500; iter++) {
+    for (int i = 0; i < k; i++) {
+      grad[i] = _bundle[i].a;
+      for (int j = 0; j < k; j++) {
+        grad[i] += gram[i][j] * theta[j] / _mu;
+      }
+    }
+    vector <double> next(k);
+    double change = 0.0;
+    for (int i = 0; i < k; i++) {
+      next[i] = theta[i] - step * grad[i];
+    }
+    project_simplex(next);
+    for (int i = 0; i < k; i++) {
+      change += fabs(next[i] - theta[i]);
+    }
+    theta = next;
+    if (change < 1e-10) break;
+  }
+}
+
+// Keep the bundle small. Inactive cuts go first, if that is not
+// enough the old cuts are folded into a single aggregate cut.
+bool BundleOptimizer::compress(const vector <double> & theta) {
+  if ((int)_bundle.size() <= _max_bundle) return false;
+  int newest = _bundle.size() - 1;
+  vector <Cut> kept;
+  vector <double> kept_theta;
+  for (int j = 0; j < newest; j++) {
+    if (theta[j] > 1e-12) {
+      kept.push_back(_bundle[j]);
+      kept_theta.push_back(theta[j]);
+    }
+  }
+  if ((int)kept.size() + 1 > _max_bundle) {
+    Cut agg;
+    agg.a = 0.0;
+    double total = 0.0;
+    for (unsigned int j = 0; j < kept.size(); j++) {
+      agg.a += kept_theta[j] * kept[j].a;
+      agg.g += kept_theta[j] * kept[j].g;
+      total += kept_theta[j];
+    }
+    agg.a /= total;
+    agg.g /= total;
+    kept.clear();
+    kept.push_back(agg);
+  }
+  kept.push_back(_bundle[newest]);
+  _bundle = kept;
+  return true;
+}
+
+wvector BundleOptimizer::next_update(const wvector & weights,
+                                     const SubgradResult & result,
+                                     int round) {
+  const wvector & g = result.subgrad;
+  double value = result.dual;
+
+  // Offset of the point we are at now from the center.
+  wvector at = _candidate;
+  bool first = !_has_center;
+  if (first) {
+    _has_center = true;
+    _center_value = value;
+    at = wvector();
+    if (_mu <= 0.0) {
+      double gap = fabs(result.primal - result.dual);
+      _mu = g.normsquared() / max(gap, 1e-3);
+    }
+  }
+
+  Cut cut;
+  cut.a = value - g.dot(at);
+  cut.g = g;
+  _bundle.push_back(cut);
+
+  if (!first) {
+    double ratio = (value - _center_value) / _predicted;
+    if (ratio >= 0.1) {
+      // Serious step. If the model was close, trust it further.
+      move_center(at);
+      _center_value = value;
+      at = wvector();
+      _mu *= (ratio > 0.9) ? 0.25 : 0.8;
+    } else {
+      _mu *= 1.5;
+    }
+  }
+
+  // Warm start from the last multipliers unless the bundle changed.
+  vector <double> theta(_last_theta);
+  if (compress(_last_theta) || theta.size() + 1 != _bundle.size()) {
+    theta.assign(_bundle.size(), 1.0 / _bundle.size());
+  } else {
+    theta.push_back(0.0);
+  }
+  solve_master(theta);
+  _last_theta = theta;
+
+  wvector direction;
+  double model = 0.0;
+  for (unsigned int j = 0; j < _bundle.size(); j++) {
+    if (theta[j] == 0.0) continue;
+    direction += theta[j] * _bundle[j].g;
+    model += theta[j] * _bundle[j].a;
+  }
+  model += direction.normsquared() / _mu;
+  direction /= _mu;
+
+  _predicted = model - _center_value;
+  _converged = _predicted < _tolerance * (1.0 + fabs(_center_value));
+
+  _candidate = direction;
+  return direction - at;
+}
+
+NesterovOptimizer::NesterovOptimizer(double temperature, double step_scale,
+                                     double decay, double min_temperature):
+  _t(1.0), _last_value(0.0), _first(true),
+  _temperature(temperature), _step_scale(step_scale),
+  _decay(decay), _min_temperature(min_temperature) {}
+
+wvector NesterovOptimizer::next_update(const wvector & weights,
+                                       const SubgradResult & result,
+                                       int round) {
+  const wvector & g = result.has_smooth ? result.smooth_grad : result.subgrad;
+  double value = result.has_smooth ? result.smooth_dual : result.dual;
+
+  if (_first) {
+    _lambda = weights;
+    _first = false;
+  } else if (value < _last_value) {
+    // Adaptive restart, drop the momentum.
+    _t = 1.0;
+  }
+  _last_value = value;
+
+  double step = _step_scale;
+  if (_temperature > 0.0) {
+    step *= _temperature;
+  }
+
+  wvector lambda_next = weights + step * g;
+  double t_next = (1.0 + sqrt(1.0 + 4.0 * _t * _t)) / 2.0;
+  wvector y_next = lambda_next + ((_t - 1.0) / t_next) * (lambda_next - _lambda);
+  _lambda = lambda_next;
+  _t = t_next;
+
+  _temperature = max(_min_temperature, _temperature * _decay);
+  return y_next - weights;
+}
+
+DualOptimizer * dual_optimizer_from_name(const string & name,
+                                         double temperature,
+                                         double step_scale) {
+  if (name == "bundle") {
+    return new BundleOptimizer();
+  } else if (name == "nesterov") {
+    return new NesterovOptimizer(temperature, step_scale, 0.95, 
+                                 temperature / 100.0);
+  } else if (name != "subgradient") {
+    cerr << "Bad dual optimizer arg " << name << endl;
+  }
+  return NULL;
+}
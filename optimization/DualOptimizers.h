@@ -0,0 +1,107 @@
+#ifndef DUALOPTIMIZERS_H_
+#define DUALOPTIMIZERS_H_
+
+#include "Subgradient.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Proximal bundle method for the (concave) dual. Keeps a bundle of
+ * cutting planes from past subgradients and moves to the maximizer of
+ * the cutting plane model minus a proximal term around the stability
+ * center. The center only moves when the real dual makes enough of
+ * the predicted progress (serious step), otherwise the new cut
+ * improves the model (null step).
+ */
+class BundleOptimizer : public DualOptimizer {
+ public:
+  /**
+   * @param mu Initial proximal weight (<= 0 picks one from the first round)
+   * @param max_bundle Number of cuts to keep
+   */
+  BundleOptimizer(double mu = -1.0, int max_bundle = 20);
+
+  wvector next_update(const wvector & weights,
+                      const SubgradResult & result,
+                      int round);
+
+  bool converged() const {
+    return _converged;
+  }
+
+  void set_tolerance(double tol) { _tolerance = tol; }
+
+ private:
+  // A cut is a_j + g_j . (lambda - center)
+  struct Cut {
+    double a;
+    wvector g;
+  };
+
+  void solve_master(vector <double> & theta) const;
+  bool compress(const vector <double> & theta);
+  void move_center(const wvector & delta);
+
+  vector <Cut> _bundle;
+  vector <double> _last_theta;
+
+  // Offset from the center to the current candidate.
+  wvector _candidate;
+  double _center_value;
+  double _predicted;
+  bool _has_center;
+
+  double _mu;
+  int _max_bundle;
+  double _tolerance;
+  bool _converged;
+};
+
+/**
+ * Nesterov accelerated dual ascent (FISTA) on the smoothed dual.
+ * Asks the client for soft-min subproblems at temperature T and steps
+ * along the expected subgradient with step T * step_scale, restarting
+ * the momentum when the smoothed dual goes down. The temperature
+ * decays every round down to min_temperature. Clients that do not
+ * support smoothing give an accelerated subgradient method.
+ */
+class NesterovOptimizer : public DualOptimizer {
+ public:
+  NesterovOptimizer(double temperature, double step_scale,
+                    double decay = 1.0, double min_temperature = 0.0);
+
+  wvector next_update(const wvector & weights,
+                      const SubgradResult & result,
+                      int round);
+
+  double smoothing() const {
+    return _temperature;
+  }
+
+ private:
+  // Last ascent iterate, the evaluation point is extrapolated from it.
+  wvector _lambda;
+  double _t;
+  double _last_value;
+  bool _first;
+
+  double _temperature;
+  double _step_scale;
+  double _decay;
+  double _min_temperature;
+};
+
+/**
+ * Build an optimizer from its command line name, "bundle" or
+ * "nesterov". Returns NULL for "subgradient", in which case the
+ * caller should use its usual step rate.
+ *
+ * @param temperature Starting smoothing temperature (nesterov only)
+ * @param step_scale Step size multiplier (nesterov only)
+ */
+DualOptimizer * dual_optimizer_from_name(const string & name,
+                                         double temperature,
+                                         double step_scale);
+
+#endif
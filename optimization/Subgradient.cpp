@@ -1,5 +1,6 @@
 
 #include "Subgradient.h"
+#include "Telemetry.h"
 #include "math.h"
 #include <iostream>
 #include <iomanip>
@@ -19,13 +20,80 @@ void print_vec(const wvector & subgrad) {
 }
 
 void Subgradient::solve(int example) {
-  while(run_one_round() && _round < _max_round) {
+  _solve_wall_start = Clock::wall_ms();
+  _solve_cpu_start = clock();
+  _certificate = false;
+  _example = example;
+  _status = "max_rounds";
+  while(run_one_round()) {
+    if (_round >= _max_round) break;
+    if (past_deadline()) {
+      cerr << "Out of time" << endl;
+      _status = "deadline";
+      break;
+    }
     _round++;
   }
+  cout << "SOLVE " << example << " rounds " << _round 
+       << " certificate " << _certificate 
+       << " status " << _status
+       << " gap " << gap()
+       << " wall " << Clock::wall_ms() - _solve_wall_start << endl;
+  record_summary();
+}
+
+bool Subgradient::past_deadline() const {
+  double now = Clock::wall_ms();
+  if (_time_limit > 0.0 && now - _solve_wall_start >= _time_limit) {
+    return true;
+  }
+  return _deadline > 0.0 && now >= _deadline;
+}
+
+void Subgradient::record_round(const SubgradResult & result, 
+                               double wall_ms, double cpu_ms) {
+  if (_telemetry == NULL) return;
+  RoundRecord record;
+  record.example = _example;
+  record.round = _round;
+  record.dual = result.dual;
+  record.primal = result.primal;
+  record.best_dual = _best_dual;
+  record.best_primal = _best_primal;
+  record.gap = fabs(_best_primal - _best_dual);
+  record.alpha = _last_alpha;
+  record.subgrad_nnz = 0;
+  for (wvector::const_iterator it = result.subgrad.begin(); 
+       it != result.subgrad.end(); it++) {
+    if (it->second != 0.0) {
+      record.subgrad_nnz++;
+    }
+  }
+  record.dirty = result.dirty;
+  record.wall_ms = wall_ms;
+  record.cpu_ms = cpu_ms;
+  record.subproblem_wall_ms = result.subproblem_wall_ms;
+  record.subproblem_cpu_ms = result.subproblem_cpu_ms;
+  _telemetry->round(record);
+}
+
+void Subgradient::record_summary() {
+  if (_telemetry == NULL) return;
+  ExampleSummary summary;
+  summary.example = _example;
+  summary.rounds = _round;
+  summary.status = _status;
+  summary.best_dual = _best_dual;
+  summary.best_primal = _best_primal;
+  summary.gap = fabs(_best_primal - _best_dual);
+  summary.wall_ms = Clock::wall_ms() - _solve_wall_start;
+  summary.cpu_ms = Clock::diffclock(clock(), _solve_cpu_start);
+  _telemetry->summary(summary);
 }
 
 bool Subgradient::run_one_round() {
   clock_t start=clock();
+  double wall_start = Clock::wall_ms();
   // bool bump =false;
   // bool no_update = false;
   SubgradResult result;
@@ -34,12 +102,13 @@ bool Subgradient::run_one_round() {
   info.is_stuck = _is_stuck;
   info.best_primal = _best_primal;
   info.best_dual = _best_dual;
+  if (_optimizer != NULL) {
+    info.smoothing = _optimizer->smoothing();
+  }
   _s.solve(info, result); //  primal, dual, subgrad, _round, _is_stuck, bump,no_update);
 
-  clock_t end;
   if (TIMING) {
-    end=clock();
-    cout << "JUST UPDATE "<< double(Clock::diffclock(end,start)) << endl;
+    cout << "JUST UPDATE "<< Clock::wall_ms() - wall_start << endl;
   }
 
 
@@ -68,15 +137,43 @@ bool Subgradient::run_one_round() {
 
 
   if (result.subgrad.normsquared() > 0.0) {
-    update_weights(result.subgrad, result.bump_rate);
+    if (_optimizer != NULL) {
+      wvector updates = _optimizer->next_update(_weights, result, _round);
+      if (_optimizer->converged()) {
+        cerr << "Optimizer converged" << endl;
+        _status = "converged";
+        record_round(result, Clock::wall_ms() - wall_start, 
+                     Clock::diffclock(clock(), start));
+        return false;
+      }
+      _weights += updates;
+      _s.update_weights(updates, &_weights);
+    } else {
+      update_weights(result.subgrad, result.bump_rate);
+    }
+    record_round(result, Clock::wall_ms() - wall_start, 
+                 Clock::diffclock(clock(), start));
     return true;
   } else {
-    if (fabs(result.dual - result.primal) > 1e-4) {
+    record_round(result, Clock::wall_ms() - wall_start, 
+                 Clock::diffclock(clock(), start));
+    if (fabs(result.dual - result.primal) <= 1e-4) {
+      cerr << "Found best" << endl;
+      _certificate = true;
+      _status = "certificate";
+    } else if (!result.dual_exact) {
+      // Nothing moves, but the relaxed bound doesn't certify the primal.
+      cerr << "Agreement without certificate, gap " 
+           << result.primal - result.dual << endl;
+      _status = "converged";
+    } else {
       cerr << result.dual << " " << result.primal << endl;
       cerr << "FAILURE" << endl;
-      exit(1);
-    } else {
-      cerr << "Found best" << endl;
+      _status = "failure";
+      if (_exit_on_failure) {
+        record_summary();
+        exit(1);
+      }
     }
     return false;
   }
@@ -99,10 +196,10 @@ void Subgradient::update_weights(wvector &subgrad, bool bump) {
   if (bump) {
     _aggressive = true;
     //rate->_base_weight *=10.0;
-    _rate.bump();
+    _rate->bump();
   }
 
-  double alpha = _rate.get_alpha(_duals, _primals, subgrad,
+  double alpha = _rate->get_alpha(_duals, _primals, subgrad,
                                  size, _aggressive, _is_stuck);
   _last_alpha = alpha;
   svector<int, double> updates = alpha * subgrad;
@@ -2,12 +2,16 @@
 #define SUBGRADIENT_H_
 
 #include "svector.hpp"
+#include <math.h>
+#include <string>
 #include <vector>
 #include <../common.h>
 using namespace std;
 
 typedef svector<int, double> wvector;
 
+class TelemetrySink;
+
 class SubgradRate {
  public:
   virtual double get_alpha(vector <double> & duals,
@@ -19,6 +23,7 @@ class SubgradRate {
 
 // Input to the subgradient client
 struct SubgradState {
+ SubgradState(): smoothing(0.0) {}
   // The current round of the subgradient algorithm
   int round;
   // ignore for now
@@ -27,10 +32,16 @@ struct SubgradState {
 
   double best_primal;
   double best_dual;
+
+  // Temperature for smoothed (soft-min) subproblems, 0.0 for none.
+  // Clients that do not support smoothing can ignore it.
+  double smoothing;
 };
 
 // Output of the subgradient client
 struct SubgradResult {
+ SubgradResult(): bump_rate(false), dual_exact(true), has_smooth(false), 
+    smooth_dual(0.0), dirty(-1) {}
   // The primal value (score of the resulting structure)
   double primal;
   // The dual value (score of the resulting structure with dual penalties)
@@ -39,6 +50,25 @@ struct SubgradResult {
   wvector subgrad;
   // ignore
   bool bump_rate;
+
+  // False if dual is a lower bound that may be below the exact dual,
+  // for instance from an LP relaxation of a subproblem. The primal and
+  // dual can then differ when the subproblems agree.
+  bool dual_exact;
+
+  // Only filled when smoothing > 0.0 and the client supports it.
+  // The smoothed dual (a lower bound on dual) and its gradient
+  // (the expected subgradient under the soft-min distribution).
+  bool has_smooth;
+  double smooth_dual;
+  wvector smooth_grad;
+
+  // Optional, for telemetry. Number of subproblems (sentences,
+  // groups) re-solved this round, -1 if unknown.
+  int dirty;
+  // Wall and thread cpu time (ms) of each subproblem.
+  vector <double> subproblem_wall_ms;
+  vector <double> subproblem_cpu_ms;
 };
 
 
@@ -56,6 +86,32 @@ class SubgradientProducer {
 };
 
 
+/**
+ * Interface for dual optimizers that choose the next dual point
+ * themselves instead of taking a subgradient step of size alpha
+ * (see DualOptimizers.h).
+ */
+class DualOptimizer {
+ public:
+  virtual ~DualOptimizer() {}
+
+  /**
+   * @param weights The current dual weights (where result was computed)
+   * @param result The client output at weights
+   * @param round The current round
+   * @return The change to make to the dual weights
+   */
+  virtual wvector next_update(const wvector & weights,
+                              const SubgradResult & result,
+                              int round) = 0;
+
+  // Smoothing temperature to pass to the client this round.
+  virtual double smoothing() const { return 0.0; }
+
+  // True if the optimizer can prove it is at the dual optimum.
+  virtual bool converged() const { return false; }
+};
+
 /**
  * Subgradient optimization manager. Takes an object to produce
  * subgradients given current dual values as well as an object
@@ -72,21 +128,54 @@ class Subgradient {
  Subgradient(SubgradientProducer & subgrad_producer,
              SubgradRate & update_rate ):
   _s(subgrad_producer),
-  _rate(update_rate){
-    _best_dual = -1e20;
-    _best_primal = 1e20;
-    _round = 1;
-    _nround = 1;
-    _is_stuck = false;
-    _first_stuck_iteration = -1;
-    _aggressive = false;
-    _debug = false;
-    _max_round = 200;
+  _rate(&update_rate),
+  _optimizer(NULL) {
+    init();
+  } ;
+
+  /**
+   * @param subgrad_producer Gives the subgradient at the current position
+   * @param optimizer Chooses the next dual position
+   */
+ Subgradient(SubgradientProducer & subgrad_producer,
+             DualOptimizer & optimizer ):
+  _s(subgrad_producer),
+  _rate(NULL),
+  _optimizer(&optimizer) {
+    init();
   } ;
 
   void set_debug(){ _debug = true;}
   void set_max_rounds(int max_round){ _max_round = max_round; }
 
+  /**
+   * Send per round records and a per example summary to sink.
+   * The sink is not owned.
+   */
+  void set_telemetry(TelemetrySink * sink) { _telemetry = sink; }
+
+  /**
+   * Wall clock budget (ms) for each call to solve, 0 for none.
+   * The current round always finishes, so the budget can be
+   * overrun by up to one round.
+   */
+  void set_time_limit(double ms) { _time_limit = ms; }
+
+  /**
+   * Absolute wall clock deadline (as Clock::wall_ms), 0 for none.
+   * Used for a budget shared over many examples.
+   */
+  void set_deadline(double wall_ms) { _deadline = wall_ms; }
+
+  /**
+   * By default a dual above the primal (a broken subproblem) ends
+   * the process. Long running callers can turn that off and check
+   * status() for "failure" instead.
+   */
+  void set_exit_on_failure(bool exit_on_failure) {
+    _exit_on_failure = exit_on_failure;
+  }
+
   void solve(int example);
 
   /**
@@ -102,8 +191,67 @@ class Subgradient {
   double best_primal() const {
     return _best_primal;
   }
+
+  double best_dual() const {
+    return _best_dual;
+  }
+
+  /**
+   * Certificate for the best primal, it is within gap of the
+   * optimum (best_dual is a lower bound).
+   */
+  double gap() const {
+    return fabs(_best_primal - _best_dual);
+  }
+
+  // Did the last call to solve stop on a time limit or deadline.
+  bool timed_out() const {
+    return _status == "deadline";
+  }
+
+  // Rounds used by the last call to solve.
+  int rounds() const {
+    return _round;
+  }
+
+  // Did the last call to solve find a certificate of optimality.
+  bool found_certificate() const {
+    return _certificate;
+  }
+
+  // Why the last call to solve stopped (certificate, converged,
+  // max_rounds, deadline or failure).
+  const string & status() const {
+    return _status;
+  }
  private:
+  void init() {
+    _best_dual = -1e20;
+    _best_primal = 1e20;
+    _round = 1;
+    _nround = 1;
+    _is_stuck = false;
+    _first_stuck_iteration = -1;
+    _aggressive = false;
+    _debug = false;
+    _max_round = 200;
+    _last_alpha = 0.0;
+    _certificate = false;
+    _telemetry = NULL;
+    _example = 0;
+    _solve_wall_start = 0.0;
+    _solve_cpu_start = 0;
+    _time_limit = 0.0;
+    _deadline = 0.0;
+    _status = "max_rounds";
+    _exit_on_failure = true;
+  }
+
   bool run_one_round();
+  bool past_deadline() const;
+  void record_round(const SubgradResult & result, 
+                    double wall_ms, double cpu_ms);
+  void record_summary();
 
 
   SubgradientProducer & _s;
@@ -120,10 +268,21 @@ class Subgradient {
   bool _is_stuck;
   int _first_stuck_iteration;
   int _best_primal_iteration;
-  SubgradRate & _rate;
+  SubgradRate * _rate;
+  DualOptimizer * _optimizer;
   bool _debug;
   int _max_round;
   double _last_alpha;
+  bool _certificate;
+
+  TelemetrySink * _telemetry;
+  int _example;
+  string _status;
+  double _solve_wall_start;
+  clock_t _solve_cpu_start;
+  double _time_limit;
+  double _deadline;
+  bool _exit_on_failure;
 };
 
 #endif
@@ -0,0 +1,131 @@
+#include "Telemetry.h"
+#include <cmath>
+#include <iomanip>
+using namespace std;
+
+// JSON has no inf or nan, which the bounds can be in early rounds.
+static void write_json_number(ostream & out, double value) {
+  if (isnan(value) || isinf(value)) {
+    out << "null";
+  } else {
+    out << value;
+  }
+}
+
+static void write_json_list(ostream & out, const vector <double> & values) {
+  out << "[";
+  for (unsigned int i = 0; i < values.size(); i++) {
+    if (i != 0) out << ",";
+    write_json_number(out, values[i]);
+  }
+  out << "]";
+}
+
+static void write_csv_list(ostream & out, const vector <double> & values) {
+  for (unsigned int i = 0; i < values.size(); i++) {
+    if (i != 0) out << ";";
+    out << values[i];
+  }
+}
+
+// Records end with endl so the file is complete even if the
+// decoder dies part way through a run.
+void JsonTelemetrySink::round(const RoundRecord & r) {
+  _out << setprecision(10)
+       << "{\"type\":\"round\""
+       << ",\"example\":" << r.example
+       << ",\"round\":" << r.round
+       << ",\"dual\":";
+  write_json_number(_out, r.dual);
+  _out << ",\"primal\":";
+  write_json_number(_out, r.primal);
+  _out << ",\"best_dual\":";
+  write_json_number(_out, r.best_dual);
+  _out << ",\"best_primal\":";
+  write_json_number(_out, r.best_primal);
+  _out << ",\"gap\":";
+  write_json_number(_out, r.gap);
+  _out << ",\"alpha\":";
+  write_json_number(_out, r.alpha);
+  _out << ",\"subgrad_nnz\":" << r.subgrad_nnz
+       << ",\"dirty\":" << r.dirty
+       << ",\"wall_ms\":";
+  write_json_number(_out, r.wall_ms);
+  _out << ",\"cpu_ms\":";
+  write_json_number(_out, r.cpu_ms);
+  _out << ",\"subproblem_wall_ms\":";
+  write_json_list(_out, r.subproblem_wall_ms);
+  _out << ",\"subproblem_cpu_ms\":";
+  write_json_list(_out, r.subproblem_cpu_ms);
+  _out << "}" << endl;
+}
+
+void JsonTelemetrySink::summary(const ExampleSummary & s) {
+  _out << setprecision(10)
+       << "{\"type\":\"summary\""
+       << ",\"example\":" << s.example
+       << ",\"rounds\":" << s.rounds
+       << ",\"status\":\"" << s.status << "\""
+       << ",\"best_dual\":";
+  write_json_number(_out, s.best_dual);
+  _out << ",\"best_primal\":";
+  write_json_number(_out, s.best_primal);
+  _out << ",\"gap\":";
+  write_json_number(_out, s.gap);
+  _out << ",\"wall_ms\":";
+  write_json_number(_out, s.wall_ms);
+  _out << ",\"cpu_ms\":";
+  write_json_number(_out, s.cpu_ms);
+  _out << "}" << endl;
+}
+
+void CsvTelemetrySink::header() {
+  if (_wrote_header) return;
+  _out << "type,example,round,status,dual,primal,best_dual,best_primal,"
+       << "gap,alpha,subgrad_nnz,dirty,wall_ms,cpu_ms,"
+       << "subproblem_wall_ms,subproblem_cpu_ms" << endl;
+  _wrote_header = true;
+}
+
+void CsvTelemetrySink::round(const RoundRecord & r) {
+  header();
+  _out << setprecision(10)
+       << "round," << r.example << "," << r.round << ",,"
+       << r.dual << "," << r.primal << ","
+       << r.best_dual << "," << r.best_primal << ","
+       << r.gap << "," << r.alpha << ","
+       << r.subgrad_nnz << "," << r.dirty << ","
+       << r.wall_ms << "," << r.cpu_ms << ",";
+  write_csv_list(_out, r.subproblem_wall_ms);
+  _out << ",";
+  write_csv_list(_out, r.subproblem_cpu_ms);
+  _out << endl;
+}
+
+// Summary rows use the round column for the number of rounds.
+void CsvTelemetrySink::summary(const ExampleSummary & s) {
+  header();
+  _out << setprecision(10)
+       << "summary," << s.example << "," << s.rounds << ","
+       << s.status << ",,,"
+       << s.best_dual << "," << s.best_primal << ","
+       << s.gap << ",,,,"
+       << s.wall_ms << "," << s.cpu_ms << ",," << endl;
+}
+
+TelemetrySink * telemetry_from_file(const string & file_name) {
+  if (file_name.empty()) return NULL;
+  // Lives as long as the sink, which is kept for the whole run.
+  ofstream * out = new ofstream(file_name.c_str());
+  if (!out->good()) {
+    cerr << "Could not open telemetry file " << file_name << endl;
+    delete out;
+    return NULL;
+  }
+  string ext = ".csv";
+  if (file_name.size() >= ext.size() &&
+      file_name.compare(file_name.size() - ext.size(), ext.size(), ext) == 0) {
+    return new CsvTelemetrySink(*out);
+  }
+  return new JsonTelemetrySink(*out);
+}
@@ -0,0 +1,89 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// One round of subgradient optimization.
+struct RoundRecord {
+  int example;
+  int round;
+  double dual;
+  double primal;
+  double best_dual;
+  double best_primal;
+  double gap;
+  double alpha;
+  // Non-zero entries in the subgradient.
+  int subgrad_nnz;
+  // Subproblems re-solved this round, -1 if unknown.
+  int dirty;
+  double wall_ms;
+  double cpu_ms;
+  vector <double> subproblem_wall_ms;
+  vector <double> subproblem_cpu_ms;
+};
+
+// Outcome of a full subgradient run on one example.
+struct ExampleSummary {
+  int example;
+  int rounds;
+  // "certificate", "converged", "max_rounds", "deadline" or "failure"
+  string status;
+  double best_dual;
+  double best_primal;
+  double gap;
+  double wall_ms;
+  double cpu_ms;
+};
+
+/**
+ * Receives structured records from the subgradient solver
+ * (see Subgradient::set_telemetry).
+ */
+class TelemetrySink {
+ public:
+  virtual ~TelemetrySink() {}
+  virtual void round(const RoundRecord & record) = 0;
+  virtual void summary(const ExampleSummary & summary) = 0;
+};
+
+/**
+ * Writes one JSON object per line. Rounds have "type":"round",
+ * summaries have "type":"summary".
+ */
+class JsonTelemetrySink : public TelemetrySink {
+ public:
+  JsonTelemetrySink(ostream & out): _out(out) {}
+  void round(const RoundRecord & record);
+  void summary(const ExampleSummary & summary);
+ private:
+  ostream & _out;
+};
+
+/**
+ * Writes rounds as CSV with a header line. Per subproblem times are
+ * joined with ';' in a single column. Summaries are written as rows
+ * with type "summary" so one file holds both.
+ */
+class CsvTelemetrySink : public TelemetrySink {
+ public:
+  CsvTelemetrySink(ostream & out): _out(out), _wrote_header(false) {}
+  void round(const RoundRecord & record);
+  void summary(const ExampleSummary & summary);
+ private:
+  void header();
+  ostream & _out;
+  bool _wrote_header;
+};
+
+/**
+ * Open a sink writing to file_name, CSV if the name ends in ".csv"
+ * and JSON lines otherwise. Returns NULL for an empty name.
+ */
+TelemetrySink * telemetry_from_file(const string & file_name);
+
+#endif
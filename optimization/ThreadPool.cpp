@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+struct WorkerArg {
+  ThreadPool * pool;
+  int thread_id;
+};
+
+ThreadPool::ThreadPool(int num_threads) :
+  _num_threads(num_threads < 1 ? 1 : num_threads),
+  _task(NULL), _items(NULL), _next_item(0), _active(0),
+  _generation(0), _shutdown(false) {
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_work_ready, NULL);
+  pthread_cond_init(&_work_done, NULL);
+
+  // Thread 0 is the caller.
+  _workers.resize(_num_threads - 1);
+  for (int i = 1; i < _num_threads; i++) {
+    WorkerArg * arg = new WorkerArg();
+    arg->pool = this;
+    arg->thread_id = i;
+    int err = pthread_create(&_workers[i - 1], NULL, &ThreadPool::worker_main, arg);
+    if (err != 0) {
+      // run() would wait forever on the missing worker.
+      cerr << "ThreadPool: could not start thread " << i << " of "
+           << _num_threads << ": " << strerror(err) << endl;
+      exit(1);
+    }
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  pthread_mutex_lock(&_lock);
+  _shutdown = true;
+  pthread_cond_broadcast(&_work_ready);
+  pthread_mutex_unlock(&_lock);
+
+  for (unsigned int i = 0; i < _workers.size(); i++) {
+    pthread_join(_workers[i], NULL);
+  }
+  pthread_cond_destroy(&_work_done);
+  pthread_cond_destroy(&_work_ready);
+  pthread_mutex_destroy(&_lock);
+}
+
+void * ThreadPool::worker_main(void * varg) {
+  WorkerArg * arg = (WorkerArg *) varg;
+  ThreadPool * pool = arg->pool;
+  int thread_id = arg->thread_id;
+  delete arg;
+
+  int seen_generation = 0;
+  while (true) {
+    pthread_mutex_lock(&pool->_lock);
+    while (!pool->_shutdown && pool->_generation == seen_generation) {
+      pthread_cond_wait(&pool->_work_ready, &pool->_lock);
+    }
+    if (pool->_shutdown) {
+      pthread_mutex_unlock(&pool->_lock);
+      return NULL;
+    }
+    seen_generation = pool->_generation;
+    pthread_mutex_unlock(&pool->_lock);
+
+    pool->work(thread_id);
+  }
+  return NULL;
+}
+
+void ThreadPool::work(int thread_id) {
+  while (true) {
+    pthread_mutex_lock(&_lock);
+    if (_next_item >= (int)_items->size()) {
+      _active--;
+      if (_active == 0) {
+        pthread_cond_signal(&_work_done);
+      }
+      pthread_mutex_unlock(&_lock);
+      return;
+    }
+    int item = (*_items)[_next_item];
+    _next_item++;
+    pthread_mutex_unlock(&_lock);
+
+    _task->run_item(item, thread_id);
+  }
+}
+
+void ThreadPool::run(ParallelTask & task, const vector <int> & items) {
+  if (_num_threads == 1 || items.size() <= 1) {
+    for (unsigned int i = 0; i < items.size(); i++) {
+      task.run_item(items[i], 0);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&_lock);
+  _task = &task;
+  _items = &items;
+  _next_item = 0;
+  _active = _num_threads;
+  _generation++;
+  pthread_cond_broadcast(&_work_ready);
+  pthread_mutex_unlock(&_lock);
+
+  work(0);
+
+  pthread_mutex_lock(&_lock);
+  while (_active != 0) {
+    pthread_cond_wait(&_work_done, &_lock);
+  }
+  _task = NULL;
+  _items = NULL;
+  pthread_mutex_unlock(&_lock);
+}
+
+void ThreadPool::run(ParallelTask & task, int num_items) {
+  vector <int> items(num_items);
+  for (int i = 0; i < num_items; i++) {
+    items[i] = i;
+  }
+  run(task, items);
+}
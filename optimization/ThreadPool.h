@@ -0,0 +1,78 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <pthread.h>
+#include <vector>
+using namespace std;
+
+/**
+ * A unit of work that can be split over a set of independent items.
+ * Each item is handed to exactly one thread. The thread id is in
+ * [0, num_threads) and can be used to index per-thread scratch space.
+ */
+class ParallelTask {
+ public:
+  virtual ~ParallelTask() {}
+
+  /**
+   * Process a single item.
+   *
+   * @param item The item to process
+   * @param thread_id The id of the thread running the item
+   */
+  virtual void run_item(int item, int thread_id) = 0;
+};
+
+/**
+ * Fixed size pool of worker threads. Workers are started once and
+ * reused for every call to run, so the pool can be kept around for
+ * the whole subgradient run. The calling thread takes part in the
+ * work as thread 0.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @param num_threads Total number of threads (including the caller).
+   * A value of 1 or less runs everything on the calling thread.
+   */
+  ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  int num_threads() const {
+    return _num_threads;
+  }
+
+  /**
+   * Run task over every item and block until all are done.
+   *
+   * @param task The work to do
+   * @param items The items to hand to the task
+   */
+  void run(ParallelTask & task, const vector <int> & items);
+
+  /**
+   * Run task over the items 0 ... num_items - 1.
+   */
+  void run(ParallelTask & task, int num_items);
+
+ private:
+  static void * worker_main(void * arg);
+  void work(int thread_id);
+
+  int _num_threads;
+  vector <pthread_t> _workers;
+
+  pthread_mutex_t _lock;
+  pthread_cond_t _work_ready;
+  pthread_cond_t _work_done;
+
+  // Current job, protected by _lock.
+  ParallelTask * _task;
+  const vector <int> * _items;
+  int _next_item;
+  int _active;
+  int _generation;
+  bool _shutdown;
+};
+
+#endif
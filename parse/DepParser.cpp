@@ -5,3 +5,11 @@ ostream& operator<<(ostream& output, const Dependency& h) {
   output << h.mod << "_" << h.head;// << "("<< h.length << ")";
   return output;
 } 
+
+void show_dependencies(vector<Dependency> deps) {
+  sort(deps.begin(), deps.end());
+  foreach (Dependency d, deps) {
+    cout << d << " ";
+  }
+  cout << endl;
+}
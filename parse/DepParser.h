@@ -32,6 +32,9 @@ private:
 
 ostream& operator<<(ostream& output, const Dependency& h);
 
+// Prints a parse as its dependencies, sorted by modifier.
+void show_dependencies(vector<Dependency> deps);
+
 
 class DepParser : public Scarab::HG::HypergraphImpl {
  public:
@@ -120,11 +123,7 @@ class DepParser : public Scarab::HG::HypergraphImpl {
         res.push_back(d);
       }
     }
-    sort(res.begin(), res.end());
-    foreach(Dependency d, res) {
-      cout << d << " ";
-    }
-    cout << endl;
+    show_dependencies(res);
   }
   
  protected:
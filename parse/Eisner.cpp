@@ -0,0 +1,192 @@
+#include "Eisner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "../common.h"
+
+vector<ArcScores *> read_first_order_file(const char * file,
+                                          double value_weight) {
+  vector<ArcScores *> ret;
+  fstream input(file, ios::in);
+  while (input) {
+    // (pos1, pos2, dir, prob), dir 0 when pos1 is the head.
+    vector<int> pos1s, pos2s, dirs;
+    vector<double> probs;
+    int max_pos = 0;
+    while (input) {
+      string ignore;
+      input >> ignore;
+      if (ignore == "DONE:" || !input) break;
+      int snum, pos1, pos2, dir;
+      double prob;
+      input >> snum >> pos1 >> pos2 >> dir >> prob;
+      pos1s.push_back(pos1);
+      pos2s.push_back(pos2);
+      dirs.push_back(dir);
+      probs.push_back(prob);
+      max_pos = max(max_pos, pos1);
+    }
+    if (pos1s.empty()) continue;
+
+    // Positions 0 .. max_pos + 1, as EisnerToHypergraph builds them.
+    ArcScores * scores = new ArcScores(max_pos + 2);
+    for (unsigned int i = 0; i < pos1s.size(); i++) {
+      if (pos2s[i] >= scores->length()) continue;
+      if (dirs[i] == 0) {
+        scores->set_score(pos1s[i], pos2s[i], value_weight * probs[i]);
+      } else {
+        scores->set_score(pos2s[i], pos1s[i], value_weight * probs[i]);
+      }
+    }
+    ret.push_back(scores);
+  }
+  input.close();
+  return ret;
+}
+
+double EisnerParser::parse(const ArcScores & scores,
+                           vector<Dependency> * deps) {
+  _n = scores.length();
+  _chart.assign(NUM_ITEMS * _n * _n, INF);
+  _split.assign(NUM_ITEMS * _n * _n, -1);
+  for (int i = 0; i < _n; i++) {
+    _chart[cell(RIGHT_TRI, i, i)] = 0.0;
+    _chart[cell(LEFT_TRI, i, i)] = 0.0;
+  }
+
+  for (int size = 1; size < _n; size++) {
+    for (int i = 0; i + size < _n; i++) {
+      int k = i + size;
+
+      // Trapezoids: right triangle [i, j] + left triangle [j + 1, k],
+      // adding the arc between i and k.
+      double best = INF;
+      int best_split = -1;
+      const double * right = &_chart[cell(RIGHT_TRI, i, 0)];
+      for (int j = i; j < k; j++) {
+        double val = right[j] + _chart[cell(LEFT_TRI, j + 1, k)];
+        if (val < best) {
+          best = val;
+          best_split = j;
+        }
+      }
+      _chart[cell(RIGHT_TRAP, i, k)] = best + scores.score(i, k);
+      _split[cell(RIGHT_TRAP, i, k)] = best_split;
+      _chart[cell(LEFT_TRAP, i, k)] = best + scores.score(k, i);
+      _split[cell(LEFT_TRAP, i, k)] = best_split;
+
+      // Right triangle: right trapezoid [i, j] + right triangle [j, k].
+      best = INF;
+      best_split = -1;
+      for (int j = i + 1; j <= k; j++) {
+        double val = _chart[cell(RIGHT_TRAP, i, j)] +
+            _chart[cell(RIGHT_TRI, j, k)];
+        if (val < best) {
+          best = val;
+          best_split = j;
+        }
+      }
+      _chart[cell(RIGHT_TRI, i, k)] = best;
+      _split[cell(RIGHT_TRI, i, k)] = best_split;
+
+      // Left triangle: left triangle [i, j] + left trapezoid [j, k].
+      best = INF;
+      best_split = -1;
+      for (int j = i; j < k; j++) {
+        double val = _chart[cell(LEFT_TRI, i, j)] +
+            _chart[cell(LEFT_TRAP, j, k)];
+        if (val < best) {
+          best = val;
+          best_split = j;
+        }
+      }
+      _chart[cell(LEFT_TRI, i, k)] = best;
+      _split[cell(LEFT_TRI, i, k)] = best_split;
+    }
+  }
+
+  deps->clear();
+  backtrack(RIGHT_TRI, 0, _n - 1, deps);
+  sort(deps->begin(), deps->end());
+  return _chart[cell(RIGHT_TRI, 0, _n - 1)];
+}
+
+void EisnerParser::backtrack(int item, int start, int end,
+                             vector<Dependency> * deps) {
+  if (start == end) return;
+  int j = _split[cell(item, start, end)];
+  switch (item) {
+    case RIGHT_TRAP:
+    case LEFT_TRAP:
+      if (item == RIGHT_TRAP) {
+        deps->push_back(Dependency(_n, start, end));
+      } else {
+        deps->push_back(Dependency(_n, end, start));
+      }
+      backtrack(RIGHT_TRI, start, j, deps);
+      backtrack(LEFT_TRI, j + 1, end, deps);
+      break;
+    case RIGHT_TRI:
+      backtrack(RIGHT_TRAP, start, j, deps);
+      backtrack(RIGHT_TRI, j, end, deps);
+      break;
+    case LEFT_TRI:
+      backtrack(LEFT_TRI, start, j, deps);
+      backtrack(LEFT_TRAP, j, end, deps);
+      break;
+  }
+}
+
+unsigned int EisnerForest::num_edges(unsigned int node) const {
+  int item, i, k;
+  decode(node, &item, &i, &k);
+  return (k > i) ? k - i : 0;
+}
+
+unsigned int EisnerForest::edge(unsigned int node, unsigned int e,
+                                vector <unsigned int> * tails) const {
+  int item, i, k;
+  decode(node, &item, &i, &k);
+  tails->clear();
+  int j;
+  switch (item) {
+    case RIGHT_TRAP:
+    case LEFT_TRAP:
+      j = i + e;
+      tails->push_back(this->node(RIGHT_TRI, i, j));
+      tails->push_back(this->node(LEFT_TRI, j + 1, k));
+      break;
+    case RIGHT_TRI:
+      j = i + 1 + e;
+      tails->push_back(this->node(RIGHT_TRAP, i, j));
+      tails->push_back(this->node(RIGHT_TRI, j, k));
+      break;
+    default:
+      j = i + e;
+      tails->push_back(this->node(LEFT_TRI, i, j));
+      tails->push_back(this->node(LEFT_TRAP, j, k));
+      break;
+  }
+  return node * _n + j;
+}
+
+double EisnerForest::weight(unsigned int edge) const {
+  Dependency dep;
+  if (!edge_dependency(edge, &dep)) return 0.0;
+  return _scores.score(dep.head, dep.mod);
+}
+
+bool EisnerForest::edge_dependency(unsigned int edge, Dependency * dep) const {
+  int item, i, k;
+  decode(edge / _n, &item, &i, &k);
+  if (k <= i) return false;
+  if (item == RIGHT_TRAP) {
+    *dep = Dependency(_n, i, k);
+    return true;
+  } else if (item == LEFT_TRAP) {
+    *dep = Dependency(_n, k, i);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,120 @@
+#ifndef EISNER_H_
+#define EISNER_H_
+
+#include <vector>
+#include "DepParser.h"
+#include "ImplicitHypergraph.h"
+using namespace std;
+
+/**
+ * Dense first-order arc costs for one sentence. Positions run from 0
+ * (the root) to length() - 1, and lower cost is better, as in
+ * HypergraphAlgorithms::best_path.
+ */
+class ArcScores {
+ public:
+  ArcScores() : _length(0) {}
+  ArcScores(int length) : _length(length), _scores(length * length, 0.0) {}
+
+  int length() const { return _length; }
+
+  inline double score(int head, int mod) const {
+    return _scores[head * _length + mod];
+  }
+
+  inline void set_score(int head, int mod, double score) {
+    _scores[head * _length + mod] = score;
+  }
+
+  inline void add_score(int head, int mod, double score) {
+    _scores[head * _length + mod] += score;
+  }
+
+ private:
+  int _length;
+  vector<double> _scores;
+};
+
+/**
+ * Reads arc costs in the format written for EisnerToHypergraph
+ * ("PROB: sent pos1 pos2 dir prob" lines, each sentence ended by
+ * "DONE:"), scaled by the weight of the 'value' feature.
+ */
+vector<ArcScores *> read_first_order_file(const char * file,
+                                          double value_weight);
+
+/**
+ * First-order projective parsing by Eisner's algorithm, run directly
+ * on an ArcScores matrix. Uses the same items as EisnerToHypergraph
+ * (left/right triangles and trapezoids) on flat span-indexed charts.
+ * The charts are kept between calls, so one parser per thread.
+ */
+class EisnerParser {
+ public:
+  /**
+   * @param deps The best tree's dependencies, sorted as in
+   *             DepParser::show_derivation
+   * @return The cost of the best tree
+   */
+  double parse(const ArcScores & scores, vector<Dependency> * deps);
+
+ private:
+  enum { RIGHT_TRI, LEFT_TRI, RIGHT_TRAP, LEFT_TRAP, NUM_ITEMS };
+
+  inline int cell(int item, int start, int end) const {
+    return (item * _n + start) * _n + end;
+  }
+
+  void backtrack(int item, int start, int end, vector<Dependency> * deps);
+
+  int _n;
+  vector<double> _chart;
+  vector<int> _split;
+};
+
+/**
+ * The first-order Eisner forest of EisnerParser as an
+ * ImplicitHypergraph, weighted by an ArcScores matrix. Node ids are the
+ * parser's chart cells and the edge id of a split j is node * length + j,
+ * so nothing is built per sentence beyond this object.
+ */
+class EisnerForest : public ImplicitHypergraph, public ImplicitWeights {
+ public:
+  EisnerForest(const ArcScores & scores)
+      : _scores(scores), _n(scores.length()) {}
+
+  unsigned int num_nodes() const { return NUM_ITEMS * _n * _n; }
+  unsigned int num_edges() const { return NUM_ITEMS * _n * _n * _n; }
+  unsigned int root() const { return node(RIGHT_TRI, 0, _n - 1); }
+
+  unsigned int num_edges(unsigned int node) const;
+  unsigned int edge(unsigned int node, unsigned int i,
+                    vector <unsigned int> * tails) const;
+
+  // Arc cost on trapezoid edges, 0 elsewhere.
+  double weight(unsigned int edge) const;
+
+  /**
+   * The dependency an edge adds, if any.
+   */
+  bool edge_dependency(unsigned int edge, Dependency * dep) const;
+
+ private:
+  enum { RIGHT_TRI, LEFT_TRI, RIGHT_TRAP, LEFT_TRAP, NUM_ITEMS };
+
+  inline unsigned int node(int item, int start, int end) const {
+    return (item * _n + start) * _n + end;
+  }
+
+  inline void decode(unsigned int node, int * item, int * start,
+                     int * end) const {
+    *end = node % _n;
+    *start = (node / _n) % _n;
+    *item = node / (_n * _n);
+  }
+
+  const ArcScores & _scores;
+  int _n;
+};
+
+#endif
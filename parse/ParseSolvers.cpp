@@ -15,71 +15,172 @@ int ParserDual::lag_to_sent_num(int  lag )  {
 }
 
 
-wvector ParserDual::build_parser_subgradient(int sent_num, const DepParser & parser, 
-                                             HEdges best_edges) {
+void ParserDual::prepare_scores(int sent_num) {
+  ParseScores & scores = _sentence_scores[sent_num];
+  if (scores.ready) return;
+
+  if (_arc_scores != NULL) {
+    scores.length = (*_arc_scores)[sent_num]->length();
+  } else {
+    const DepParser & parser = *_parsers[sent_num];
+    scores.length = parser.sent_length();
+    scores.edge_cost.resize(parser.num_edges());
+    scores.edge_dep.resize(parser.num_edges(), -1);
+    foreach (HEdge edge, parser.edges()) {
+      scores.edge_cost[edge->id()] = edge->fvector().dot(_base_weights);
+      if (parser.edge_has_dep(*edge)) {
+        scores.edge_dep[edge->id()] = parser.edge_to_dep(*edge).id();
+      }
+    }
+  }
+
+  int length = scores.length;
+  scores.cell_lag.resize(length * length, -1);
+  scores.penalty.resize(length * length, 0.0);
+  for (int m = 1; m < length; m++) {
+    for (int h = 0; h < length; h++) {
+      if (h == m) continue;
+      Dependency t(length, h, m);
+      int lag;
+      if (!dep_to_lag(sent_num, t, lag)) continue;
+      if (_arc_scores == NULL && !_parsers[sent_num]->dep_has_edge(t)) continue;
+      scores.cell_lag[t.id()] = lag;
+      scores.aligned.push_back(t.id());
+    }
+  }
+  scores.ready = true;
+}
+
+EdgeCache * ParserDual::build_edge_weights(int sent_num) {
+  prepare_scores(sent_num);
+  ParseScores & scores = _sentence_scores[sent_num];
+  foreach (int cell, scores.aligned) {
+    scores.penalty[cell] = cur_weight(scores.cell_lag[cell]);
+  }
+
+  int num_edges = scores.edge_cost.size();
+  EdgeCache * weights = new EdgeCache(num_edges);
+  for (int id = 0; id < num_edges; id++) {
+    double cost = scores.edge_cost[id];
+    if (scores.edge_dep[id] != -1) {
+      cost += scores.penalty[scores.edge_dep[id]];
+    }
+    weights->store[id] = cost;
+    weights->has_value[id] = true;
+  }
+  return weights;
+}
+
+wvector ParserDual::build_parser_subgradient(int sent_num, HEdges best_edges) {
+  const ParseScores & scores = _sentence_scores[sent_num];
   wvector ret;
   foreach (HEdge e, best_edges) {
-    if (parser.edge_has_dep(*e)) {
-      const Dependency & t = parser.edge_to_dep(*e);
-      int lag;
-      if (dep_to_lag(sent_num, t, lag)) {
-        ret[lag] +=1;
-      }      
+    int cell = scores.edge_dep[e->id()];
+    if (cell != -1 && scores.cell_lag[cell] != -1) {
+      ret[scores.cell_lag[cell]] += 1;
     }
   }
   return ret;
 }
 
+void ParserDual::solve_one_eisner(int sent_num, int thread_id, double & primal, double & dual, wvector & subgrad) {
+  const ArcScores & base = *(*_arc_scores)[sent_num];
+  prepare_scores(sent_num);
+  const ParseScores & cells = _sentence_scores[sent_num];
+  int length = cells.length;
+  ParseScratch & scratch = _scratch[thread_id];
+
+  // The dual values only touch the aligned dependencies.
+  ArcScores & scores = scratch.arc_scores;
+  scores = base;
+  foreach (int cell, cells.aligned) {
+    scores.add_score(cell / length, cell % length, 
+                     cur_weight(cells.cell_lag[cell]));
+  }
 
-EdgeCache ParserDual::build_parser_constraint_vector(int sent_num, const DepParser & parser) {
-  EdgeCache ret(parser.num_edges());
-  foreach (const Dependency & t, parser.dependencies()) {
-    int lag;
-    if (!dep_to_lag(sent_num, t, lag) || !parser.dep_has_edge(t)) continue;
-
-    HEdges edges = parser.dep_to_edge(t);
+  vector<Dependency> & deps = best_dependencies[sent_num];
+  dual = scratch.eisner.parse(scores, &deps);
 
-    foreach (HEdge edge, edges) { 
-      if (!ret.has_key(*edge)) {
-        ret.set_value(*edge, 0.0);
-      }
-      ret.set_value(*edge, ret.get(*edge) + ((*_cur_weights)[lag]));
+  primal = 0.0;
+  wvector grad;
+  foreach (const Dependency & t, deps) {
+    primal += base.score(t.head, t.mod);
+    int lag = cells.cell_lag[t.id()];
+    if (lag != -1) {
+      grad[lag] += 1;
     }
-  } 
-  return ret;
-} 
+  }
+  subgrad = grad;
+}
 
-void ParserDual::solve_one(int sent_num, double & primal, double & dual, wvector & subgrad) {
+void ParserDual::solve_one(int sent_num, int thread_id, double & primal, double & dual, wvector & subgrad) {
+  if (_arc_scores != NULL) {
+    solve_one_eisner(sent_num, thread_id, primal, dual, subgrad);
+    return;
+  }
   const DepParser & parser = *_parsers[sent_num];
   
   HypergraphAlgorithms ha(parser);
 
-  EdgeCache * edge_weights = ha.cache_edge_weights(_base_weights);    
-
-  EdgeCache added = build_parser_constraint_vector(sent_num, parser) ;
-  
-  EdgeCache * final_weights = ha.combine_edge_weights(*edge_weights, added);
+  EdgeCache * final_weights = build_edge_weights(sent_num);
   
-  NodeCache score_memo_table(parser.num_nodes()); 
+  NodeCache & score_memo_table = _scratch[thread_id].score_memo;
+  score_memo_table.reset(parser.num_nodes());
       
-  NodeBackCache  back_memo_table(parser.num_nodes());
+  NodeBackCache & back_memo_table = _scratch[thread_id].back_memo;
+  back_memo_table.reset(parser.num_nodes());
       
 
   dual = ha.best_path(*final_weights, score_memo_table, back_memo_table);
-  wvector feature_vec = ha.construct_best_feature_vector(back_memo_table);
     
   HEdges best_edges = ha.construct_best_edges(back_memo_table);
 
-  primal = feature_vec.dot(_base_weights
-);
-  subgrad = build_parser_subgradient(sent_num, parser, best_edges);
+  const ParseScores & scores = _sentence_scores[sent_num];
+  primal = 0.0;
+  foreach (HEdge e, best_edges) {
+    primal += scores.edge_cost[e->id()];
+  }
+  subgrad = build_parser_subgradient(sent_num, best_edges);
   
   best_derivations[sent_num] = best_edges;
-  
+  delete final_weights;
+}
+
+void ParserDual::show_one(int sent_num) const {
   cout << endl << "REDO: " <<sent_num << " ";
-  parser.show_derivation(best_derivations[sent_num]);  
-  
+  if (_arc_scores != NULL) {
+    show_dependencies(best_dependencies[sent_num]);
+  } else {
+    _parsers[sent_num]->show_derivation(best_derivations[sent_num]);
+  }
 }
 
 
 
+
+bool ParserDual::solve_one_smooth(int sent_num, int thread_id, double temperature, 
+                                  double & smooth_dual, wvector & smooth_grad) {
+  if (_arc_scores != NULL) return false;
+  const DepParser & parser = *_parsers[sent_num];
+  
+  HypergraphAlgorithms ha(parser);
+
+  EdgeCache * final_weights = build_edge_weights(sent_num);
+
+  NodeCache node_marginals(parser.num_nodes());
+  EdgeCache edge_marginals(parser.num_edges());
+  smooth_dual = ha.soft_marginals(*final_weights, temperature, 
+                                  node_marginals, edge_marginals);
+
+  // Expected version of build_parser_subgradient.
+  const ParseScores & scores = _sentence_scores[sent_num];
+  foreach (HEdge e, parser.edges()) {
+    if (!edge_marginals.has_key(*e)) continue;
+    int cell = scores.edge_dep[e->id()];
+    if (cell != -1 && scores.cell_lag[cell] != -1) {
+      smooth_grad[scores.cell_lag[cell]] += edge_marginals.get_value(*e);
+    }
+  }
+  delete final_weights;
+  return true;
+}
@@ -3,39 +3,115 @@
 
 
 #include "DepParser.h"
+#include "HypergraphAlgorithms.h"
+#include "Eisner.h"
 #include "ParseConstraints.h"
 #include "DualDecomposition.h"
 #include "CorpusSolver.h"
 
+/**
+ * Per sentence scores, computed on the first solve. The base cost of
+ * every hyperedge (its features dotted with the base weights, which do
+ * not change) and, for edges that add a dependency, that dependency's
+ * cell head * length + mod in a dense head x modifier table. The
+ * aligned cells and their lagrange ids are listed once, so a round only
+ * fills the penalty overlay from those and reads edge costs by index.
+ */
+struct ParseScores {
+  ParseScores() : ready(false) {}
+  bool ready;
+  int length;
+  vector <double> edge_cost;
+  vector <int> edge_dep;
+
+  // Lagrange id of each cell, or -1, and the cells that have one.
+  vector <int> cell_lag;
+  vector <int> aligned;
+
+  // Current dual penalty by cell, only aligned cells are non-zero.
+  vector <double> penalty;
+};
+
+/**
+ * Buffers a thread reuses for every sentence it solves.
+ */
+struct ParseScratch {
+  ParseScratch() : score_memo(0), back_memo(0) {}
+  NodeCache score_memo;
+  NodeBackCache back_memo;
+  EisnerParser eisner;
+  ArcScores arc_scores;
+};
+
 class ParserDual:public CorpusSolver {
  public:
  ParserDual(vector <DepParser*> & parsers, 
             const wvector & base_weights,  
             const ParseMrfAligner & consistency): 
   CorpusSolver(parsers.size()),
+    best_derivations(parsers.size()),
   _parsers(parsers), 
   _base_weights(base_weights),
     _parse_consistency(consistency),
-    best_derivations(parsers.size())
+    _arc_scores(NULL),
+    _sentence_scores(parsers.size())
+      { }
+
+  /** 
+   * First-order parsing straight from dense arc costs, with Eisner's
+   * algorithm instead of a parse hypergraph. The results are in
+   * best_dependencies.
+   */
+ ParserDual(const vector <ArcScores*> & arc_scores,
+            const ParseMrfAligner & consistency): 
+  CorpusSolver(arc_scores.size()),
+    best_dependencies(arc_scores.size()),
+  _parsers(_no_parsers), 
+  _base_weights(_no_weights),  
+    _parse_consistency(consistency),
+    _arc_scores(&arc_scores),
+    _sentence_scores(arc_scores.size())
       { }
 
   vector< HEdges> best_derivations;
+  vector< vector<Dependency> > best_dependencies;
 
  protected:
+  vector <DepParser*> _no_parsers;
+  wvector _no_weights;
   const vector <DepParser*> & _parsers;
   const wvector & _base_weights;
   const ParseMrfAligner & _parse_consistency;
 
+  // Set when parsing natively from arc costs.
+  const vector <ArcScores*> * _arc_scores;
+
+  vector <ParseScores> _sentence_scores;
+  vector <ParseScratch> _scratch;
+
+  void set_up_scratch(int num_threads) {
+    _scratch.resize(num_threads);
+  }
+
+  // Fills _sentence_scores[sent_num] if this is its first solve.
+  void prepare_scores(int sent_num);
+
+  // Base edge costs plus the current penalties, by edge id.
+  EdgeCache * build_edge_weights(int sent_num);
+
+  void solve_one_eisner(int sent_num, int thread_id, double & primal, double & dual, wvector & subgrad);
+
   bool dep_to_lag(int sent_num, const Dependency & t, int & lag );
 
-  void solve_one(int sent_num, double & primal, double & dual, wvector & subgrad) ;
+  void solve_one(int sent_num, int thread_id, double & primal, double & dual, wvector & subgrad) ;
+  bool solve_one_smooth(int sent_num, int thread_id, double temperature, 
+                        double & smooth_dual, wvector & smooth_grad);
   
   int lag_to_sent_num(int lag) ;
 
-  wvector build_parser_subgradient(int sent_num, const DepParser & dep_parser, 
-                                   HEdges best_edges);
+  void show_one(int sent_num) const;
 
-  EdgeCache build_parser_constraint_vector(int sent_num, const DepParser & dep_parser);
+  wvector build_parser_subgradient(int sent_num, HEdges best_edges);
   
 };
 
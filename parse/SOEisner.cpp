@@ -0,0 +1,201 @@
+#include "SOEisner.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <fstream>
+#include <iostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../common.h"
+
+vector<SiblingScores *> read_second_order_file(const char * file,
+                                               double value_weight) {
+  vector<SiblingScores *> ret;
+  fstream input(file, ios::in);
+  while (input) {
+    vector<int> heads, sibs, mods;
+    vector<double> probs;
+    int max_pos = 0;
+    while (input) {
+      string ignore;
+      input >> ignore;
+      if (ignore == "DONE:" || !input) break;
+      int snum, head, sib, mod;
+      double prob;
+      input >> snum >> head >> sib >> mod >> prob;
+      heads.push_back(head);
+      sibs.push_back(sib);
+      mods.push_back(mod);
+      probs.push_back(prob);
+      max_pos = max(max_pos, sib);
+    }
+    if (heads.empty()) continue;
+
+    // Positions 0 .. max_pos, as SecondOrderConverter builds them.
+    int length = max_pos + 1;
+    SiblingScores * scores = new SiblingScores(length);
+    for (unsigned int i = 0; i < heads.size(); i++) {
+      if (heads[i] >= length || mods[i] >= length) continue;
+      scores->set_score(heads[i], sibs[i], mods[i], value_weight * probs[i]);
+    }
+    ret.push_back(scores);
+  }
+  input.close();
+  return ret;
+}
+
+// Smallest a[j] + b[j] (+ c[j]) over j < n.
+static inline double min_sum(const double * a, const double * b,
+                             const double * c, int n) {
+  double best = INF;
+  int j = 0;
+#ifdef __SSE2__
+  // Two accumulators of two lanes each.
+  __m128d best_lo = _mm_set1_pd(INF);
+  __m128d best_hi = _mm_set1_pd(INF);
+  if (c == NULL) {
+    for (; j + 4 <= n; j += 4) {
+      best_lo = _mm_min_pd(best_lo, _mm_add_pd(_mm_loadu_pd(a + j),
+                                               _mm_loadu_pd(b + j)));
+      best_hi = _mm_min_pd(best_hi, _mm_add_pd(_mm_loadu_pd(a + j + 2),
+                                               _mm_loadu_pd(b + j + 2)));
+    }
+  } else {
+    for (; j + 4 <= n; j += 4) {
+      best_lo = _mm_min_pd(best_lo, _mm_add_pd(
+          _mm_add_pd(_mm_loadu_pd(a + j), _mm_loadu_pd(b + j)),
+          _mm_loadu_pd(c + j)));
+      best_hi = _mm_min_pd(best_hi, _mm_add_pd(
+          _mm_add_pd(_mm_loadu_pd(a + j + 2), _mm_loadu_pd(b + j + 2)),
+          _mm_loadu_pd(c + j + 2)));
+    }
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_min_pd(best_lo, best_hi));
+  best = min(lanes[0], lanes[1]);
+#endif
+  for (; j < n; j++) {
+    double val = (c == NULL) ? a[j] + b[j] : a[j] + b[j] + c[j];
+    best = min(best, val);
+  }
+  return best;
+}
+
+// First j < n where a[j] + b[j] (+ c[j]) is best, as min_sum found it.
+static inline int find_sum(const double * a, const double * b,
+                           const double * c, int n, double best) {
+  for (int j = 0; j < n; j++) {
+    double val = (c == NULL) ? a[j] + b[j] : a[j] + b[j] + c[j];
+    if (val == best) return j;
+  }
+  assert(false);
+  return -1;
+}
+
+double SOEisnerParser::right_trap_first(int i, int k) const {
+  return get(LEFT_TRI, i + 1, k) + _scores->score(i, i, k);
+}
+
+double SOEisnerParser::left_trap_first(int i, int k) const {
+  return get(RIGHT_TRI, i, k - 1) + _scores->score(k, k, i);
+}
+
+double SOEisnerParser::parse(const SiblingScores & scores,
+                             vector<Dependency> * deps) {
+  _n = scores.length();
+  _scores = &scores;
+  _chart.assign(NUM_ITEMS * _n * _n, INF);
+  _chart_t.assign(NUM_ITEMS * _n * _n, INF);
+  for (int i = 0; i < _n; i++) {
+    set(RIGHT_TRI, i, i, 0.0);
+    set(LEFT_TRI, i, i, 0.0);
+  }
+
+  for (int size = 1; size < _n; size++) {
+    for (int i = 0; i + size < _n; i++) {
+      int k = i + size;
+
+      // Box: right triangle [i, j] + left triangle [j + 1, k].
+      set(BOX, i, k, min_sum(row(RIGHT_TRI, i) + i,
+                             col(LEFT_TRI, k) + i + 1, NULL, size));
+
+      // Right trapezoid: the first modifier k of i, or right trapezoid
+      // [i, j] + box [j, k] with sibling j.
+      set(RIGHT_TRAP, i, k,
+          min(right_trap_first(i, k),
+              min_sum(row(RIGHT_TRAP, i) + i + 1, col(BOX, k) + i + 1,
+                      scores.siblings(i, k) + i + 1, size - 1)));
+
+      // Left trapezoid: the first modifier i of k, or box [i, j] + left
+      // trapezoid [j, k] with sibling j.
+      set(LEFT_TRAP, i, k,
+          min(left_trap_first(i, k),
+              min_sum(row(BOX, i) + i + 1, col(LEFT_TRAP, k) + i + 1,
+                      scores.siblings(k, i) + i + 1, size - 1)));
+
+      // Right triangle: right trapezoid [i, j] + right triangle [j, k].
+      set(RIGHT_TRI, i, k, min_sum(row(RIGHT_TRAP, i) + i + 1,
+                                   col(RIGHT_TRI, k) + i + 1, NULL, size));
+
+      // Left triangle: left triangle [i, j] + left trapezoid [j, k].
+      set(LEFT_TRI, i, k, min_sum(row(LEFT_TRI, i) + i,
+                                  col(LEFT_TRAP, k) + i, NULL, size));
+    }
+  }
+
+  deps->clear();
+  backtrack(RIGHT_TRI, 0, _n - 1, deps);
+  sort(deps->begin(), deps->end());
+  return get(RIGHT_TRI, 0, _n - 1);
+}
+
+void SOEisnerParser::backtrack(int item, int i, int k,
+                               vector<Dependency> * deps) {
+  if (i == k) return;
+  double val = get(item, i, k);
+  int size = k - i;
+  int j;
+  switch (item) {
+    case BOX:
+      j = i + find_sum(row(RIGHT_TRI, i) + i, col(LEFT_TRI, k) + i + 1,
+                       NULL, size, val);
+      backtrack(RIGHT_TRI, i, j, deps);
+      backtrack(LEFT_TRI, j + 1, k, deps);
+      break;
+    case RIGHT_TRAP:
+      deps->push_back(Dependency(_n, i, k));
+      if (val == right_trap_first(i, k)) {
+        backtrack(LEFT_TRI, i + 1, k, deps);
+      } else {
+        j = i + 1 + find_sum(row(RIGHT_TRAP, i) + i + 1, col(BOX, k) + i + 1,
+                             _scores->siblings(i, k) + i + 1, size - 1, val);
+        backtrack(RIGHT_TRAP, i, j, deps);
+        backtrack(BOX, j, k, deps);
+      }
+      break;
+    case LEFT_TRAP:
+      deps->push_back(Dependency(_n, k, i));
+      if (val == left_trap_first(i, k)) {
+        backtrack(RIGHT_TRI, i, k - 1, deps);
+      } else {
+        j = i + 1 + find_sum(row(BOX, i) + i + 1, col(LEFT_TRAP, k) + i + 1,
+                             _scores->siblings(k, i) + i + 1, size - 1, val);
+        backtrack(BOX, i, j, deps);
+        backtrack(LEFT_TRAP, j, k, deps);
+      }
+      break;
+    case RIGHT_TRI:
+      j = i + 1 + find_sum(row(RIGHT_TRAP, i) + i + 1,
+                           col(RIGHT_TRI, k) + i + 1, NULL, size, val);
+      backtrack(RIGHT_TRAP, i, j, deps);
+      backtrack(RIGHT_TRI, j, k, deps);
+      break;
+    case LEFT_TRI:
+      j = i + find_sum(row(LEFT_TRI, i) + i, col(LEFT_TRAP, k) + i,
+                       NULL, size, val);
+      backtrack(LEFT_TRI, i, j, deps);
+      backtrack(LEFT_TRAP, j, k, deps);
+      break;
+  }
+}
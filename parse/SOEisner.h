@@ -0,0 +1,103 @@
+#ifndef SOEISNER_H_
+#define SOEISNER_H_
+
+#include <vector>
+#include "DepParser.h"
+using namespace std;
+
+/**
+ * Dense second-order (sibling) costs for one sentence: score(h, s, m)
+ * is the cost of head h taking modifier m with s as the previous
+ * modifier on the same side, or s == h for the first one. Laid out so
+ * that the siblings of a fixed (h, m) are contiguous.
+ */
+class SiblingScores {
+ public:
+  SiblingScores() : _length(0) {}
+  SiblingScores(int length) :
+  _length(length), _scores(length * length * length, 0.0) {}
+
+  int length() const { return _length; }
+
+  inline double score(int head, int sib, int mod) const {
+    return _scores[(head * _length + mod) * _length + sib];
+  }
+
+  inline void set_score(int head, int sib, int mod, double score) {
+    _scores[(head * _length + mod) * _length + sib] = score;
+  }
+
+  // The costs of (head, mod) indexed by sibling.
+  inline const double * siblings(int head, int mod) const {
+    return &_scores[(head * _length + mod) * _length];
+  }
+
+ private:
+  int _length;
+  vector<double> _scores;
+};
+
+/**
+ * Reads sibling costs in the format of SecondOrderConverter
+ * ("PROB: sent head sib mod prob" lines, each sentence ended by
+ * "DONE:"), scaled by the weight of the 'value' feature. Unlike the
+ * converter there is no length cap; the tensor is sentence sized.
+ */
+vector<SiblingScores *> read_second_order_file(const char * file,
+                                               double value_weight);
+
+/**
+ * Second-order sibling parsing by Eisner's algorithm, run directly on
+ * a SiblingScores tensor with the items of EisnerToHypergraph in
+ * SOEisnerToHypergraph.h (triangles, trapezoids and boxes).
+ *
+ * Each chart is kept as (start, end) rows and also transposed, so
+ * every split maximization reads its operands with unit stride; those
+ * reductions use SSE2 when available. Split points are not stored,
+ * the backtrack finds them again. One parser per thread.
+ */
+class SOEisnerParser {
+ public:
+  /**
+   * @param deps The best tree's dependencies, sorted as in
+   *             DepParser::show_derivation
+   * @return The cost of the best tree
+   */
+  double parse(const SiblingScores & scores, vector<Dependency> * deps);
+
+ private:
+  enum { RIGHT_TRI, LEFT_TRI, RIGHT_TRAP, LEFT_TRAP, BOX, NUM_ITEMS };
+
+  inline double get(int item, int start, int end) const {
+    return _chart[(item * _n + start) * _n + end];
+  }
+
+  inline void set(int item, int start, int end, double val) {
+    _chart[(item * _n + start) * _n + end] = val;
+    _chart_t[(item * _n + end) * _n + start] = val;
+  }
+
+  // Item values starting at start, indexed by end.
+  inline const double * row(int item, int start) const {
+    return &_chart[(item * _n + start) * _n];
+  }
+
+  // Item values ending at end, indexed by start.
+  inline const double * col(int item, int end) const {
+    return &_chart_t[(item * _n + end) * _n];
+  }
+
+  // The two ways to build a trapezoid: first modifier, or next to a
+  // sibling (the latter minimized over the sibling).
+  double right_trap_first(int i, int k) const;
+  double left_trap_first(int i, int k) const;
+
+  void backtrack(int item, int start, int end, vector<Dependency> * deps);
+
+  int _n;
+  const SiblingScores * _scores;
+  vector<double> _chart;
+  vector<double> _chart_t;
+};
+
+#endif
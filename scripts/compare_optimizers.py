@@ -0,0 +1,58 @@
+import sys, json
+
+# Compares dual optimizers from the telemetry of runs on the same
+# examples (--telemetry_file, one run per --dual_optimizer).
+#
+#   python compare_optimizers.py subgradient=sg.json bundle=b.json nesterov=n.csv
+#
+# The first run is the baseline. Rounds to certificate only count
+# examples where both runs found a certificate.
+
+def read_summaries(file_name):
+  summaries = {}
+  handle = open(file_name)
+  if file_name.endswith(".csv"):
+    header = handle.readline().strip().split(',')
+    for l in handle:
+      row = dict(zip(header, l.strip().split(',')))
+      if row["type"] != "summary": continue
+      summaries[int(row["example"])] = {
+        "rounds" : int(row["round"]),
+        "status" : row["status"],
+        "gap" : float(row["gap"]),
+        "wall_ms" : float(row["wall_ms"])}
+  else:
+    for l in handle:
+      record = json.loads(l)
+      if record["type"] != "summary": continue
+      summaries[record["example"]] = record
+  return summaries
+
+def mean(values):
+  if not values: return 0.0
+  return sum(values) / float(len(values))
+
+def main(args):
+  runs = []
+  for arg in args:
+    name, file_name = arg.split('=', 1)
+    runs.append((name, read_summaries(file_name)))
+  base_name, base = runs[0]
+
+  print "%-12s %8s %8s %10s %11s %10s %10s" % (
+    "OPTIMIZER", "EXAMPLES", "CERTS", "ROUNDS", "BASE_ROUNDS",
+    "WALL_MS", "BASE_WALL")
+  for name, run in runs:
+    shared = [e for e in run if e in base]
+    certs = [e for e in run if run[e]["status"] == "certificate"]
+    both = [e for e in certs
+            if e in base and base[e]["status"] == "certificate"]
+    print "%-12s %8d %8d %10.1f %11.1f %10.1f %10.1f" % (
+      name, len(run), len(certs),
+      mean([run[e]["rounds"] for e in both]),
+      mean([base[e]["rounds"] for e in both]),
+      sum([run[e]["wall_ms"] for e in shared]),
+      sum([base[e]["wall_ms"] for e in shared]))
+
+if __name__ == "__main__":
+  main(sys.argv[1:])
@@ -0,0 +1,47 @@
+"""
+Local client for trans_server.
+
+  python scripts/trans_client.py /tmp/trans.sock forest_prefix lattice_prefix 0 9
+
+sends the forests forest_prefix0 ... forest_prefix9 (with the matching
+lattices) and prints each answer with its round trip time. With only
+the socket argument, request lines ("<id> <forest> <lattice>") are
+read from stdin. Pass --quit to stop the server afterwards.
+"""
+import socket, sys, time
+
+def main(args):
+  quit = "--quit" in args
+  args = [a for a in args if a != "--quit"]
+  if len(args) == 5:
+    path, forest, lattice, start, end = args
+    requests = ["%d %s%d %s%d" % (i, forest, i, lattice, i)
+                for i in range(int(start), int(end) + 1)]
+  elif len(args) == 1:
+    path = args[0]
+    requests = [l.strip() for l in sys.stdin if l.strip()]
+  else:
+    sys.stderr.write(__doc__)
+    return 1
+
+  conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+  conn.connect(path)
+  sent = {}
+  for r in requests:
+    sent[r.split()[0]] = time.time()
+    conn.sendall((r + "\n").encode())
+  if quit:
+    conn.sendall("quit\n".encode())
+  conn.shutdown(socket.SHUT_WR)
+
+  for line in conn.makefile("r"):
+    line = line.strip()
+    rid = line.split()[0]
+    ms = (time.time() - sent.get(rid, time.time())) * 1000.0
+    sys.stdout.write("%s round_trip_ms %.1f\n" % (line, ms))
+    sys.stdout.flush()
+  conn.close()
+  return 0
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv[1:]))
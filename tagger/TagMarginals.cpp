@@ -0,0 +1,85 @@
+#include "TagMarginals.h"
+
+#include <fstream>
+#include <HypergraphAlgorithms.h>
+#include "TagTrellis.h"
+#include "../common.h"
+
+void tag_marginals(const Tagger & tagger, const wvector & weights,
+                   double temperature, int sentence,
+                   vector <TagMarginal> * out) {
+  int length = tagger.sent_length();
+  int num_tag = tagger.num_tag;
+  vector <double> table(length * num_tag, 0.0);
+  vector <bool> seen(length * num_tag, false);
+
+  TagTrellis * trellis = TagTrellis::from_tagger(tagger, weights);
+  if (trellis != NULL) {
+    vector <double> state_marginals;
+    trellis->marginals(vector <double>(), temperature, &state_marginals);
+    for (int state = 0; state < trellis->num_states(); state++) {
+      const Hypernode & node = tagger.get_node(trellis->state_node(state));
+      if (!tagger.node_has_tag(node)) continue;
+      const Tag & tag = tagger.node_to_tag(node);
+      int cell = tag.ind * num_tag + tag.tag;
+      table[cell] += state_marginals[state];
+      seen[cell] = true;
+    }
+    delete trellis;
+  } else {
+    HypergraphAlgorithms ha(tagger);
+    EdgeCache * edge_weights = ha.cache_edge_weights(weights);
+    NodeCache node_marginals(tagger.num_nodes());
+    EdgeCache edge_marginals(tagger.num_edges());
+    ha.soft_marginals(*edge_weights, temperature,
+                      node_marginals, edge_marginals);
+    delete edge_weights;
+    foreach (HNode node, tagger.nodes()) {
+      if (!tagger.node_has_tag(*node) || !node_marginals.has_key(*node)) {
+        continue;
+      }
+      const Tag & tag = tagger.node_to_tag(*node);
+      int cell = tag.ind * num_tag + tag.tag;
+      table[cell] += node_marginals.get_value(*node);
+      seen[cell] = true;
+    }
+  }
+
+  for (int cell = 0; cell < length * num_tag; cell++) {
+    if (!seen[cell]) continue;
+    TagMarginal record;
+    record.sentence = sentence;
+    record.position = cell / num_tag;
+    record.tag = cell % num_tag;
+    record.marginal = table[cell];
+    out->push_back(record);
+  }
+}
+
+void write_tag_marginals(ostream & out,
+                         const vector <TagMarginal> & records) {
+  if (records.empty()) return;
+  out.write(reinterpret_cast<const char *>(&records[0]),
+            records.size() * sizeof(TagMarginal));
+}
+
+bool read_tag_marginals(const string & file,
+                        vector <TagMarginal> * records) {
+  fstream input(file.c_str(), ios::in | ios::binary);
+  if (!input) {
+    cerr << "Failed to read marginals " << file << endl;
+    return false;
+  }
+  input.seekg(0, ios::end);
+  streamoff bytes = input.tellg();
+  input.seekg(0, ios::beg);
+  if (bytes % sizeof(TagMarginal) != 0) {
+    cerr << "Marginals file " << file << " is cut short" << endl;
+    return false;
+  }
+  records->resize(bytes / sizeof(TagMarginal));
+  if (!records->empty()) {
+    input.read(reinterpret_cast<char *>(&(*records)[0]), bytes);
+  }
+  return input.good();
+}
@@ -0,0 +1,43 @@
+#ifndef TAGMARGINALS_H_
+#define TAGMARGINALS_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Tagger.h"
+using namespace std;
+
+/**
+ * The posterior of one tag at one word. Written to disk as is, 16 bytes
+ * in native byte order, so a file of them can be read back (or mapped)
+ * as an array.
+ */
+struct TagMarginal {
+  int32_t sentence;
+  int32_t position;
+  int32_t tag;
+  float marginal;
+};
+
+/**
+ * Tag posteriors of a sentence at the given temperature, by
+ * forward-backward over its TagTrellis (or soft_marginals on the
+ * hypergraph if it is not a trellis). States with the same word and tag
+ * are summed. Appends one record per tag seen, in (position, tag) order.
+ */
+void tag_marginals(const Tagger & tagger, const wvector & weights,
+                   double temperature, int sentence,
+                   vector <TagMarginal> * out);
+
+/**
+ * Append records to a binary stream, back to back.
+ */
+void write_tag_marginals(ostream & out, const vector <TagMarginal> & records);
+
+/**
+ * Read a whole file written by write_tag_marginals.
+ * @return false if the file can't be read or is cut short
+ */
+bool read_tag_marginals(const string & file, vector <TagMarginal> * records);
+
+#endif
@@ -45,15 +45,65 @@ EdgeCache TaggerDual::build_tagger_constraint_vector(int sent_num, const Tagger
         if (!ret.has_key(*edge)) {
           ret.set_value(*edge, 0.0);
         }
-        ret.set_value(*edge, ret.get(*edge) + ((*_cur_weights)[lag]));
+        ret.set_value(*edge, ret.get(*edge) + cur_weight(lag));
       }
     }
   } 
   return ret;
 } 
 
-void TaggerDual::solve_one(int sent_num, double & primal, double & dual, wvector & subgrad) {
+TagScores * TaggerDual::trellis_scores(int sent_num) {
+  if (!_use_trellis) return NULL;
+  TagScores & scores = _sentence_scores[sent_num];
+  if (!scores.ready) {
+    const Tagger & tagger = *_taggers[sent_num];
+    scores.trellis = TagTrellis::from_tagger(tagger, _base_weights);
+    if (scores.trellis != NULL) {
+      int num_states = scores.trellis->num_states();
+      scores.state_lag.resize(num_states, -1);
+      scores.penalty.resize(num_states, 0.0);
+      for (int state = 0; state < num_states; state++) {
+        const Hypernode & node = 
+          tagger.get_node(scores.trellis->state_node(state));
+        int lag;
+        if (tagger.node_has_tag(node) && 
+            tag_to_lag(sent_num, tagger.node_to_tag(node), lag)) {
+          scores.state_lag[state] = lag;
+          scores.aligned.push_back(state);
+        }
+      }
+    }
+    scores.ready = true;
+  }
+  if (scores.trellis == NULL) return NULL;
+  foreach (int state, scores.aligned) {
+    scores.penalty[state] = cur_weight(scores.state_lag[state]);
+  }
+  return &scores;
+}
+
+void TaggerDual::solve_one(int sent_num, int thread_id, double & primal, double & dual, wvector & subgrad) {
   const Tagger & tagger = *_taggers[sent_num];
+  TagScratch & scratch = _scratch[thread_id];
+
+  TagScores * scores = trellis_scores(sent_num);
+  if (scores != NULL) {
+    vector <int> & path = scratch.path;
+    dual = scores->trellis->viterbi(scores->penalty, &path);
+    primal = scores->trellis->path_cost(path);
+
+    wvector grad;
+    HNodes best_nodes;
+    foreach (int state, path) {
+      best_nodes.push_back(&tagger.get_node(scores->trellis->state_node(state)));
+      if (scores->state_lag[state] != -1) {
+        grad[scores->state_lag[state]] += 1;
+      }
+    }
+    subgrad = grad;
+    best_derivations[sent_num] = best_nodes;
+    return;
+  }
   
   HypergraphAlgorithms ha(tagger);
 
@@ -63,9 +113,11 @@ void TaggerDual::solve_one(int sent_num, double & primal, double & dual, wvector
   
   EdgeCache * final_weights = ha.combine_edge_weights(*edge_weights, added);
   
-  NodeCache score_memo_table(tagger.num_nodes()); 
+  NodeCache & score_memo_table = scratch.score_memo;
+  score_memo_table.reset(tagger.num_nodes());
       
-  NodeBackCache  back_memo_table(tagger.num_nodes());
+  NodeBackCache & back_memo_table = scratch.back_memo;
+  back_memo_table.reset(tagger.num_nodes());
 
   dual = ha.best_path(*final_weights, score_memo_table, back_memo_table);
       
@@ -82,3 +134,44 @@ void TaggerDual::solve_one(int sent_num, double & primal, double & dual, wvector
 
 
 
+
+bool TaggerDual::solve_one_smooth(int sent_num, int thread_id, double temperature, 
+                                  double & smooth_dual, wvector & smooth_grad) {
+  const Tagger & tagger = *_taggers[sent_num];
+
+  TagScores * scores = trellis_scores(sent_num);
+  if (scores != NULL) {
+    vector <double> & marginals = _scratch[thread_id].marginals;
+    smooth_dual = scores->trellis->marginals(scores->penalty, temperature, 
+                                             &marginals);
+    foreach (int state, scores->aligned) {
+      smooth_grad[scores->state_lag[state]] += marginals[state];
+    }
+    return true;
+  }
+  
+  HypergraphAlgorithms ha(tagger);
+
+  EdgeCache * edge_weights = ha.cache_edge_weights(_base_weights);    
+
+  EdgeCache added = build_tagger_constraint_vector(sent_num, tagger) ;
+  
+  EdgeCache * final_weights = ha.combine_edge_weights(*edge_weights, added);
+
+  NodeCache node_marginals(tagger.num_nodes());
+  EdgeCache edge_marginals(tagger.num_edges());
+  smooth_dual = ha.soft_marginals(*final_weights, temperature, 
+                                  node_marginals, edge_marginals);
+
+  // Expected version of build_tagger_subgradient.
+  foreach (HNode n, tagger.nodes()) {
+    if (!node_marginals.has_key(*n) || !tagger.node_has_tag(*n)) continue;
+    int lag;
+    if (tag_to_lag(sent_num, tagger.node_to_tag(*n), lag)) {
+      smooth_grad[lag] += node_marginals.get_value(*n);
+    }
+  }
+  delete edge_weights;
+  delete final_weights;
+  return true;
+}
@@ -1,10 +1,40 @@
 #ifndef TAGSOLVERS_H
 #define TAGSOLVERS_H
 #include "Tagger.h"
+#include "HypergraphAlgorithms.h"
+#include "TagTrellis.h"
 #include "TagConstraints.h"
 #include "DualDecomposition.h"
 #include "CorpusSolver.h"
 
+/**
+ * A sentence's trellis, built on its first solve, with the lagrange id
+ * of each state (or -1) and the states that have one.
+ */
+struct TagScores {
+  TagScores() : ready(false), trellis(NULL) {}
+  bool ready;
+
+  // NULL if the tagger's hypergraph is not a trellis.
+  TagTrellis * trellis;
+  vector <int> state_lag;
+  vector <int> aligned;
+
+  // Current dual penalty by state, only aligned states are non-zero.
+  vector <double> penalty;
+};
+
+/**
+ * Buffers a thread reuses for every sentence it solves.
+ */
+struct TagScratch {
+  TagScratch() : score_memo(0), back_memo(0) {}
+  vector <int> path;
+  vector <double> marginals;
+  NodeCache score_memo;
+  NodeBackCache back_memo;
+};
+
 class TaggerDual:public CorpusSolver {
  public:
  TaggerDual(vector < Tagger*> & taggers, 
@@ -14,18 +44,41 @@ class TaggerDual:public CorpusSolver {
   _taggers(taggers), 
   _base_weights(base_weights),
     _tag_consistency(consistency),
-    best_derivations(taggers.size())
+    best_derivations(taggers.size()),
+    _use_trellis(false),
+    _sentence_scores(taggers.size())
       { }
   vector< HNodes> best_derivations;
 
+  /** 
+   * Solve sentences with TagTrellis Viterbi and forward-backward
+   * instead of the hypergraph, where the lattice allows it.
+   */
+  void set_use_trellis(bool use_trellis) {
+    _use_trellis = use_trellis;
+  }
+
  protected:
   const vector < Tagger*> & _taggers;
   const wvector & _base_weights;
   const TagMrfAligner & _tag_consistency;
 
+  bool _use_trellis;
+  vector <TagScores> _sentence_scores;
+  vector <TagScratch> _scratch;
+
+  void set_up_scratch(int num_threads) {
+    _scratch.resize(num_threads);
+  }
+
+  // The trellis of a sentence, or NULL to use the hypergraph.
+  TagScores * trellis_scores(int sent_num);
+
   bool tag_to_lag(int sent_num, const Tag & t, int & lag );
 
-  void solve_one(int sent_num, double & primal, double & dual, wvector & subgrad) ;
+  void solve_one(int sent_num, int thread_id, double & primal, double & dual, wvector & subgrad) ;
+  bool solve_one_smooth(int sent_num, int thread_id, double temperature, 
+                        double & smooth_dual, wvector & smooth_grad);
   int lag_to_sent_num(int lag) ;
 
   wvector build_tagger_subgradient(int sent_num, const Tagger & tagger, 
@@ -0,0 +1,301 @@
+#include "TagTrellis.h"
+
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../common.h"
+
+// Smallest a[j] + b[j] over j < n.
+static inline double min_sum(const double * a, const double * b, int n) {
+  double best = INF;
+  int j = 0;
+#ifdef __SSE2__
+  __m128d best2 = _mm_set1_pd(INF);
+  for (; j + 2 <= n; j += 2) {
+    best2 = _mm_min_pd(best2, _mm_add_pd(_mm_loadu_pd(a + j),
+                                         _mm_loadu_pd(b + j)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, best2);
+  best = min(lanes[0], lanes[1]);
+#endif
+  for (; j < n; j++) {
+    best = min(best, a[j] + b[j]);
+  }
+  return best;
+}
+
+// min_sum, also setting arg to the first j that reaches it, or -1 if
+// every sum is at least INF.
+static inline double argmin_sum(const double * a, const double * b, int n,
+                                int * arg) {
+  double best = INF;
+  *arg = -1;
+  int j = 0;
+#ifdef __SSE2__
+  // Each lane keeps its own first minimum, indices held as doubles.
+  __m128d best2 = _mm_set1_pd(INF);
+  __m128d arg2 = _mm_set1_pd(-1.0);
+  __m128d index2 = _mm_set_pd(1.0, 0.0);
+  __m128d two = _mm_set1_pd(2.0);
+  for (; j + 2 <= n; j += 2) {
+    __m128d x = _mm_add_pd(_mm_loadu_pd(a + j), _mm_loadu_pd(b + j));
+    __m128d less = _mm_cmplt_pd(x, best2);
+    best2 = _mm_min_pd(best2, x);
+    arg2 = _mm_or_pd(_mm_and_pd(less, index2), _mm_andnot_pd(less, arg2));
+    index2 = _mm_add_pd(index2, two);
+  }
+  double lanes[2], args[2];
+  _mm_storeu_pd(lanes, best2);
+  _mm_storeu_pd(args, arg2);
+  // Lane 0 holds the even indices, so it wins ties unless it is unset.
+  int lane = (lanes[1] < lanes[0] ||
+              (lanes[1] == lanes[0] && args[1] >= 0.0 &&
+               (args[0] < 0.0 || args[1] < args[0]))) ? 1 : 0;
+  best = lanes[lane];
+  *arg = (int)args[lane];
+#endif
+  for (; j < n; j++) {
+    if (a[j] + b[j] < best) {
+      best = a[j] + b[j];
+      *arg = j;
+    }
+  }
+  return best;
+}
+
+#ifdef __SSE2__
+// c0 + c1 r
+static inline __m128d linear(double c0, double c1, __m128d r) {
+  return _mm_add_pd(_mm_set1_pd(c0), _mm_mul_pd(_mm_set1_pd(c1), r));
+}
+
+// exp(x) of two x <= 0, as 2^k exp(r) with x = k ln 2 + r and
+// |r| <= ln 2 / 2, where the degree 12 Taylor series is good to about
+// 1e-15. It is summed by Estrin's scheme so the multiplies don't wait
+// on each other. x is clamped at -708 so 2^k stays a normal double;
+// anything that small is lost in the sum anyway.
+static inline __m128d exp_nonpositive(__m128d x) {
+  x = _mm_max_pd(x, _mm_set1_pd(-708.0));
+  // Rounds to nearest under the default rounding mode.
+  __m128i k = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(1.4426950408889634)));
+  __m128d kd = _mm_cvtepi32_pd(k);
+  __m128d r = _mm_sub_pd(x, _mm_mul_pd(kd, _mm_set1_pd(6.93145751953125e-1)));
+  r = _mm_sub_pd(r, _mm_mul_pd(kd, _mm_set1_pd(1.42860682030941723212e-6)));
+
+  __m128d r2 = _mm_mul_pd(r, r);
+  __m128d r4 = _mm_mul_pd(r2, r2);
+  __m128d r8 = _mm_mul_pd(r4, r4);
+  __m128d p0 = _mm_add_pd(linear(1.0, 1.0, r),
+                          _mm_mul_pd(linear(1.0 / 2, 1.0 / 6, r), r2));
+  __m128d p4 = _mm_add_pd(linear(1.0 / 24, 1.0 / 120, r),
+                          _mm_mul_pd(linear(1.0 / 720, 1.0 / 5040, r), r2));
+  __m128d p8 = _mm_add_pd(
+      linear(1.0 / 40320, 1.0 / 362880, r),
+      _mm_mul_pd(linear(1.0 / 3628800, 1.0 / 39916800, r), r2));
+  p8 = _mm_add_pd(p8, _mm_mul_pd(_mm_set1_pd(1.0 / 479001600), r4));
+  __m128d p = _mm_add_pd(_mm_add_pd(p0, _mm_mul_pd(p4, r4)),
+                         _mm_mul_pd(p8, r8));
+
+  // 2^k from its exponent bits, k + 1023 is in [1, 1023].
+  __m128i e = _mm_add_epi32(k, _mm_set1_epi32(1023));
+  e = _mm_slli_epi64(_mm_unpacklo_epi32(e, _mm_setzero_si128()), 52);
+  return _mm_mul_pd(p, _mm_castsi128_pd(e));
+}
+#endif
+
+// -t log sum_j exp(-(a[j] + b[j]) / t), given their minimum m.
+static inline double soft_min_sum(const double * a, const double * b, int n,
+                                  double m, double t) {
+  double total = 0.0;
+  int j = 0;
+#ifdef __SSE2__
+  __m128d total2 = _mm_setzero_pd();
+  __m128d m2 = _mm_set1_pd(m);
+  __m128d scale2 = _mm_set1_pd(-1.0 / t);
+  for (; j + 2 <= n; j += 2) {
+    __m128d x = _mm_add_pd(_mm_loadu_pd(a + j), _mm_loadu_pd(b + j));
+    x = _mm_mul_pd(_mm_sub_pd(x, m2), scale2);
+    total2 = _mm_add_pd(total2, exp_nonpositive(x));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, total2);
+  total = lanes[0] + lanes[1];
+#endif
+  for (; j < n; j++) {
+    total += exp(-(a[j] + b[j] - m) / t);
+  }
+  return m - t * log(total);
+}
+
+TagTrellis::TagTrellis(const vector<int> & states_per_position,
+                       int final_state)
+    : _final_state(final_state) {
+  _start.push_back(0);
+  foreach (int n, states_per_position) {
+    _start.push_back(_start.back() + n);
+  }
+  _state_node.resize(num_states(), -1);
+  _trans.resize(num_positions());
+  _trans_t.resize(num_positions());
+  for (int pos = 1; pos < num_positions(); pos++) {
+    _trans[pos].resize(num_states(pos) * num_states(pos - 1), INF);
+    _trans_t[pos].resize(num_states(pos) * num_states(pos - 1), INF);
+  }
+}
+
+TagTrellis * TagTrellis::from_tagger(const Tagger & tagger,
+                                     const wvector & weights) {
+  // Tagged nodes sit at their word + 1, terminals at 0 and an untagged
+  // root after the last word.
+  int num_nodes = tagger.num_nodes();
+  int root = tagger.root().id();
+  vector<int> pos(num_nodes, -1);
+  int last = 0;
+  foreach (HNode node, tagger.nodes()) {
+    int id = node->id();
+    if (tagger.node_has_tag(*node)) {
+      if (node->is_terminal()) return NULL;
+      pos[id] = tagger.node_to_tag(*node).ind + 1;
+    } else if (node->is_terminal()) {
+      pos[id] = 0;
+    } else if (id == root) {
+      pos[id] = tagger.sent_length() + 1;
+    } else {
+      return NULL;
+    }
+    last = max(last, pos[id]);
+  }
+  if (pos[root] != last) return NULL;
+
+  vector<int> num_states(last + 1, 0);
+  vector<int> local(num_nodes);
+  for (int id = 0; id < num_nodes; id++) {
+    local[id] = num_states[pos[id]]++;
+  }
+  foreach (int n, num_states) {
+    if (n == 0) return NULL;
+  }
+
+  TagTrellis * trellis = NULL;
+  {
+    int final_state = 0;
+    for (int p = 0; p < last; p++) final_state += num_states[p];
+    trellis = new TagTrellis(num_states, final_state + local[root]);
+  }
+  for (int id = 0; id < num_nodes; id++) {
+    trellis->_state_node[trellis->state(pos[id], local[id])] = id;
+  }
+
+  foreach (HEdge edge, tagger.edges()) {
+    int head = edge->head_node().id();
+    if (edge->num_nodes() != 1 ||
+        pos[edge->tail_node(0).id()] != pos[head] - 1) {
+      delete trellis;
+      return NULL;
+    }
+    int tail = edge->tail_node(0).id();
+    double cost = edge->fvector().dot(weights);
+    double cur = trellis->transition(pos[head], local[head], local[tail]);
+    trellis->set_transition(pos[head], local[head], local[tail],
+                            min(cur, cost));
+  }
+  return trellis;
+}
+
+double TagTrellis::viterbi(const vector<double> & state_cost,
+                           vector<int> * path) const {
+  vector<double> score(num_states(), INF);
+  vector<int> back(num_states(), -1);
+  for (int s = 0; s < num_states(0); s++) {
+    score[s] = extra(state_cost, s);
+  }
+
+  for (int pos = 1; pos < num_positions(); pos++) {
+    int n = num_states(pos - 1);
+    const double * prev = &score[_start[pos - 1]];
+    for (int s = 0; s < num_states(pos); s++) {
+      int best_prev;
+      double best = argmin_sum(prev, &_trans[pos][s * n], n, &best_prev);
+      // Unreachable states stay at INF with no back pointer.
+      if (best >= INF / 2) continue;
+      int state = _start[pos] + s;
+      score[state] = best + extra(state_cost, state);
+      back[state] = best_prev;
+    }
+  }
+
+  // If the final state is unreachable, the path goes on through the
+  // first state wherever there is no back pointer.
+  path->resize(num_positions());
+  int state = _final_state;
+  for (int pos = num_positions() - 1; pos >= 0; pos--) {
+    (*path)[pos] = state;
+    if (pos > 0) state = _start[pos - 1] + max(back[state], 0);
+  }
+  return score[_final_state] >= INF / 2 ? INF : score[_final_state];
+}
+
+double TagTrellis::path_cost(const vector<int> & path) const {
+  double cost = 0.0;
+  for (int pos = 1; pos < num_positions(); pos++) {
+    cost += transition(pos, path[pos] - _start[pos],
+                       path[pos - 1] - _start[pos - 1]);
+  }
+  return cost;
+}
+
+double TagTrellis::marginals(const vector<double> & state_cost,
+                             double temperature,
+                             vector<double> * state_marginals) const {
+  int last = num_positions() - 1;
+
+  // Forward.
+  vector<double> alpha(num_states(), INF);
+  for (int s = 0; s < num_states(0); s++) {
+    alpha[s] = extra(state_cost, s);
+  }
+  for (int pos = 1; pos <= last; pos++) {
+    int n = num_states(pos - 1);
+    const double * prev = &alpha[_start[pos - 1]];
+    for (int s = 0; s < num_states(pos); s++) {
+      const double * row = &_trans[pos][s * n];
+      double m = min_sum(prev, row, n);
+      int state = _start[pos] + s;
+      alpha[state] = soft_min_sum(prev, row, n, m, temperature) +
+          extra(state_cost, state);
+    }
+  }
+
+  // Backward, from the final state only. beta excludes the state's
+  // own cost, which alpha already has.
+  vector<double> beta(num_states(), INF);
+  beta[_final_state] = 0.0;
+  vector<double> next_cost;
+  for (int pos = last; pos >= 1; pos--) {
+    int n = num_states(pos);
+    next_cost.resize(n);
+    for (int s = 0; s < n; s++) {
+      int state = _start[pos] + s;
+      next_cost[s] = beta[state] + extra(state_cost, state);
+    }
+    for (int p = 0; p < num_states(pos - 1); p++) {
+      const double * row = &_trans_t[pos][p * n];
+      double m = min_sum(&next_cost[0], row, n);
+      if (m > INF / 2) continue;
+      beta[_start[pos - 1] + p] =
+          soft_min_sum(&next_cost[0], row, n, m, temperature);
+    }
+  }
+
+  double z = alpha[_final_state];
+  state_marginals->resize(num_states());
+  for (int state = 0; state < num_states(); state++) {
+    double total = alpha[state] + beta[state];
+    (*state_marginals)[state] =
+        (total > INF / 2) ? 0.0 : exp(-(total - z) / temperature);
+  }
+  return z;
+}
@@ -0,0 +1,93 @@
+#ifndef TAGTRELLIS_H_
+#define TAGTRELLIS_H_
+
+#include <vector>
+#include "Tagger.h"
+using namespace std;
+
+/**
+ * A tagging problem as a trellis: positions in order, a few states at
+ * each (tags for a bigram tagger, tag pairs for a trigram one), and a
+ * dense states x previous states cost matrix between neighbouring
+ * positions. Position 0 holds the start states, which cost nothing.
+ *
+ * Viterbi and forward-backward take the min (or soft-min) over a
+ * contiguous row of states with SSE2 when available, instead of
+ * walking hypergraph nodes and edges.
+ */
+class TagTrellis {
+ public:
+  /**
+   * @param states_per_position The number of states at each position
+   * @param final_state The state (global id) the best path must end in
+   */
+  TagTrellis(const vector<int> & states_per_position, int final_state);
+
+  /**
+   * Reads the trellis off a Tagger whose edges each join a tagged node
+   * to one node at the previous word (the lattices convert_pos.py
+   * writes), with edge costs from weights. Each node becomes a state.
+   * @return NULL if the hypergraph does not have that shape
+   */
+  static TagTrellis * from_tagger(const Tagger & tagger,
+                                  const wvector & weights);
+
+  int num_positions() const { return _start.size() - 1; }
+  int num_states() const { return _start.back(); }
+  int num_states(int pos) const { return _start[pos + 1] - _start[pos]; }
+
+  // Global id of state s at pos.
+  int state(int pos, int s) const { return _start[pos] + s; }
+
+  // The hypergraph node of a state, for trellises from from_tagger.
+  int state_node(int state) const { return _state_node[state]; }
+
+  inline double transition(int pos, int s, int prev) const {
+    return _trans[pos][s * num_states(pos - 1) + prev];
+  }
+
+  inline void set_transition(int pos, int s, int prev, double cost) {
+    _trans[pos][s * num_states(pos - 1) + prev] = cost;
+    _trans_t[pos][prev * num_states(pos) + s] = cost;
+  }
+
+  /**
+   * Lowest cost path to the final state.
+   * @param state_cost Extra cost of each state by global id (or empty)
+   * @param path Set to the global state at each position
+   * @return The cost, including state_cost, or INF if the final state
+   *         can't be reached
+   */
+  double viterbi(const vector<double> & state_cost, vector<int> * path) const;
+
+  /**
+   * The cost of a path under the transitions alone.
+   */
+  double path_cost(const vector<int> & path) const;
+
+  /**
+   * Smoothed version of viterbi, as in
+   * HypergraphAlgorithms::soft_marginals.
+   * @param state_marginals Set to the posterior of each state
+   * @return The soft-min cost of reaching the final state
+   */
+  double marginals(const vector<double> & state_cost, double temperature,
+                   vector<double> * state_marginals) const;
+
+ private:
+  // Global id of the first state at each position, and one past the last.
+  vector<int> _start;
+  vector<int> _state_node;
+  int _final_state;
+
+  // Per position (from 1), row-major by current state, and transposed
+  // (row-major by previous state) for the backward pass.
+  vector<vector<double> > _trans;
+  vector<vector<double> > _trans_t;
+
+  inline double extra(const vector<double> & state_cost, int state) const {
+    return state_cost.empty() ? 0.0 : state_cost[state];
+  }
+};
+
+#endif
@@ -7,9 +7,15 @@ ostream& operator<<(ostream& output, const Tag& h) {
 
 
   void Tagger::set_up(const Hypergraph & hgraph) {
-    //_sent_length = hgraph.GetExtension(len) + 1; 
-    _sent_length = 150; 
-    //cout << "len " <<   _sent_length << endl;
+    _sent_length = 0;
+    num_tag = 0;
+    for (int i = 0; i < hgraph.node_size(); i++) {
+      const Hypergraph_Node & node = hgraph.node(i);
+      if (!node.GetExtension(has_tagging)) continue;
+      const Tagging & tagging_ext = node.GetExtension(tagging);
+      _sent_length = max(_sent_length, tagging_ext.ind() + 1);
+      num_tag = max(num_tag, tagging_ext.tag_id() + 1);
+    }
 
     int id_size = 0;
     for (int i=0; i < _sent_length; i++) {
@@ -21,15 +27,6 @@ ostream& operator<<(ostream& output, const Tag& h) {
       }
     }
 
-
-    int edge_count = 0;
-    for (int i = 0; i < hgraph.node_size(); i++) {
-      const Hypergraph_Node & node = hgraph.node(i);
-      for (int j=0; j < node.edge_size(); j++) {
-        const Hypergraph_Edge& edge = node.edge(j);
-        edge_count++;
-      }
-    }
     _tag_length = id_size + 1;
     _tag_map =  new Cache <Hypernode, Tag>(hgraph.node_size());
     _node_map = new Cache <Tag, HNodes  >(_tag_length);
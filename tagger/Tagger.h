@@ -45,12 +45,17 @@ private:
 
 ostream& operator<<(ostream& output, const Tag& h);
 
+/**
+ * A tagging hypergraph. The sentence length and the number of tags are
+ * read off the tagged nodes, so the tag tables are sized to the
+ * sentence.
+ */
 class Tagger : public Scarab::HG::HypergraphImpl {
  public:
   int num_tag;
   
-  Tagger(int num_tags_): 
-    num_tag(num_tags_) {
+  Tagger(): 
+    num_tag(0) {
   }
 
   ~Tagger() {
@@ -0,0 +1,153 @@
+#include <cpptest.h>
+#include <cpptest-suite.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "TagTrellis.h"
+#include "../common.h"
+using namespace Test;
+using namespace std;
+
+static double random_double() {
+  return rand() / (double)RAND_MAX;
+}
+
+class TrellisTestSuite : public Test::Suite
+{
+public:
+
+  TrellisTestSuite() {
+    TEST_ADD(TrellisTestSuite::viterbi_test);
+    TEST_ADD(TrellisTestSuite::marginals_test);
+  }
+
+private:
+  // A random trellis ending in one state, with some transitions left
+  // at INF, and random state costs. Small whole costs make many ties.
+  TagTrellis * random_trellis(bool ties, vector <double> * state_cost) {
+    int positions = 2 + rand() % 5;
+    vector <int> states(positions);
+    for (int pos = 0; pos < positions - 1; pos++) {
+      states[pos] = 1 + rand() % 5;
+    }
+    states[positions - 1] = 1;
+    int total = 0;
+    foreach (int n, states) total += n;
+    TagTrellis * trellis = new TagTrellis(states, total - 1);
+    for (int pos = 1; pos < positions; pos++) {
+      for (int s = 0; s < states[pos]; s++) {
+        for (int prev = 0; prev < states[pos - 1]; prev++) {
+          if (rand() % 4 == 0) continue;
+          trellis->set_transition(pos, s, prev, ties ? rand() % 3 :
+                                  random_double() * 10 - 5);
+        }
+      }
+    }
+    state_cost->resize(total);
+    for (int state = 0; state < total; state++) {
+      (*state_cost)[state] = ties ? 0.0 : random_double() * 4 - 2;
+    }
+    return trellis;
+  }
+
+  // Every path and its cost including state costs, skipping paths
+  // through a missing transition.
+  void all_paths(const TagTrellis & trellis,
+                 const vector <double> & state_cost,
+                 vector <vector <int> > * paths, vector <double> * costs) {
+    vector <int> local(trellis.num_positions(), 0);
+    vector <int> path(trellis.num_positions());
+    while (true) {
+      double cost = 0.0;
+      bool allowed = true;
+      for (int pos = 0; pos < trellis.num_positions(); pos++) {
+        path[pos] = trellis.state(pos, local[pos]);
+        cost += state_cost[path[pos]];
+        if (pos > 0 &&
+            trellis.transition(pos, local[pos], local[pos - 1]) > INF / 2) {
+          allowed = false;
+        }
+      }
+      if (allowed) {
+        paths->push_back(path);
+        costs->push_back(cost + trellis.path_cost(path));
+      }
+      int pos = 0;
+      while (pos < trellis.num_positions() &&
+             ++local[pos] == trellis.num_states(pos)) {
+        local[pos] = 0;
+        pos++;
+      }
+      if (pos == trellis.num_positions()) break;
+    }
+  }
+
+  void viterbi_test() {
+    srand(3);
+    for (int round = 0; round < 600; round++) {
+      vector <double> state_cost;
+      TagTrellis * trellis = random_trellis(round % 2 == 1, &state_cost);
+      vector <vector <int> > paths;
+      vector <double> costs;
+      all_paths(*trellis, state_cost, &paths, &costs);
+      vector <int> path;
+      double cost = trellis->viterbi(state_cost, &path);
+      TEST_ASSERT(path.size() == trellis->num_positions());
+      if (paths.empty()) {
+        TEST_ASSERT(cost == INF);
+        delete trellis;
+        continue;
+      }
+      double best = INF;
+      foreach (double c, costs) best = min(best, c);
+      TEST_ASSERT_DELTA(cost, best, 1e-6);
+      double path_cost = trellis->path_cost(path);
+      for (int pos = 0; pos < path.size(); pos++) {
+        path_cost += state_cost[path[pos]];
+      }
+      TEST_ASSERT_DELTA(path_cost, best, 1e-6);
+      delete trellis;
+    }
+  }
+
+  void marginals_test() {
+    srand(4);
+    for (int round = 0; round < 300; round++) {
+      vector <double> state_cost;
+      TagTrellis * trellis = random_trellis(false, &state_cost);
+      vector <vector <int> > paths;
+      vector <double> costs;
+      all_paths(*trellis, state_cost, &paths, &costs);
+      if (paths.empty()) {
+        delete trellis;
+        continue;
+      }
+      double temperature = 0.5 + random_double();
+      double best = INF;
+      foreach (double cost, costs) best = min(best, cost);
+      double total = 0.0;
+      vector <double> expected(trellis->num_states(), 0.0);
+      for (int p = 0; p < paths.size(); p++) {
+        double weight = exp(-(costs[p] - best) / temperature);
+        total += weight;
+        foreach (int state, paths[p]) expected[state] += weight;
+      }
+      double z = best - temperature * log(total);
+
+      vector <double> marginals;
+      TEST_ASSERT_DELTA(trellis->marginals(state_cost, temperature,
+                                           &marginals), z, 1e-6);
+      for (int state = 0; state < trellis->num_states(); state++) {
+        TEST_ASSERT_DELTA(marginals[state], expected[state] / total, 1e-6);
+      }
+      delete trellis;
+    }
+  }
+};
+
+
+int main(int argc, const char * argv[]) {
+  Test::TextOutput output(Test::TextOutput::Verbose);
+  TrellisTestSuite tts;
+  return tts.run(output) ? 0 : 1;
+}
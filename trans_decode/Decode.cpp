@@ -12,6 +12,7 @@
 #include "AStar.h"
 
 #include "SplitDecoder.h"
+#include "NGramCache.h"
 #include "LMNonLocal.h"
 #include "dual_nonlocal.h"
 #include "../common.h"
@@ -585,6 +586,7 @@ void Decode::solve(const SubgradState & cur_state,
     if (true) {
       LMNonLocal non_local(_forest, _lm, lm_weight(),
                            *cached_cube_words_, true);
+      non_local.set_lm_table(_lm_table);
       CubePruning p_temp(_forest, *_cached_weights,
                          non_local, 10, 3);
       bool success;
@@ -600,6 +602,7 @@ void Decode::solve(const SubgradState & cur_state,
                            _lagrange_weights,
                            _subproblem,
                            used_edges);
+    non_local.set_lm_table(_lm_table);
     CubePruning p(_forest, *total, non_local, cube, 3);
     double bound = min(cube_primal, cur_state.best_primal) + 0.01;
     cerr << "upper bound is: " << cur_state.best_dual << endl;
@@ -612,6 +615,8 @@ void Decode::solve(const SubgradState & cur_state,
     bool success;
     double v = p.parse(&success);
     cerr << "CubePruning " << v << " " << clock() - begin << endl;
+    cerr << "Internal cache " << non_local.cache_hits() << " hits "
+         << non_local.cache_misses() << " misses" << endl;
     if (success && abs(v) > 1e-4) {
       result.primal = v;
       if (p.is_exact()) {
@@ -747,13 +752,13 @@ double Decode::compute_primal(const HEdges used_edges,
   double lm_score =0.0;
   double primal2 = 0.0;
   for (uint i =0; i < used_strings.size()-2; i++) {
-    VocabIndex context[] = {lookup_string(used_strings[i+1]),
-                             lookup_string(used_strings[i]),
-                             Vocab_None};
+    LMWord w = lookup_string(used_strings[i+2]);
+    LMWord w1 = lookup_string(used_strings[i+1]);
+    LMWord w2 = lookup_string(used_strings[i]);
 
     if (DEBUG) {
       double lm_score = (lm_weight()) *
-          _lm.wordProb(lookup_string(used_strings[i+2]), context);
+          _lm_table->word_prob(w, w1, w2);
       cout << "PRIMAL " << used_strings[i] << " " <<  used_strings[i+1]
            << " " <<  used_strings[i+2] << " " << lm_score << endl;
 
@@ -768,7 +773,7 @@ double Decode::compute_primal(const HEdges used_edges,
       w += _subproblem->get_best_bigram_weight(mid, end, 1);
       primal2 += w + lm_score;
     }
-    lm_score += _lm.wordProb(lookup_string(used_strings[i+2]), context);
+    lm_score += _lm_table->word_prob(w, w1, w2);
   }
   if (DEBUG) {
     cout << "PRIMAL LMWEIGHT: " << (lm_weight()) *lm_score << endl;
@@ -780,32 +785,17 @@ double Decode::compute_primal(const HEdges used_edges,
 }
 
 int Decode::lookup_string(string word) {
-  int max = _lm.vocab.numWords();
-  int unk = _lm.vocab.getIndex(Vocab_Unknown);
-  int ind = _lm.vocab.getIndex(word.c_str());
-  if (ind == -1 || ind > max) {
-    return unk;
-  } else {
-    return ind;
-  }
+  return _lm.index(word);
 }
 
 void Decode::sync_lattice_lm() {
   _cached_words = new Cache <Graphnode, int> (_lattice.num_word_nodes);
 
-  int max = _lm.vocab.numWords();
-  int unk = _lm.vocab.getIndex(Vocab_Unknown);
-
   for (int n = 0; n < _lattice.num_word_nodes; n++) {
     if (!_lattice.is_word(n)) continue;
     string str = _lattice.get_word(n);
     _cached_word_str[str].push_back(n);
-    int ind = _lm.vocab.getIndex(str.c_str());
-    if (ind == -1 || ind > max) {
-      _cached_words->store[n] = unk;
-    } else {
-      _cached_words->store[n] = ind;
-    }
+    _cached_words->store[n] = _lm.index(str);
   }
 }
 
@@ -11,7 +11,7 @@
 #include <ForestLattice.h>
 #include <HypergraphAlgorithms.h>
 #include "svector.hpp"
-#include <Ngram.h>
+#include "LanguageModel.h"
 #include "dual_subproblem.h"
 #include "EdgeCache.h"
 #include "ExtendCKY.h"
@@ -33,7 +33,7 @@ class Decode: public SubgradientProducer {
   Decode(const Forest & forest,
          const ForestLattice & lattice,
          const wvector & weight,
-         NgramCache & lm)
+         const LanguageModel & lm)
     :_forest(forest),
       _lattice(lattice),
       _weight(weight),
@@ -45,7 +45,8 @@ class Decode: public SubgradientProducer {
     _gd.decompose();
 
     sync_lattice_lm();
-    _subproblem = new Subproblem(&lattice, & lm, &_gd, *_cached_words);
+    _lm_table = new LatticeLMTable(lattice, _gd, *_cached_words, lm);
+    _subproblem = new Subproblem(&lattice, _lm_table, &_gd, *_cached_words);
     _lagrange_weights = new svector<int, double>();
     _maintain_constraints = false;
     _is_stuck_round = 10000;
@@ -53,6 +54,7 @@ class Decode: public SubgradientProducer {
 
   ~Decode() {
     delete _subproblem;
+    delete _lm_table;
     /* delete _lagrange_weights; */
     delete _cached_words;
   }
@@ -72,6 +74,16 @@ class Decode: public SubgradientProducer {
     ilp_mode_ = ilp_mode;
   }
 
+  // LM scores of the sentence's lattice n-grams.
+  const LatticeLMTable & lm_table() const {
+    return *_lm_table;
+  }
+
+  // Threads for the trigram projection pairs.
+  void set_num_threads(int num_threads) {
+    _subproblem->set_num_threads(num_threads);
+  }
+
  private:
   void debug(int start_from,
              int dual_mid,
@@ -96,7 +108,8 @@ class Decode: public SubgradientProducer {
   const ForestLattice & _lattice;
   const wvector & _weight;
   wvector * _lagrange_weights;
-  NgramCache & _lm;
+  const LanguageModel & _lm;
+  LatticeLMTable * _lm_table;
   GraphDecompose _gd;
   Cache<Hyperedge, double> * _cached_weights;
   Cache<Graphnode, int> * _cached_words;
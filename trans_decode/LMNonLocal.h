@@ -0,0 +1,145 @@
+#ifndef LMNONLOCAL_H_
+#define LMNONLOCAL_H_
+
+#include <vector>
+
+#include "CubePruning.h"
+#include "EdgeCache.h"
+#include "Hypergraph.h"
+#include "Forest.h"
+#include "LanguageModel.h"
+#include "LatticeLMTable.h"
+#include "../common.h"
+
+using namespace std;
+
+// Build a cache mapping each word node to its LM index.
+inline Cache<Hypernode, int> *cache_word_nodes(const LanguageModel & lm,
+                                               const Forest & forest) {
+  Cache<Hypernode, int> *words =
+      new Cache<Hypernode, int>(forest.num_nodes());
+  foreach (HNode hnode, forest.nodes()) {
+    const ForestNode & node = *(static_cast<const ForestNode*>(hnode));
+    if (node.is_word()) {
+      words->set_value(node, lm.index(node.word()));
+    }
+  }
+  return words;
+}
+
+/**
+ * Trigram language model scorer for cube pruning. Derivations are
+ * the forest word nodes of a hypothesis and the signature is its two
+ * boundary words on each side.
+ *
+ * The model is only read through const calls, so several scorers
+ * (and threads) can share one loaded model.
+ */
+class LMNonLocal: public NonLocal {
+ public:
+  /**
+   * @param lm_weight Weight on the log10 LM score (a cost)
+   * @param word_cache LM index of each forest word node
+   * @param full_derivation Keep every word of a derivation rather than
+   *        just the boundary words (needed to print the translation)
+   */
+  LMNonLocal(const HGraph & forest,
+             const LanguageModel & lm,
+             double lm_weight,
+             const Cache <Hypernode, int> & word_cache,
+             bool full_derivation)
+      : _forest(forest),
+        _lm(lm),
+        _lm_weight(lm_weight),
+        _word_cache(word_cache),
+        _full_derivation(full_derivation),
+        _lm_table(NULL) {}
+
+  // Read trigram scores from the sentence's table instead of the model.
+  void set_lm_table(const LatticeLMTable * lm_table) {
+    _lm_table = lm_table;
+  }
+
+  // The LM index of a forest word node.
+  inline int index(int node) const {
+    return _word_cache.store[node];
+  }
+
+  // Weighted score of word w given the previous words w1 then w2.
+  inline double trigram(int w, int w1, int w2) const {
+    if (_lm_table != NULL) {
+      return _lm_weight * _lm_table->word_prob(w, w1, w2);
+    }
+    LMWord context[] = {w1, w2, kLMNone};
+    return _lm_weight * _lm.word_prob(w, context);
+  }
+
+  bool compute(const Hyperedge &edge,
+               int edge_pos,
+               double bound,
+               const vector<const vector<int> *> &subder,
+               double &score,
+               vector <int> &full_derivation,
+               Sig &sig) const {
+    score = 0.0;
+    full_derivation.clear();
+    sig.clear();
+
+    // A word is new context for the LM if it was one of the first
+    // two words of its sub-derivation.
+    int words = 0;
+    for (unsigned int i = 0; i < subder.size(); ++i) {
+      const vector<int> &sub = *subder[i];
+      for (unsigned int s = 0; s < sub.size(); ++s) {
+        int size = full_derivation.size();
+        if (s < 2 && words >= 2) {
+          score += trigram(index(sub[s]),
+                           index(full_derivation[size - 1]),
+                           index(full_derivation[size - 2]));
+        }
+        full_derivation.push_back(sub[s]);
+        words++;
+      }
+    }
+
+    int size = full_derivation.size();
+    assert(size > 0);
+    if (!_full_derivation && size > 4) {
+      full_derivation[2] = full_derivation[size - 2];
+      full_derivation[3] = full_derivation[size - 1];
+      full_derivation.resize(4);
+      size = 4;
+    }
+
+    // New signature is w_0 w_n w_1 w_{n-1}.
+    sig.push_back(index(full_derivation[0]));
+    sig.push_back(index(full_derivation[size - 1]));
+    if (size != 1) {
+      sig.push_back(index(full_derivation[1]));
+      sig.push_back(index(full_derivation[size - 2]));
+    }
+    return score <= bound;
+  }
+
+  // Initialize the hypothesis for leaf nodes.
+  Hyp initialize(const Hypernode &node) const {
+    assert(node.is_terminal());
+    vector<int> signature;
+    signature.push_back(index(node.id()));
+    signature.push_back(index(node.id()));
+
+    vector<int> derivation;
+    derivation.push_back(node.id());
+    return Hyp(0.0, 0.0, signature, derivation, vector<int>());
+  }
+
+ protected:
+  const HGraph & _forest;
+  const LanguageModel & _lm;
+  const double _lm_weight;
+  const Cache <Hypernode, int> & _word_cache;
+  const bool _full_derivation;
+  const LatticeLMTable * _lm_table;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <iostream>
+
+#include "LatticeLMTable.h"
+#include "../common.h"
+
+using namespace std;
+
+// Each LM index gets 21 bits of the key.
+static const int kKeyBits = 21;
+
+static bool same_key(const pair<int64_t, float> & a,
+                     const pair<int64_t, float> & b) {
+  return a.first == b.first;
+}
+
+int64_t LatticeLMTable::trigram_key(LMWord w, LMWord w1, LMWord w2) {
+  const LMWord limit = 1 << kKeyBits;
+  if (w >= limit || w1 >= limit || w2 >= limit) return -1;
+  return ((int64_t)w << (2 * kKeyBits)) | ((int64_t)w1 << kKeyBits) | w2;
+}
+
+LatticeLMTable::LatticeLMTable(const ForestLattice & lattice,
+                               const GraphDecompose & gd,
+                               const Cache<Graphnode, int> & words,
+                               const LanguageModel & lm)
+    : _lm(lm), _model_calls(0), _lookups(0), _misses(0) {
+  int num_word_nodes = lattice.num_word_nodes;
+  const vector<vector<int> > & forward = gd.forward_bigrams;
+
+  // Lay out the flat tables.
+  _bigram_start.resize(num_word_nodes + 1);
+  _bigram_start[0] = 0;
+  for (int w1 = 0; w1 < num_word_nodes; w1++) {
+    _bigram_start[w1 + 1] = _bigram_start[w1] + forward[w1].size();
+  }
+  int num_bigrams = _bigram_start[num_word_nodes];
+  _cont_start.resize(num_bigrams + 1);
+  _cont_start[0] = 0;
+  for (int w1 = 0; w1 < num_word_nodes; w1++) {
+    for (unsigned int i = 0; i < forward[w1].size(); i++) {
+      int b = _bigram_start[w1] + i;
+      _cont_start[b + 1] = _cont_start[b] + forward[forward[w1][i]].size();
+    }
+  }
+  _bigram_prob.resize(num_bigrams, kLMLogZero);
+  _bigram_bow.resize(num_bigrams, 0.0);
+  _bigram_length.resize(num_bigrams, 0);
+  _trigram_prob.resize(_cont_start[num_bigrams], kLMLogZero);
+
+  // Bigrams.
+  for (int w1 = 0; w1 < num_word_nodes; w1++) {
+    if (!lattice.is_word(w1)) continue;
+    LMWord lm1 = words.store[w1];
+    for (unsigned int i = 0; i < forward[w1].size(); i++) {
+      int b = _bigram_start[w1] + i;
+      LMWord lm2 = words.store[forward[w1][i]];
+      LMWord context[] = {lm2, kLMNone};
+      LMWord unk_context[] = {lm2, lm.unknown(), kLMNone};
+      LMWord bow_context[] = {lm1, lm2, kLMNone};
+      _bigram_length[b] = lm.context_length(lm1, context);
+      _bigram_prob[b] = lm.word_prob(lm1, unk_context);
+      _bigram_bow[b] = lm.context_bow(bow_context, 1);
+      _model_calls += 3;
+    }
+  }
+
+  // Trigrams. Only contexts the LM has explicitly need a lookup, the
+  // rest back off to the bigram scores above.
+  for (int w1 = 0; w1 < num_word_nodes; w1++) {
+    if (!lattice.is_word(w1)) continue;
+    LMWord lm1 = words.store[w1];
+    for (unsigned int i = 0; i < forward[w1].size(); i++) {
+      int w2 = forward[w1][i];
+      int b = _bigram_start[w1] + i;
+      LMWord lm2 = words.store[w2];
+
+      LMWord context[] = {lm2, kLMNone};
+      LMState state;
+      lm.word_prob_prime(lm1, context, state);
+      _model_calls++;
+
+      for (unsigned int j = 0; j < forward[w2].size(); j++) {
+        int b2 = _bigram_start[w2] + j;
+        LMWord lm3 = words.store[forward[w2][j]];
+        float prob;
+        if (_bigram_length[b] && _bigram_length[b2] &&
+            lm.has_next(state, lm3)) {
+          LMWord context[] = {lm2, lm3, kLMNone};
+          prob = lm.word_prob_from_state(lm1, context, state);
+          _model_calls++;
+        } else {
+          prob = _bigram_bow[b2] + _bigram_prob[b];
+        }
+        _trigram_prob[_cont_start[b] + j] = prob;
+
+        int64_t key = trigram_key(lm1, lm2, lm3);
+        if (key != -1) {
+          _by_key.push_back(pair<int64_t, float>(key, prob));
+        }
+      }
+    }
+  }
+  sort(_by_key.begin(), _by_key.end());
+  _by_key.erase(unique(_by_key.begin(), _by_key.end(), same_key),
+                _by_key.end());
+}
+
+float LatticeLMTable::word_prob(LMWord w, LMWord w1, LMWord w2) const {
+  __sync_fetch_and_add(&_lookups, 1);
+  int64_t key = trigram_key(w, w1, w2);
+  if (key != -1) {
+    vector<pair<int64_t, float> >::const_iterator found =
+        lower_bound(_by_key.begin(), _by_key.end(),
+                    pair<int64_t, float>(key, -INF));
+    if (found != _by_key.end() && found->first == key) {
+      return found->second;
+    }
+  }
+  __sync_fetch_and_add(&_misses, 1);
+  LMWord context[] = {w1, w2, kLMNone};
+  return _lm.word_prob(w, context);
+}
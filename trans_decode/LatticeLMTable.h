@@ -0,0 +1,88 @@
+#ifndef LATTICELMTABLE_H_
+#define LATTICELMTABLE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "ForestLattice.h"
+#include "GraphDecompose.h"
+#include "EdgeCache.h"
+#include "LanguageModel.h"
+
+using namespace std;
+
+/**
+ * Per sentence table of the LM scores of every n-gram the lattice can
+ * produce. Built in one pass over GraphDecompose::forward_bigrams, so
+ * the dual subproblem, cube pruning and the primal check all read the
+ * same scores instead of each going back to the model.
+ *
+ * The lattice is read in reverse: the bigram (w1, i) is w1 preceded by
+ * its i'th forward bigram w2, and its continuations (w1, w2, w3) are
+ * w2's forward bigrams w3. Bigram (w1, i) has id bigram_start()[w1] + i
+ * and continuation j of bigram b has id cont_start()[b] + j.
+ *
+ * All scores are unweighted log10 values. The table is read only after
+ * construction and can be shared between threads.
+ */
+class LatticeLMTable {
+ public:
+  /**
+   * @param words LM index of each lattice word node
+   */
+  LatticeLMTable(const ForestLattice & lattice,
+                 const GraphDecompose & gd,
+                 const Cache<Graphnode, int> & words,
+                 const LanguageModel & lm);
+
+  const vector<int> & bigram_start() const { return _bigram_start; }
+  const vector<int> & cont_start() const { return _cont_start; }
+
+  // log10 P(w1 | w2) of bigram b.
+  inline float bigram_prob(int b) const { return _bigram_prob[b]; }
+
+  // Backoff weight for dropping w2 from the context (w1 w2).
+  inline float bigram_bow(int b) const { return _bigram_bow[b]; }
+
+  // Context length the LM has for w1 after w2 (0 or 1).
+  inline int bigram_length(int b) const { return _bigram_length[b]; }
+
+  // log10 P(w1 | w2 w3) of continuation c.
+  inline float trigram_prob(int c) const { return _trigram_prob[c]; }
+
+  /**
+   * log10 P(w | w1 w2) by LM index, w1 the word just before w. Falls
+   * back to the model for trigrams the lattice cannot produce.
+   */
+  float word_prob(LMWord w, LMWord w1, LMWord w2) const;
+
+  // Model calls made to build the table.
+  long model_calls() const { return _model_calls; }
+
+  // Calls to word_prob, and how many of them missed the table.
+  long lookups() const { return _lookups; }
+  long misses() const { return _misses; }
+
+ private:
+  // Three LM indices packed in 64 bits, or -1 if they do not fit.
+  static int64_t trigram_key(LMWord w, LMWord w1, LMWord w2);
+
+  const LanguageModel & _lm;
+
+  vector<int> _bigram_start;
+  vector<int> _cont_start;
+
+  vector<float> _bigram_prob;
+  vector<float> _bigram_bow;
+  vector<unsigned char> _bigram_length;
+  vector<float> _trigram_prob;
+
+  // Sorted (key, score) of every distinct trigram, for word_prob.
+  vector<pair<int64_t, float> > _by_key;
+
+  long _model_calls;
+  mutable long _lookups;
+  mutable long _misses;
+};
+
+#endif
@@ -12,11 +12,12 @@ static const bool lm_weight_dummy =
 
 // assume we are at a point in the trie, just look one step more
 LogP NgramCache::wordProbFromCache(VocabIndex word,
-                                   const VocabIndex *context) {
-  LogP cur_logp = logp;
-  LogP cur_bow = bow;
+                                   const VocabIndex *context,
+                                   const LMState & state) const {
+  LogP cur_logp = state.logp;
+  LogP cur_bow = state.bow;
 
-  BOtrie *next = trieNode->findTrie(context[i]);
+  BOtrie *next = state_node(state)->findTrie(context[state.length]);
   if (next) {
     /*
      * Accumulate backoff weights
@@ -39,14 +40,14 @@ LogP NgramCache::wordProbFromCache(VocabIndex word,
 }
 
 LogP NgramCache::wordProbPrimeCache(VocabIndex word,
-                                    const VocabIndex *context) {
+                                    const VocabIndex *context,
+                                    LMState & state) const {
   // Reset to original values
-  logp = LogP_Zero;
-  bow = LogP_One;
-  found = 0;
+  LogP logp = LogP_Zero;
+  LogP bow = LogP_One;
 
-  trieNode = &contexts;
-  i = 0;
+  BOtrie *trieNode = const_cast<BOtrie *>(&contexts);
+  unsigned i = 0;
 
   do {
     LogP *prob = trieNode->value().probs.find(word);
@@ -58,7 +59,6 @@ LogP NgramCache::wordProbPrimeCache(VocabIndex word,
        */
       logp = *prob;
       bow = LogP_One;
-      found = i + 1;
     }
 
     if  ( context[i] == Vocab_None) break;
@@ -76,6 +76,10 @@ LogP NgramCache::wordProbPrimeCache(VocabIndex word,
     }
   } while (1);
 
+  state.node = reinterpret_cast<intptr_t>(trieNode);
+  state.length = i;
+  state.logp = logp;
+  state.bow = bow;
   return logp + bow;
 }
 
@@ -95,6 +99,16 @@ NgramCache * cmd_lm()  {
   return load_ngram_cache(FLAGS_lm_file.c_str());
 }
 
+LanguageModel * load_language_model(const char * filename) {
+  LanguageModel * lm = load_binary_lm(filename);
+  if (lm != NULL) return lm;
+  return new SriLM(*load_ngram_cache(filename));
+}
+
+LanguageModel * cmd_language_model() {
+  return load_language_model(FLAGS_lm_file.c_str());
+}
+
 double lm_weight() {
   return FLAGS_lm_weight;
 }
@@ -3,6 +3,7 @@
 
 #include <Ngram.h>
 #include <Prob.h>
+#include "LanguageModel.h"
 
 class NgramCache : public Ngram {
  public:
@@ -10,27 +11,86 @@ class NgramCache : public Ngram {
     :Ngram(v, i) {}
 
 
-    bool hasNext(const VocabIndex next) {
-      return static_cast<bool>(trieNode->findTrie(next));
+    // The trie cursor is kept in the caller's state, so these only
+    // read the model.
+    bool hasNext(const LMState & state, const VocabIndex next) const {
+      return static_cast<bool>(state_node(state)->findTrie(next));
     }
 
-
-    LogP wordProbPrimeCache(VocabIndex word, const VocabIndex *context);
-    LogP wordProbFromCache(VocabIndex word, const VocabIndex *context);
+    LogP wordProbPrimeCache(VocabIndex word, const VocabIndex *context,
+                            LMState & state) const;
+    LogP wordProbFromCache(VocabIndex word, const VocabIndex *context,
+                           const LMState & state) const;
  private:
-    LogP logp;
-    LogP bow;
-    unsigned found;
-
-    BOtrie *trieNode;
-    unsigned i;
+    // SRILM's trie accessors are not const, though lookups only read.
+    static BOtrie * state_node(const LMState & state) {
+      return reinterpret_cast<BOtrie *>(state.node);
+    }
 };
 
 
 
+/**
+ * LanguageModel interface over an SRILM model. SRILM's API is not
+ * const, but the lookups used here only read the model.
+ */
+class SriLM : public LanguageModel {
+ public:
+  SriLM(NgramCache & lm): _lm(lm) {}
+
+  int order() const { return _lm.setorder(); }
+
+  int vocab_size() const { return _lm.vocab.numWords(); }
+
+  LMWord index(const string & word) const {
+    VocabIndex ind = _lm.vocab.getIndex(word.c_str());
+    return (ind == Vocab_None) ? unknown() : ind;
+  }
+
+  LMWord unknown() const { return _lm.vocab.getIndex(Vocab_Unknown); }
+
+  float word_prob(LMWord word, const LMWord * context) const {
+    return _lm.wordProb(word, context);
+  }
+
+  float context_bow(const LMWord * context, unsigned length) const {
+    return _lm.contextBOW(context, length);
+  }
+
+  unsigned context_length(LMWord word, const LMWord * context) const {
+    unsigned length;
+    _lm.contextID(word, context, length);
+    return length;
+  }
+
+  float word_prob_prime(LMWord word, const LMWord * context,
+                        LMState & state) const {
+    return _lm.wordProbPrimeCache(word, context, state);
+  }
+
+  bool has_next(const LMState & state, LMWord next) const {
+    return _lm.hasNext(state, next);
+  }
+
+  float word_prob_from_state(LMWord word, const LMWord * context,
+                             const LMState & state) const {
+    return _lm.wordProbFromCache(word, context, state);
+  }
+
+ private:
+  NgramCache & _lm;
+};
+
 // helper functions
 
 NgramCache * load_ngram_cache(const char * filename);
 NgramCache * cmd_lm();
 double lm_weight();
+
+/**
+ * Load a language model, the binary format if the file is one
+ * (see lm/CompactLM.h) and an SRILM ARPA model otherwise.
+ */
+LanguageModel * load_language_model(const char * filename);
+LanguageModel * cmd_language_model();
 #endif
@@ -10,7 +10,7 @@
 #include "CubePruning.h"
 #include "EdgeCache.h"
 #include "Hypergraph.h"
-#include <Ngram.h>
+#include "LanguageModel.h"
 #include "ForestLattice.h"
 #include "LMNonLocal.h"
 
@@ -21,7 +21,7 @@ using namespace std;
 class DualNonLocal: public LMNonLocal {
  public:
   DualNonLocal(const HGraph & forest,
-              Ngram & lm,
+              const LanguageModel & lm,
               double lm_weight,
               const Cache <Hypernode, int> & word_cache,
               const Cache <Hypernode, double> & best_trigram,
@@ -39,13 +39,32 @@ class DualNonLocal: public LMNonLocal {
     subproblem_(subproblem),
     used_edges_(used_edges),
     edge_lattice_cache_(forest.edges().size()),
-    tmp_derivation_(1000) {
+    tmp_derivation_(1000),
+    cache_hits_(0),
+    cache_misses_(0) {
     bigram_score_.resize(lattice_.get_graph().num_edges());
     trigram_score_.resize(lattice_.get_graph().num_edges());
     foreach (HEdge edge, forest.edges()) {
       edge_lattice_cache_.has_value[edge->id()] = true;
       get_lattice(*edge, &edge_lattice_cache_.store[edge->id()]);
     }
+
+    // Dual sums of each lattice segment, read once per edge instead of
+    // per combination.
+    segment_bigram_.resize(forest.edges().size());
+    segment_trigram_.resize(forest.edges().size());
+    foreach (HEdge edge, forest.edges()) {
+      const vector<vector<int> > &lat_ids =
+          edge_lattice_cache_.store[edge->id()];
+      segment_bigram_[edge->id()].resize(lat_ids.size(), 0.0);
+      segment_trigram_[edge->id()].resize(lat_ids.size(), 0.0);
+      for (int i = 0; i < lat_ids.size(); ++i) {
+        foreach (int lat_id, lat_ids[i]) {
+          segment_bigram_[edge->id()][i] += bigram_score_[lat_id];
+          segment_trigram_[edge->id()][i] += trigram_score_[lat_id];
+        }
+      }
+    }
   }
 
   int index_cache(int i) const {
@@ -99,17 +118,51 @@ class DualNonLocal: public LMNonLocal {
     assert(ret->size() == edge.tail_nodes().size() + 1);
   }
 
-  double internal_score(const vector<const vector<int> *> &subder,
-                        int edge_pos,
-                        const vector<vector<int> > &lat_ids,
-                        int &tmp_derivation_size,
-                        double &running_bigram_score,
-                        double &running_pretrigram_score,
-                        double &score) const {
+  // The parts of a sub-derivation its score depends on: everything up
+  // to its second word and from its second to last word. The words in
+  // between only reset the running scores.
+  void append_boundary(const vector<int> &sub, vector<int> *key) const {
+    int second = sub.size() - 1, second_last = 0;
+    int words_seen = 0;
+    for (int i = 0; i < sub.size(); ++i) {
+      if (lattice_.is_word(sub[i]) && ++words_seen == 2) {
+        second = i;
+        break;
+      }
+    }
+    words_seen = 0;
+    for (int i = sub.size() - 1; i >= 0; --i) {
+      if (lattice_.is_word(sub[i]) && ++words_seen == 2) {
+        second_last = i;
+        break;
+      }
+    }
+    key->push_back(sub.size());
+    if (second_last <= second + 1) {
+      key->insert(key->end(), sub.begin(), sub.end());
+    } else {
+      key->insert(key->end(), sub.begin(), sub.begin() + second + 1);
+      key->insert(key->end(), sub.begin() + second_last, sub.end());
+    }
+  }
+
+  // Score of the LM fix ups where the sub-derivations meet on this
+  // edge, less the dual scores they replace.
+  double internal_score(const Hyperedge &edge,
+                        const vector<const vector<int> *> &subder,
+                        int edge_pos) const {
+    const vector<double> &segment_bigram = segment_bigram_[edge.id()];
+    const vector<double> &segment_trigram = segment_trigram_[edge.id()];
+    double score = 0.0;
+    double running_bigram_score = 0.0;
+    double running_pretrigram_score = 0.0;
+    if (edge_pos <= 1) {
+      running_bigram_score = segment_bigram[0];
+      running_pretrigram_score = segment_trigram[0];
+    }
     int word_number = 0;
     int last_word;
     int last_word2;
-    bool last_was_word = false;
     double running_trigram_score = 0.0;
     for (int subder_index = 0; subder_index < subder.size();
          ++subder_index) {
@@ -166,9 +219,6 @@ class DualNonLocal: public LMNonLocal {
                      << " " << inner_lm_score << "}";
               }
               score -= drop;
-              /* if (!(b <= a + 0.01)) { */
-              /*   fail = true; */
-              /* } */
             }
           }
           last_word2 = last_word;
@@ -182,10 +232,6 @@ class DualNonLocal: public LMNonLocal {
           }
         }
 
-        tmp_derivation_[tmp_derivation_size] = sub[s];
-        tmp_derivation_size++;
-
-
         running_bigram_score +=  bigram_score_[sub[s]];
         running_pretrigram_score += trigram_score_[sub[s]];
         if (DEBUG_NONLOCAL) {
@@ -197,76 +243,68 @@ class DualNonLocal: public LMNonLocal {
         cerr << " ] ";
       }
       if (subder_index < subder.size() - 1) {
-        for (int i = 0; i < lat_ids[subder_index + edge_pos].size(); ++i) {
-          int lat_id = lat_ids[subder_index + edge_pos][i];
-          running_bigram_score += bigram_score_[lat_id];
-          running_pretrigram_score += trigram_score_[lat_id];
-          if (DEBUG_NONLOCAL) {
-            cerr << lattice_._edge_label_by_nodes[lat_id] << " ";
-            cerr << "(" << (*duals_)[lat_id] << "/"
-                 << (*duals_)[lat_id + GRAMSPLIT] << ")";
-          }
-          tmp_derivation_[tmp_derivation_size] = lat_id;
-          tmp_derivation_size++;
-        }
+        running_bigram_score += segment_bigram[subder_index + edge_pos];
+        running_pretrigram_score += segment_trigram[subder_index + edge_pos];
       }
     }
+    return score;
+  }
+
+  void append_lattice(const vector<int> &lat_ids,
+                      int &tmp_derivation_size) const {
+    foreach (int lat_id, lat_ids) {
+      tmp_derivation_[tmp_derivation_size] = lat_id;
+      tmp_derivation_size++;
+    }
   }
 
   double score_and_compute(const Hyperedge &edge,
                            int edge_pos,
                            const vector<const vector<int> *> &subder,
                            int &tmp_derivation_size) const {
-    double score = 0.0;
     tmp_derivation_size = 0;
     const vector<vector<int> > &lat_ids =
       edge_lattice_cache_.get_value(edge);
+    int size = edge.tail_nodes().size();
 
-    double running_pretrigram_score = 0.0,
-      running_bigram_score = 0.0,
-      running_trigram_score = 0.0;
-    bool fail = false;
-
-    // First edge part.
+    // The derivation is the edge's lattice segments interleaved with
+    // the sub-derivations.
     if (edge_pos <= 1) {
-      foreach (int lat_id, lat_ids[0]) {
-        running_bigram_score += bigram_score_[lat_id];
-        running_pretrigram_score += trigram_score_[lat_id];
-        if (DEBUG_NONLOCAL) {
-          cerr << lattice_._edge_label_by_nodes[lat_id] << " ";
-          cerr << "(" << (*duals_)[lat_id] << "/"
-               << (*duals_)[lat_id + GRAMSPLIT] << ")";
-        }
-        tmp_derivation_[tmp_derivation_size] = lat_id;
-        tmp_derivation_size++;
+      append_lattice(lat_ids[0], tmp_derivation_size);
+    }
+    for (int i = 0; i < subder.size(); ++i) {
+      append_lattice(*subder[i], tmp_derivation_size);
+      if (i < subder.size() - 1) {
+        append_lattice(lat_ids[i + edge_pos], tmp_derivation_size);
       }
     }
-    internal_score(subder,
-                   edge_pos,
-                   lat_ids,
-                   tmp_derivation_size,
-                   running_bigram_score,
-                   running_pretrigram_score,
-                   score);
-    int size = edge.tail_nodes().size();
     if (edge_pos == size - 1) {
-      foreach (int lat_id, lat_ids[size]) {
-        running_bigram_score += bigram_score_[lat_id];
-        running_pretrigram_score += trigram_score_[lat_id];
-        if (DEBUG_NONLOCAL) {
-          cerr << lattice_._edge_label_by_nodes[lat_id] << " ";
-          cerr << "(" << (*duals_)[lat_id] << "/"
-               << (*duals_)[lat_id + GRAMSPLIT] << ")";
-        }
-        tmp_derivation_[tmp_derivation_size] = lat_id;
-        tmp_derivation_size++;
-      }
+      append_lattice(lat_ids[size], tmp_derivation_size);
     }
-    assert(!fail);
+
+    // The score only depends on the boundaries of the sub-derivations,
+    // which recur across cube cells.
+    vector<int> key;
+    key.push_back(edge.id());
+    key.push_back(edge_pos);
+    for (int i = 0; i < subder.size(); ++i) {
+      append_boundary(*subder[i], &key);
+    }
+    map<vector<int>, double>::const_iterator found =
+        internal_cache_.find(key);
+    if (found != internal_cache_.end()) {
+      cache_hits_++;
+      return found->second;
+    }
+    cache_misses_++;
+    double score = internal_score(edge, subder, edge_pos);
+    internal_cache_[key] = score;
     return score;
   }
 
-
+  // Lookups of the internal score cache that hit and missed.
+  long cache_hits() const { return cache_hits_; }
+  long cache_misses() const { return cache_misses_; }
 
   // Compute takes the hyperedge and sub-derivations to combine.
   // Returns the new score, derivation and signature.
@@ -383,6 +421,16 @@ class DualNonLocal: public LMNonLocal {
 
   mutable vector<double> bigram_score_;
   mutable vector<double> trigram_score_;
+
+  vector<vector<double> > segment_bigram_;
+  vector<vector<double> > segment_trigram_;
+
+  // Internal score by edge id, edge position and the boundaries of the
+  // sub-derivations. The duals and the subproblem are fixed for the
+  // life of this object, so entries never go stale.
+  mutable map<vector<int>, double> internal_cache_;
+  mutable long cache_hits_;
+  mutable long cache_misses_;
 };
 
 #endif
@@ -4,6 +4,9 @@
 #include <vector>
 #include <bitset>
 #include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "GraphDecompose.h"
 #include "dual_subproblem.h"
@@ -19,18 +22,19 @@ using namespace std;
 
 
 Subproblem::Subproblem(const ForestLattice *g,
-                       NgramCache *lm_in,
+                       const LatticeLMTable *lm_table_in,
                        const GraphDecompose *gd_in,
                        const Cache<Graphnode, int> &word_node_cache_in) :
   graph(g),
-  lm(lm_in),
+  lm_table(lm_table_in),
   gd(gd_in),
   _word_node_cache(word_node_cache_in),
   bi_rescore(ORDER-1),
-  bigram_weight_cache(ORDER-1),
+  _bigram_weight(ORDER-1),
   bigram_weight_best(ORDER-1),
   _lm_weight(lm_weight()) {
   _non_exact = false;
+  _pool = new ThreadPool(1);
   for (int ord =0; ord < ORDER -1; ord++) {
     bi_rescore[ord] = new BigramRescore(graph, gd_in);
   }
@@ -50,37 +54,20 @@ Subproblem::Subproblem(const ForestLattice *g,
     }
   }
 
-  best_lm_score.resize(num_word_nodes);
-  bigram_score_cache.resize(num_word_nodes);
-  backoff_score_cache.resize(num_word_nodes);
-  bigram_in_lm.resize(num_word_nodes);
 
   for (int ord = 0; ord < ORDER - 1; ord++) {
-    bigram_weight_cache[ord].resize(num_word_nodes);
     bigram_weight_best[ord].resize(num_word_nodes, INF);
   }
 
-  forward_trigrams.resize(num_word_nodes);
-  // forward_trigrams_score.resize(num_word_nodes);
-  forward_trigrams_score_best.resize(num_word_nodes);
-  forward_trigrams_best.resize(num_word_nodes, INF);
-  word_bow_reverse_cache.resize(num_word_nodes);
-
-
-  for (int i = 0; i < num_word_nodes; i++) {
-    best_lm_score[i].resize(gd->forward_bigrams[i].size());
-    bigram_score_cache[i].resize(gd->forward_bigrams[i].size());
-    backoff_score_cache[i].resize(gd->forward_bigrams[i].size());
-    bigram_in_lm[i].resize(gd->forward_bigrams[i].size());
-    forward_trigrams[i].resize(gd->forward_bigrams[i].size());
-    // forward_trigrams_score[i].resize(num_word_nodes);
-    forward_trigrams_score_best[i].resize(num_word_nodes, INF);
-    word_bow_reverse_cache[i].resize(num_word_nodes);
-
-    for (int ord = 0; ord < ORDER - 1; ord++) {
-      bigram_weight_cache[ord][i].resize(num_word_nodes);
-    }
+  // The flat tables share the layout of the LM table.
+  _bigram_start = lm_table->bigram_start();
+  _cont_start = lm_table->cont_start();
+  int num_bigrams = _bigram_start[num_word_nodes];
+  for (int ord = 0; ord < ORDER - 1; ord++) {
+    _bigram_weight[ord].resize(num_bigrams, INF);
   }
+  _bigram_proj.resize(num_bigrams, 0);
+  _best_cont_score.resize(num_bigrams, INF);
 
   for (int ord = 0; ord < ORDER - 1; ord++) {
     bi_rescore[ord]->recompute_bigram_weights(true);
@@ -254,71 +241,59 @@ void Subproblem::initialize_caches() {
       overridden[w0] = true;
       word_override.push_back(w0);
     }
-
-    const vector <int> & f1 = gd->forward_bigrams[w1];
-    for (unsigned int i = 0; i < f1.size(); i++) {
-      int w2 = f1[i];
-
-      bigram_in_lm[w1][i] = word_bow_bigram_reverse(w1, w2);
-      forward_trigrams[w1][i] = new vector<Trigram>();
-      // forward_trigrams_score[w1][i] = new vector<float>();
-      word_bow_reverse_cache[w1][w2] =
-          new vector<float>(gd->forward_bigrams[w2].size());
-      bigram_score_cache[w1][i] =
-          (_lm_weight) * word_prob_bigram_reverse(w1, w2);
-      backoff_score_cache[w1][i] =
-          (_lm_weight) * word_backoff_two(w1, w2);
-
-      best_lm_score[w1][i] = INF;
-    }
   }
-  cout << "Done cache" << endl;
 
+  // Weighted lm scores, read from the sentence's LM table.
+  _bigram_backoff.resize(_bigram_start.back());
+  _cont_lm_score.resize(_cont_start.back());
   for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
     if (!graph->is_word(w1)) continue;
-
-    const vector <int> & f1 = gd->forward_bigrams[w1];
-
-    for (unsigned int i = 0; i< f1.size(); i++) {
-      int w2 = f1[i];
-
-      VocabIndex context[] = {_word_node_cache.store[w2], Vocab_None};
-      lm->wordProbPrimeCache(_word_node_cache.store[w1], context);
-
-      for (unsigned int j =0; j < gd->forward_bigrams[w2].size(); j++) {
-        int w3 = gd->forward_bigrams[w2][j];
-        float lm_score;
-        if (bigram_in_lm[w1][i] && bigram_in_lm[w2][j] &&
-            lm->hasNext(_word_node_cache.store[w3])) {
-          VocabIndex context[] =
-              {_word_node_cache.store[w2],
-               _word_node_cache.store[w3],
-               Vocab_None};
-          lm_score = (_lm_weight) *
-              lm->wordProbFromCache(_word_node_cache.store[w1], context);
-
-          forward_trigrams[w1][i]->push_back(Trigram(w3, lm_score, j));
-          // forward_trigrams_score[w1][i]->push_back(lm_score);
-          forward_trigrams_score_best[w1][i] = min(forward_trigrams_score_best[w1][i], lm_score);
-
-          (*word_bow_reverse_cache[w1][w2])[j] = lm_score;
-        } else {
-          lm_score = backoff_score_cache[w2][j] + bigram_score_cache[w1][i];
-          (*word_bow_reverse_cache[w1][w2])[j] = lm_score;
-        }
-        forward_trigrams_best[w1] = min(forward_trigrams_best[w1], lm_score);
-        // if (fabs((*word_bow_reverse_cache[w1][w2])[j] - (_lm_weight) * word_prob_reverse(w1, w2, w3)) > 1e-4) {
-
-        //   cerr << "failure " << (*word_bow_reverse_cache[w1][w2])[j] << " " << (_lm_weight) * word_prob_reverse(w1, w2, w3) << endl;
-        //   exit(0);
-        // }
-        if (lm_score < best_lm_score[w1][i]) {
-          best_lm_score[w1][i] = lm_score;
+    for (int b = _bigram_start[w1]; b < _bigram_start[w1 + 1]; b++) {
+      _bigram_backoff[b] = (_lm_weight) * lm_table->bigram_bow(b);
+      for (int c = _cont_start[b]; c < _cont_start[b + 1]; c++) {
+        float lm_score = (_lm_weight) * lm_table->trigram_prob(c);
+        _cont_lm_score[c] = lm_score;
+        if (lm_score < _best_cont_score[b]) {
+          _best_cont_score[b] = lm_score;
         }
       }
-      sort(forward_trigrams[w1][i]->begin(), forward_trigrams[w1][i]->end());
     }
   }
+  cout << "Done cache" << endl;
+}
+
+// Smallest lm[j] + bigram[j] over the continuations j in projection d.
+static inline float best_continuation(const float * lm,
+                                      const float * bigram,
+                                      const int * proj,
+                                      int d, int n) {
+  float best = INF;
+  int j = 0;
+#ifdef __SSE2__
+  // Four continuations at a time, out of projection ones are masked to INF.
+  __m128 best4 = _mm_set1_ps(INF);
+  __m128 inf4 = _mm_set1_ps(INF);
+  __m128i d4 = _mm_set1_epi32(d);
+  for (; j + 4 <= n; j += 4) {
+    __m128 score = _mm_add_ps(_mm_loadu_ps(lm + j), _mm_loadu_ps(bigram + j));
+    __m128 in_proj = _mm_castsi128_ps(
+        _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(proj + j)), d4));
+    score = _mm_or_ps(_mm_and_ps(in_proj, score),
+                      _mm_andnot_ps(in_proj, inf4));
+    best4 = _mm_min_ps(best4, score);
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, best4);
+  for (int k = 0; k < 4; k++) {
+    best = min(best, lanes[k]);
+  }
+#endif
+  for (; j < n; j++) {
+    if (proj[j] == d) {
+      best = min(best, lm[j] + bigram[j]);
+    }
+  }
+  return best;
 }
 
 
@@ -335,20 +310,64 @@ void Subproblem::solve(bool exact) {
   }
   assert(TRIPROJECT);
 
+  prelookup();
+
+  // Warm starts from a non-exact round are dropped for every pair.
+  _round_exact = exact;
+  _round_reset = exact && _non_exact;
+  _pool->run(*this, projection_dims * projection_dims);
   for (int d = 0; d < projection_dims; d++) {
     for (int d2 = 0; d2 < projection_dims; d2++) {
-      solve_proj(d, d2, _first_time_proj[d][d2],
-                 cur_best_for_projection[d][d2], exact);
       _first_time_proj[d][d2] = false;
     }
   }
+  _non_exact = !exact;
   first_time = false;
 }
 
+void Subproblem::run_item(int item, int thread_id) {
+  int d = item / projection_dims;
+  int d2 = item % projection_dims;
+  solve_proj(d, d2, _first_time_proj[d][d2],
+             cur_best_for_projection[d][d2], _round_exact, _round_reset);
+}
+
+void Subproblem::prelookup() {
+  for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
+    if (!graph->is_word(w1)) continue;
+    const vector <int> & f1 = gd->forward_bigrams[w1];
+    for (int ord = 0; ord < ORDER-1; ord++) {
+      bigram_weight_best[ord][w1] = INF;
+    }
+    for (unsigned int i = 0; i < f1.size(); i++) {
+      int w2 = f1[i];
+      for (int ord = 0; ord < ORDER-1; ord++) {
+        float score = bi_rescore[ord]->get_bigram_weight(w1, w2);
+        _bigram_weight[ord][bigram_id(w1, i)] = score;
+        bigram_weight_best[ord][w1] =
+            min(bigram_weight_best[ord][w1], score);
+      }
+    }
+  }
+
+  // words that are bounded by a later word
+  for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
+    if (!graph->is_word(w1)) continue;
+    overridden[w1] = false;
+  }
+  for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
+    if (!graph->is_word(w1)) continue;
+    int w0 = fixed_last_bigram(w1);
+    if (w0 != -1) {
+      overridden[w0] = true;
+    }
+  }
+}
+
 void Subproblem::solve_proj(int d2, int d3,
                             bool first_proj_time,
                             vector<ProjMax> &proj_best,
-                            bool exact) {
+                            bool exact, bool reset_all) {
   // solve (but only in the projected space)
   // unless is_simple
   int num_word_nodes = graph->num_word_nodes;
@@ -362,7 +381,6 @@ void Subproblem::solve_proj(int d2, int d3,
   if (TIMING) begin=clock();
 
 
-  vector<float> bigram_best(ORDER, INF);
   int prelookups = 0;
   {
     for (int i = 0; i < graph->num_word_nodes; i++) {
@@ -375,29 +393,19 @@ void Subproblem::solve_proj(int d2, int d3,
     for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
       if (!graph->is_word(w1)) continue;
       const vector <int> & f1 = gd->forward_bigrams[w1];
-      for (int ord = 0; ord < ORDER-1; ord++) {
-        bigram_weight_best[ord][w1] = INF;
-      }
       for (unsigned int i = 0; i < f1.size(); i++) {
         int w2 = f1[i];
         prelookups++;
-        for (int ord = 0; ord < ORDER-1; ord++) {
-          float score = bi_rescore[ord]->get_bigram_weight(w1, w2);
-          bigram_weight_cache[ord][w1][i] = score;
-          bigram_weight_best[ord][w1] =
-              min(bigram_weight_best[ord][w1], score);
-          bigram_best[ord] = min(bigram_best[ord], score);
-        }
 
         if (TRIPROJECT && project_word(w2) != d3) {
         } else {
-          float score = bigram_weight_cache[1][w1][i];
+          float score = bigram_weight(1, w1, i);
 
           if (score < best_bigram[w1]) {
             best_bigram[w1] = score;
           }
 
-          float backoff = backoff_score_cache[w1][i];
+          float backoff = _bigram_backoff[bigram_id(w1, i)];
           float score_with_backoff =  backoff + score;
           if (score_with_backoff < best_bigram_with_backoff[w1]) {
             best_bigram_with_backoff[w1] = score_with_backoff;
@@ -414,7 +422,7 @@ void Subproblem::solve_proj(int d2, int d3,
   for (int w1 =0; w1 < graph->num_word_nodes; ++w1) {
     if (!graph->is_word(w1)) continue;
     bool reset = false;
-    if (!first_proj_time && !(exact && _non_exact)) {
+    if (!first_proj_time && !reset_all) {
       if (proj_best[w1].ord_best[0] == -1) {
         reset = true;
       } else {
@@ -431,19 +439,17 @@ void Subproblem::solve_proj(int d2, int d3,
 
           float old_score = proj_best[w1].score;
           proj_best[w1].score =
-            bigram_weight_cache[0][w1][one] +
-            bigram_weight_cache[1][w2][two] +
-              (*word_bow_reverse_cache[w1][w2])[two];
+            bigram_weight(0, w1, one) +
+            bigram_weight(1, w2, two) +
+              cont_lm_score(w1, one, two);
               // word_prob_reverse(w1, w2, w3) * (_lm_weight);
-               // (*word_bow_reverse_cache[w1][one])[two]; //
 
           if (w0 != -1) {
             proj_best[w1].score +=
-              bigram_weight_cache[0][w0][0] +
-              bigram_weight_cache[1][w1][one] +
-                (*word_bow_reverse_cache[w0][w1])[one];
+              bigram_weight(0, w0, 0) +
+              bigram_weight(1, w1, one) +
+                cont_lm_score(w0, 0, one);
                 // word_prob_reverse(w0, w1, one) * (_lm_weight);
-                 // (*word_bow_reverse_cache[w0][w1])[one]; //
           }
 
           proj_best[w1].ord_best[0] = one;
@@ -484,22 +490,22 @@ void Subproblem::solve_proj(int d2, int d3,
   for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
     if (!graph->is_word(w1)) continue;
 
-    overridden[w1] = false;
     //TODO CHECK!!
     //if (overridden[w1]) continue;
     words++;
     // Edge tightness optimization
     bool on_edge = false;
-    const vector<float> *on_edge_scores;
+    const float *on_edge_scores;
     // w0 is the only thing preceding w1
     int w0 = fixed_last_bigram(w1);
     // int w0 = w0_word[w1];
     double edge_weight = 0.0;
     if (w0 != -1) {
       on_edge = true;
-      on_edge_scores = word_bow_reverse_cache[w0][w1];
+      // w1 is the only forward bigram of w0.
+      on_edge_scores = &_cont_lm_score[_cont_start[bigram_id(w0, 0)]];
       word_override.push_back(w0);
-      //edge_weight = bigram_weight_cache[0][w0][0];
+      //edge_weight = bigram_weight(0, w0, 0);
     }
 
     assert(w0 == -1 || on_edge ==true);
@@ -507,11 +513,6 @@ void Subproblem::solve_proj(int d2, int d3,
 
     float best_score = proj_best[w1].score;
 
-    const vector<float> &best_lm = best_lm_score[w1];
-    const vector<float> &score_cache = bigram_score_cache[w1];
-
-
-
     for (int i = 0; i < f1.size(); ++i) {
 
       int w2 = f1[i];
@@ -524,23 +525,24 @@ void Subproblem::solve_proj(int d2, int d3,
       // if (!on_edge) {
       //   // Check best case;
       //   float best_case =
-      //       forward_trigrams_best[w1] +
+      //       best lm score of w1 +
       //       bigram_weight_best[0][w1] + bigram_best[1];
       //   if (best_case > best_score - 0.3) {
-      //     cerr << best_case << " " << best_score << " " << forward_trigrams_best[w1] << endl;
+      //     cerr << best_case << " " << best_score << endl;
       //     break;
       //   }
       // }
 
 
-      float score1 = bigram_weight_cache[0][w1][i];
-      const vector<float> &prob_cache = *word_bow_reverse_cache[w1][w2];
+      int b = bigram_id(w1, i);
+      float score1 = _bigram_weight[0][b];
+      const float *prob_cache = &_cont_lm_score[_cont_start[b]];
       if (on_edge) {
-        score1 += bigram_weight_cache[0][w0][0] + //edge_weight +
-            bigram_weight_cache[1][w1][i] +
-            (*on_edge_scores)[i]; // _lm_weight *
+        score1 += bigram_weight(0, w0, 0) + //edge_weight +
+            _bigram_weight[1][b] +
+            on_edge_scores[i]; // _lm_weight *
       }
-      const vector<float> &bigram_cache = bigram_weight_cache[1][w2];
+      const float *bigram_cache = &_bigram_weight[1][_bigram_start[w2]];
 
       // Only consider words with full lm context.
       int w3_index = best_bigram_with_backoff_forward[w2];
@@ -558,26 +560,24 @@ void Subproblem::solve_proj(int d2, int d3,
       }
 
 
-      if (exact) {
-        const vector<Trigram> &f2 = *forward_trigrams[w1][i];
-        if (f2.size() > 0 && score1 + bigram_weight_best[1][w2] + f2[0].score < best_score - 1e-4) {
-          for (unsigned int j = 0; j < f2.size(); j++) {
-
-            int w3 = f2[j].word;
-            int w3_index = f2[j].bigram_index;
-            // cerr << "BEST SCORE " << best_score << " " << score1 << " " << bigram_cache[w3] << " " << (*forward_trigrams[w1][i])[j].score << " " << bigram_weight_best[1][w2] << " " << forward_trigrams_score_best[w1][i] << endl;
-            lookups++;
-            //float score = score1 + bigram_cache[w3] + trigrams[j];
-            if (score1 + bigram_cache[w3_index] + f2[j].score < best_score) {
-              if (project_word(w3) != d3) continue;
+      if (exact &&
+          score1 + bigram_weight_best[1][w2] + _best_cont_score[b] <
+          best_score - 1e-4) {
+        // Scan every continuation of (w1, w2) in projection d3.
+        int n = gd->forward_bigrams[w2].size();
+        const int *proj_cache = &_bigram_proj[_bigram_start[w2]];
+        lookups += n;
+        float best_cont =
+            best_continuation(prob_cache, bigram_cache, proj_cache, d3, n);
+        if (score1 + best_cont < best_score) {
+          for (int j = 0; j < n; j++) {
+            if (proj_cache[j] == d3 &&
+                prob_cache[j] + bigram_cache[j] <= best_cont) {
               updates++;
-              best_score = score1 + bigram_cache[w3_index] + f2[j].score;
+              best_score = score1 + best_cont;
               proj_best[w1].ord_best[0] = i;
-              proj_best[w1].ord_best[1] = w3_index;
+              proj_best[w1].ord_best[1] = j;
               proj_best[w1].is_new = true;
-            }
-            if (j % 10 == 1 &&
-                score1 + bigram_weight_best[1][w2] + f2[j].score >= best_score - 1e-4) {
               break;
             }
           }
@@ -599,8 +599,6 @@ void Subproblem::solve_proj(int d2, int d3,
     assert(gd->forward_bigrams[w0].size() ==1);
     int w1 = gd->forward_bigrams[w0][0];
 
-    overridden[w0] = true;
-
     if (proj_best[w1].ord_best[0] == -1) continue;
 
     // property w0 trigram must equal w1 bigram
@@ -612,13 +610,13 @@ void Subproblem::solve_proj(int d2, int d3,
 
     // the lm score at w1 needs to include the previous trigram score
     assert(gd->forward_bigrams[w0].size() == 1);
-    float first  =  (*word_bow_reverse_cache[w0][w1])[one] +  // ( _lm_weight) * word_prob_reverse(w0, w1, w2) +
-                    bigram_weight_cache[0][w0][0] +
-                    bigram_weight_cache[1][w1][one];
+    float first  =  cont_lm_score(w0, 0, one) +  // ( _lm_weight) * word_prob_reverse(w0, w1, w2) +
+                    bigram_weight(0, w0, 0) +
+                    bigram_weight(1, w1, one);
     float second = //(_lm_weight) * word_prob_reverse(w1, w2, w3) +
-        (*word_bow_reverse_cache[w1][w2])[two] +
-                    bigram_weight_cache[0][w1][one] +
-                    bigram_weight_cache[1][w2][two];
+        cont_lm_score(w1, one, two) +
+                    bigram_weight(0, w1, one) +
+                    bigram_weight(1, w2, two);
 
     assert(fabs(first + second - proj_best[w1].score) < 1e-4);
 
@@ -628,7 +626,6 @@ void Subproblem::solve_proj(int d2, int d3,
     proj_best[w0].is_new = false;
   }
 
-  _non_exact = !exact;
   if (TIMING) {
     clock_t end = clock();
     cout << "TRIGRAM TIME: "
@@ -648,4 +645,10 @@ void Subproblem::project(int proj_dim, vector <int> proj ) {
   assert(proj_dim >=1 && proj_dim <= MAX_PROJ);
   projection = proj;
   projection_dims = proj_dim;
+  for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
+    const vector <int> & f1 = gd->forward_bigrams[w1];
+    for (unsigned int i = 0; i < f1.size(); i++) {
+      _bigram_proj[bigram_id(w1, i)] = projection[f1[i]];
+    }
+  }
 }
@@ -14,7 +14,8 @@
 #include "EdgeCache.h"
 #include "GraphDecompose.h"
 #include "BigramRescore.h"
-#include "NGramCache.h"
+#include "LatticeLMTable.h"
+#include "ThreadPool.h"
 
 #include "../common.h"
 #define MAX_PROJ 30
@@ -34,25 +35,16 @@ struct ProjMax {
   bool is_new;
 };
 
-class Subproblem {
+class Subproblem : public ParallelTask {
  public:
   // TODO(srush)
   Subproblem(const ForestLattice *g,
-             NgramCache * lm_in,
+             const LatticeLMTable * lm_table_in,
              const GraphDecompose * gd_in,
              const Cache<Graphnode, int> & word_node_cache_in);
 
   ~Subproblem() {
-    for (int w1 = 0; w1 < graph->num_word_nodes; w1++) {
-      if (!graph->is_word(w1)) continue;
-      const vector <int> & f1 = gd->forward_bigrams[w1];
-      for (unsigned int i = 0; i< f1.size(); i++) {
-        int w2 = f1[i];
-        delete forward_trigrams[w1][i];
-        /* delete forward_trigrams_score[w1][i]; */
-        delete word_bow_reverse_cache[w1][w2];
-      }
-    }
+    delete _pool;
   }
 
   // TODO(srush)
@@ -61,6 +53,15 @@ class Subproblem {
   // TODO(srush)
   void solve(bool exact);
 
+  // Solve the projection pairs on num_threads threads (1 is serial).
+  void set_num_threads(int num_threads) {
+    delete _pool;
+    _pool = new ThreadPool(num_threads);
+  }
+
+  // Solve a single (d, d2) projection pair, item is d * dims + d2.
+  void run_item(int item, int thread_id);
+
   // TODO(srush)
   void project(int proj_dim, vector<int> projection);
 
@@ -80,10 +81,10 @@ class Subproblem {
   float get_best_bigram_weight(int w1, int w2 , int pos);
 
   // TODO(srush): move to helper.
-  float word_prob_reverse(int i, int j, int k) {
-    VocabIndex context[] = {_word_node_cache.store[j],
-                            _word_node_cache.store[k], Vocab_None};
-    return lm->wordProb(_word_node_cache.store[i], context);
+  float word_prob_reverse(int i, int j, int k) const {
+    return lm_table->word_prob(_word_node_cache.store[i],
+                               _word_node_cache.store[j],
+                               _word_node_cache.store[k]);
   }
 
   // TODO(srush) move to helper
@@ -153,41 +154,13 @@ class Subproblem {
  private:
 
 
-  // TODO(srush) move to helper
-  float word_backoff_two(int i, int j) {
-    VocabIndex context[] = {_word_node_cache.store[i],
-                            _word_node_cache.store[j], Vocab_None};
-    float score = lm->contextBOW(context, 1);
-    return score;
-  }
-
-  // TODO(srush) move to helper
-  float word_prob_bigram_reverse(int i, int j) {
-    VocabIndex context[] = {_word_node_cache.store[j],
-                            lm->vocab.getIndex(Vocab_Unknown), Vocab_None};
-    return lm->wordProb(_word_node_cache.store[i], context);
-  }
-
-  // TODO(srush) move to helper
-  int word_bow_reverse(int i, int j, int k) {
-    VocabIndex context[] = {_word_node_cache.store[j],
-                            _word_node_cache.store[k], Vocab_None};
-    unsigned int length;
-    lm->contextID(_word_node_cache.store[i], context, length);
-    return length;
-  }
-
-  // TODO(srush) move to helper
-  int word_bow_bigram_reverse(int i, int j) {
-    VocabIndex context[] = {_word_node_cache.store[j], Vocab_None};
-    unsigned int length;
-    lm->contextID(_word_node_cache.store[i], context, length);
-    return length;
-  }
-
   // TODO(srush) Document
   void initialize_caches();
 
+  // Projection independent part of each round. Caches the bigram
+  // weights and the overridden words once for all projection pairs.
+  void prelookup();
+
   // TODO(srush) Document
   /* void try_set_max(vector<ProjMax> &proj_best, */
   /*                  int w1, */
@@ -211,44 +184,48 @@ class Subproblem {
   // PROBLEMS
   const float _lm_weight;
 
-  vector<vector<float > > best_lm_score;
-  vector<vector<float > > bigram_score_cache;
-  vector<vector<float > > backoff_score_cache;
-  vector<vector <vector<float > > > bigram_weight_cache;
   vector<vector <float> > bigram_weight_best;
   vector<float> bigram_ord_best;
 
-  vector <vector<bool > > bigram_in_lm;
+  // Flat (CSR) tables. The bigram (w1, i), w1 followed by its i'th
+  // forward bigram, has id _bigram_start[w1] + i.
+  vector<int> _bigram_start;
 
-  struct Trigram {
-    Trigram(int _word, float _score, int _bigram_index) {
-      word = _word;
-      score = _score;
-      bigram_index = _bigram_index;
-    }
-    int word;
-    int bigram_index;
-    float score;
-    bool operator<(const Trigram &t) const {
-      return score < t.score;
-    }
-  };
+  // Per bigram id, the weighted backoff weight of the context (w1 w2).
+  vector<float> _bigram_backoff;
+
+  // Per bigram id, the current bigram weight for each order and the
+  // projection of the second word.
+  vector<vector<float> > _bigram_weight;
+  vector<int> _bigram_proj;
 
-  vector <vector<vector<Trigram> *> > forward_trigrams;
-  // vector <vector<vector<float> * > > forward_trigrams_score;
+  // Continuations of bigram (w1, w2) are the forward bigrams j of w2.
+  // Their lm scores are at _cont_start[id] + j, lined up with the
+  // bigram ids of w2 so scores and weights are both contiguous.
+  vector<int> _cont_start;
+  vector<float> _cont_lm_score;
+  // Best lm score over the continuations of each bigram.
+  vector<float> _best_cont_score;
 
+  inline int bigram_id(int w1, int i) const {
+    return _bigram_start[w1] + i;
+  }
 
+  inline float bigram_weight(int ord, int w1, int i) const {
+    return _bigram_weight[ord][_bigram_start[w1] + i];
+  }
 
-  vector <vector<float> > forward_trigrams_score_best;
-  vector<float> forward_trigrams_best;
+  // Lm score of w1 w2 w3, w2 the i'th bigram of w1, w3 the j'th of w2.
+  inline float cont_lm_score(int w1, int i, int j) const {
+    return _cont_lm_score[_cont_start[_bigram_start[w1] + i] + j];
+  }
 
-  vector <vector<vector<float> *> > word_bow_reverse_cache;
   vector<int> word_override;
   /* vector<int> word_overriden; */
   vector<int> w0_word;
 
   const ForestLattice * graph;
-  NgramCache * lm;
+  const LatticeLMTable * lm_table;
 
   const GraphDecompose *gd;
   const Cache<Graphnode, int> _word_node_cache;
@@ -265,9 +242,15 @@ class Subproblem {
 
   vector<vector<vector<ProjMax> > > cur_best_for_projection;
 
+  // Per round state for run_item.
+  bool _round_exact;
+  bool _round_reset;
+  ThreadPool * _pool;
+
+  // Only writes to proj_best, so pairs can run concurrently.
   void solve_proj(int d2, int d3, bool first_time_proj,
                   vector <ProjMax> & proj_best,
-                  bool exact);
+                  bool exact, bool reset_all);
 };
 
 #endif